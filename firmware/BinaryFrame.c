@@ -0,0 +1,115 @@
+//
+//  Binary Frame
+//
+
+#include "BinaryFrame.h"
+
+#include <util/crc16.h>
+#include "USBTerminal.h"
+
+static uint8_t sequence = 0;
+static uint16_t droppedFrames = 0;
+
+static void appendBytes (
+    uint32_t value,
+    const uint8_t numBytes,
+    BinaryFrame *frame)
+{
+    if ((frame->length + numBytes) <= BINARYFRAME_MAX_PAYLOAD) {
+        uint8_t *bp = &frame->bytes[BINARYFRAME_HEADER_LEN + frame->length];
+        for (uint8_t b = 0; b < numBytes; ++b) {
+            *bp++ = value & 0xFF;
+            value >>= 8;
+        }
+        frame->length += numBytes;
+    } else {
+        // make sure nothing else goes in after the value that didn't fit
+        frame->length = BINARYFRAME_MAX_PAYLOAD;
+    }
+}
+
+void BinaryFrame_appendU8 (
+    const uint8_t value,
+    BinaryFrame *frame)
+{
+    appendBytes(value, 1, frame);
+}
+
+void BinaryFrame_appendU16 (
+    const uint16_t value,
+    BinaryFrame *frame)
+{
+    appendBytes(value, 2, frame);
+}
+
+void BinaryFrame_appendU32 (
+    const uint32_t value,
+    BinaryFrame *frame)
+{
+    appendBytes(value, 4, frame);
+}
+
+void BinaryFrame_appendU64 (
+    const uint64_t value,
+    BinaryFrame *frame)
+{
+    if ((frame->length + 8) <= BINARYFRAME_MAX_PAYLOAD) {
+        appendBytes((uint32_t)value, 4, frame);
+        appendBytes((uint32_t)(value >> 32), 4, frame);
+    } else {
+        frame->length = BINARYFRAME_MAX_PAYLOAD;
+    }
+}
+
+bool BinaryFrame_fits (
+    const BinaryFrame *frame)
+{
+    return !USBTerminal_lineIsOpen() &&
+        (ByteRing_spaceRemaining(&ToUSB_Buffer) >=
+        (BINARYFRAME_HEADER_LEN + frame->length + BINARYFRAME_CRC_LEN));
+}
+
+bool BinaryFrame_send (
+    const uint8_t type,
+    BinaryFrame *frame)
+{
+    bool sent = false;
+
+    if (USBTerminal_isConnected()) {
+        uint8_t *bytes = frame->bytes;
+        bytes[0] = BINARYFRAME_SYNC1;
+        bytes[1] = BINARYFRAME_SYNC2;
+        bytes[2] = type;
+        bytes[3] = sequence;
+        bytes[4] = frame->length;
+
+        const uint8_t crcEnd = BINARYFRAME_HEADER_LEN + frame->length;
+        uint16_t crc = 0xFFFF;
+        for (uint8_t b = 2; b < crcEnd; ++b) {
+            crc = _crc_ccitt_update(crc, bytes[b]);
+        }
+        bytes[crcEnd] = crc & 0xFF;
+        bytes[crcEnd + 1] = crc >> 8;
+
+        sent = USBTerminal_sendBytesToHost(bytes, crcEnd + BINARYFRAME_CRC_LEN);
+        if (!sent) {
+            ++droppedFrames;
+        }
+
+        // dropped frames use up a sequence number too, so the host
+        // can see the gap
+        ++sequence;
+    }
+
+    return sent;
+}
+
+uint16_t BinaryFrame_droppedCount (void)
+{
+    return droppedFrames;
+}
+
+void BinaryFrame_resetCounts (void)
+{
+    droppedFrames = 0;
+}
@@ -0,0 +1,84 @@
+//
+//  Binary Frame
+//
+//  What it does:
+//    Builds fixed-layout binary records and sends them to the USB host in
+//    frames the host can find in the byte stream and check:
+//
+//      0xA5 0x5A  type  sequence  length  payload...  CRC (2 bytes)
+//
+//    Multi-byte values are little-endian. The CRC is CRC-16/CCITT
+//    (avr-libc's _crc_ccitt_update, starting from 0xFFFF) over type,
+//    sequence, length and payload. The sequence number goes up by one for
+//    every frame, including frames that are dropped because the USB
+//    buffer is full, so the host can count the frames it missed.
+//    The sync bytes can't occur in console text (which is 7-bit ASCII), so
+//    frames and text can share the stream.
+//
+//  How to use it:
+//    Define a frame like this:
+//       BinaryFrame_define(report);
+//    then append the payload with the BinaryFrame_append* functions and
+//    send it with BinaryFrame_send. A frame is sent whole or not at all.
+//
+#ifndef BINARYFRAME_H
+#define BINARYFRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BINARYFRAME_SYNC1 0xA5
+#define BINARYFRAME_SYNC2 0x5A
+#define BINARYFRAME_HEADER_LEN 5
+#define BINARYFRAME_CRC_LEN 2
+#define BINARYFRAME_MAX_PAYLOAD 96
+
+typedef struct BinaryFrame_struct {
+    uint8_t length;     // of the payload
+    uint8_t bytes[BINARYFRAME_HEADER_LEN + BINARYFRAME_MAX_PAYLOAD +
+        BINARYFRAME_CRC_LEN];
+} BinaryFrame;
+
+#define BinaryFrame_define(frameName) \
+    BinaryFrame frameName = {0};
+
+inline void BinaryFrame_clear (
+    BinaryFrame *frame)
+{
+    frame->length = 0;
+}
+
+// these drop anything that doesn't fit in the payload
+extern void BinaryFrame_appendU8 (
+    const uint8_t value,
+    BinaryFrame *frame);
+
+extern void BinaryFrame_appendU16 (
+    const uint16_t value,
+    BinaryFrame *frame);
+
+extern void BinaryFrame_appendU32 (
+    const uint32_t value,
+    BinaryFrame *frame);
+
+extern void BinaryFrame_appendU64 (
+    const uint64_t value,
+    BinaryFrame *frame);
+
+// returns true if the frame can be sent now: there is room for it in the
+// USB buffer, and no text line is part way through being sent
+extern bool BinaryFrame_fits (
+    const BinaryFrame *frame);
+
+// frames the payload and sends it to the host. returns false if there
+// wasn't room for the whole frame in the USB buffer
+extern bool BinaryFrame_send (
+    const uint8_t type,
+    BinaryFrame *frame);
+
+// frames dropped because the USB buffer was full
+extern uint16_t BinaryFrame_droppedCount (void);
+
+extern void BinaryFrame_resetCounts (void);
+
+#endif  // BINARYFRAME_H
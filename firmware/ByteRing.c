@@ -0,0 +1,71 @@
+//
+// Byte Ring
+//
+
+#include "ByteRing.h"
+
+#include <string.h>
+
+void ByteRing_clear (
+    ByteRing *r)
+{
+    r->head = 0;
+    r->tail = 0;
+}
+
+uint8_t ByteRing_pushSpan (
+    const uint8_t *bytes,
+    const uint8_t count,
+    ByteRing *r)
+{
+    const uint8_t tail = r->tail;
+    const uint8_t space = (r->mask + 1) - (uint8_t)(tail - r->head);
+    const uint8_t toPush = (count < space) ? count : space;
+
+    // copy in up to two pieces, either side of the wraparound
+    const uint8_t start = tail & r->mask;
+    const uint8_t toEnd = (r->mask + 1) - start;
+    const uint8_t first = (toPush < toEnd) ? toPush : toEnd;
+    memcpy(&r->bytes[start], bytes, first);
+    memcpy(r->bytes, bytes + first, toPush - first);
+    ByteRing_barrier();
+    r->tail = tail + toPush;
+
+    return toPush;
+}
+
+uint8_t ByteRing_popSpan (
+    uint8_t *bytes,
+    const uint8_t maxCount,
+    ByteRing *r)
+{
+    const uint8_t head = r->head;
+    const uint8_t length = (uint8_t)(r->tail - head);
+    const uint8_t toPop = (maxCount < length) ? maxCount : length;
+    ByteRing_barrier();
+
+    const uint8_t start = head & r->mask;
+    const uint8_t toEnd = (r->mask + 1) - start;
+    const uint8_t first = (toPop < toEnd) ? toPop : toEnd;
+    memcpy(bytes, &r->bytes[start], first);
+    memcpy(bytes + first, r->bytes, toPop - first);
+    ByteRing_barrier();
+    r->head = head + toPop;
+
+    return toPop;
+}
+
+uint8_t ByteRing_peekContiguous (
+    const uint8_t **span,
+    const ByteRing *r)
+{
+    const uint8_t head = r->head;
+    const uint8_t length = (uint8_t)(r->tail - head);
+    ByteRing_barrier();
+
+    const uint8_t start = head & r->mask;
+    const uint8_t toEnd = (r->mask + 1) - start;
+    *span = &r->bytes[start];
+
+    return (length < toEnd) ? length : toEnd;
+}
@@ -0,0 +1,142 @@
+//
+// Byte Ring
+//
+//  What it does:
+//    Provides a fixed-capacity queue of bytes for one producer and one
+//    consumer (e.g. the mainloop and an interrupt handler, or two tasks)
+//    that needs no interrupt masking. The producer only ever writes the
+//    tail index and the consumer only ever writes the head index, and
+//    each index is a single byte, so the AVR reads and writes them
+//    atomically. The indices run freely and wrap around at 256, and the
+//    capacity is a power of 2 so that the length is just tail - head.
+//    Supports pushing and popping single bytes and spans of bytes, and
+//    peeking at the contiguous bytes at the head of the ring so that
+//    they can be copied out in place.
+//
+//  How to use it:
+//    Define a ring like this:
+//       ByteRing_define(64, ToHost_Buffer)
+//    which defines variable ToHost_Buffer with a capacity of 64 bytes.
+//    The capacity must be a power of 2, up to 128.
+//    Then the producer pushes and the consumer pops, peeks and drops.
+//    Only clear the ring when neither side is using it.
+//
+
+#ifndef BYTERING_LOADED
+#define BYTERING_LOADED
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint8_t head;  // written only by the consumer
+    volatile uint8_t tail;  // written only by the producer
+    uint8_t mask;           // capacity - 1
+    uint8_t *bytes;
+    } ByteRing;
+
+#define ByteRing_define(capacity, ringName) \
+    uint8_t ringName##_buf[capacity] = {0}; \
+    ByteRing ringName = {0, 0, (capacity) - 1, ringName##_buf};
+
+// keeps the compiler from moving reads and writes of the bytes across
+// the index updates that publish them to the other side
+#define ByteRing_barrier() __asm__ __volatile__ ("" ::: "memory")
+
+extern void ByteRing_clear (
+    ByteRing *r);
+
+// returns the current length of the ring
+inline uint8_t ByteRing_length (
+    const ByteRing *r)
+{
+    return (uint8_t)(r->tail - r->head);
+}
+
+// returns the length available in the ring
+inline uint8_t ByteRing_spaceRemaining (
+    const ByteRing *r)
+{
+    return (r->mask + 1) - ByteRing_length(r);
+}
+
+inline bool ByteRing_isEmpty (
+    const ByteRing *r)
+{
+    return r->tail == r->head;
+}
+
+inline bool ByteRing_isFull (
+    const ByteRing *r)
+{
+    return ByteRing_length(r) > r->mask;
+}
+
+// assumes the ring is not empty. consumer only
+inline uint8_t ByteRing_head (
+    const ByteRing *r)
+{
+    return r->bytes[r->head & r->mask];
+}
+
+// pushes a byte onto the tail of the ring, if it's not full. returns
+// true if successful. producer only
+inline bool ByteRing_push (
+    const uint8_t byte,
+    ByteRing *r)
+{
+    const uint8_t tail = r->tail;
+    if ((uint8_t)(tail - r->head) > r->mask) {
+        return false;
+    }
+    r->bytes[tail & r->mask] = byte;
+    ByteRing_barrier();
+    r->tail = tail + 1;
+
+    return true;
+}
+
+// pops a byte from the head of the ring, expects it's not empty.
+// consumer only
+inline uint8_t ByteRing_pop (
+    ByteRing *r)
+{
+    const uint8_t head = r->head;
+    const uint8_t byte = r->bytes[head & r->mask];
+    ByteRing_barrier();
+    r->head = head + 1;
+
+    return byte;
+}
+
+// pushes as many of the bytes as fit. returns the number pushed.
+// producer only
+extern uint8_t ByteRing_pushSpan (
+    const uint8_t *bytes,
+    const uint8_t count,
+    ByteRing *r);
+
+// pops up to maxCount bytes. returns the number popped. consumer only
+extern uint8_t ByteRing_popSpan (
+    uint8_t *bytes,
+    const uint8_t maxCount,
+    ByteRing *r);
+
+// points span at the head of the ring and returns the number of bytes
+// that follow it in memory (before the ring wraps around). returns 0 if
+// the ring is empty. consumer only
+extern uint8_t ByteRing_peekContiguous (
+    const uint8_t **span,
+    const ByteRing *r);
+
+// removes count bytes from the head of the ring, expects it has them.
+// consumer only
+inline void ByteRing_drop (
+    const uint8_t count,
+    ByteRing *r)
+{
+    ByteRing_barrier();
+    r->head += count;
+}
+
+#endif   // BYTERING_LOADED
@@ -0,0 +1,163 @@
+//
+// Calibration
+//
+
+#include "Calibration.h"
+
+#include <stddef.h>
+#include <util/crc16.h>
+#include "EEPROM.h"
+
+typedef struct CalibrationRange_struct {
+    int8_t offset;                  // in readings
+    uint16_t gain;                  // x 2^-CALIBRATION_GAIN_SHIFT
+} CalibrationRange;
+
+// the corrections in use, which are also what gets written to EEPROM
+typedef struct CalibrationRecord_struct {
+    uint8_t version;
+    uint8_t offsetRanges[CALIBRATION_MAX_CHANNELS];     // bit per range
+    CalibrationRange ranges[CALIBRATION_MAX_CHANNELS][CALIBRATION_RANGES];
+    uint16_t crc;
+} CalibrationRecord;
+
+static CalibrationRecord table;
+static volatile bool writing;
+
+// CRC-16/CCITT of everything before the crc field
+static uint16_t recordCrc (
+    const CalibrationRecord *record)
+{
+    const uint8_t *bp = (const uint8_t*)record;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t b = 0; b < offsetof(CalibrationRecord, crc); ++b) {
+        crc = _crc_ccitt_update(crc, *bp++);
+    }
+    return crc;
+}
+
+static void writeCompletionHandler (
+    void *context)
+{
+    writing = false;
+}
+
+static void clearTable (void)
+{
+    table.version = CALIBRATION_VERSION;
+    for (uint8_t ch = 0; ch < CALIBRATION_MAX_CHANNELS; ++ch) {
+        table.offsetRanges[ch] = 0;
+        for (uint8_t r = 0; r < CALIBRATION_RANGES; ++r) {
+            table.ranges[ch][r].offset = 0;
+            table.ranges[ch][r].gain = CALIBRATION_UNITY_GAIN;
+        }
+    }
+}
+
+void Calibration_Initialize (void)
+{
+    writing = false;
+    EEPROM_readBlock(EEPROM_CALIBRATION_ADDR, sizeof(CalibrationRecord), &table);
+    if ((table.version != CALIBRATION_VERSION) ||
+        (table.crc != recordCrc(&table))) {
+        clearTable();
+    }
+}
+
+int16_t Calibration_correct (
+    const uint8_t channel,
+    const uint8_t range,
+    const int16_t reading,
+    const int16_t bias)
+{
+    int32_t corrected = (int32_t)reading + bias;
+
+    if (channel < CALIBRATION_MAX_CHANNELS) {
+        const CalibrationRange *correction = &table.ranges[channel][range];
+        if (table.offsetRanges[channel] & (1 << range)) {
+            corrected = (int32_t)reading + correction->offset;
+        }
+        corrected = (corrected * correction->gain) >> CALIBRATION_GAIN_SHIFT;
+    }
+    // the bias alone can take a reading out of range too
+    if (corrected > INT16_MAX) {
+        corrected = INT16_MAX;
+    } else if (corrected < INT16_MIN) {
+        corrected = INT16_MIN;
+    }
+
+    return corrected;
+}
+
+int16_t Calibration_offset (
+    const uint8_t channel,
+    const uint8_t range,
+    const int16_t bias)
+{
+    return ((channel < CALIBRATION_MAX_CHANNELS) &&
+        (table.offsetRanges[channel] & (1 << range)))
+        ? table.ranges[channel][range].offset
+        : bias;
+}
+
+bool Calibration_setOffset (
+    const uint8_t channel,
+    const uint8_t range,
+    const int8_t offset)
+{
+    const bool set = !writing && (channel < CALIBRATION_MAX_CHANNELS) &&
+        (range < CALIBRATION_RANGES);
+    if (set) {
+        table.ranges[channel][range].offset = offset;
+        table.offsetRanges[channel] |= (1 << range);
+    }
+
+    return set;
+}
+
+bool Calibration_setGain (
+    const uint8_t channel,
+    const uint8_t range,
+    const uint16_t gain)
+{
+    const bool set = !writing && (channel < CALIBRATION_MAX_CHANNELS) &&
+        (range < CALIBRATION_RANGES) && (gain <= CALIBRATION_MAX_GAIN);
+    if (set) {
+        table.ranges[channel][range].gain = gain;
+    }
+
+    return set;
+}
+
+bool Calibration_clear (void)
+{
+    if (!writing) {
+        clearTable();
+    }
+
+    return !writing;
+}
+
+bool Calibration_save (void)
+{
+    bool saved = false;
+
+    if (!writing) {
+        // the table is written as it is, so it can't change until the
+        // write completes
+        table.crc = recordCrc(&table);
+        writing = true;
+        saved = EEPROM_writeBlock(EEPROM_CALIBRATION_ADDR,
+            sizeof(CalibrationRecord), &table, writeCompletionHandler, NULL);
+        if (!saved) {
+            writing = false;
+        }
+    }
+
+    return saved;
+}
+
+bool Calibration_isSaving (void)
+{
+    return writing;
+}
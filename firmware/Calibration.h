@@ -0,0 +1,79 @@
+//
+// Calibration
+//
+//  What it does:
+//    Holds the zero offset and gain corrections for shunt voltage
+//    readings, for each PGA range of each channel, and keeps them in
+//    EEPROM. A reading is corrected by
+//
+//      corrected = ((reading + offset) x gain) / 2^CALIBRATION_GAIN_SHIFT
+//
+//    using the offset and gain of the range it was converted at, so the
+//    correction is a straight line per range. Ranges whose offset hasn't
+//    been calibrated use the bias setting instead.
+//    The EEPROM record is a version byte, the table and a CRC-16/CCITT.
+//    A bad record leaves the meter uncalibrated.
+//
+//  How to use it:
+//    Call Calibration_Initialize once at power-up. PowerMeter measures
+//    the corrections (see PowerMeter_calibrateZero and
+//    PowerMeter_calibrateGain), sets them with Calibration_setOffset and
+//    Calibration_setGain, and saves them with Calibration_save.
+//
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// channels beyond this use the bias setting and no gain correction
+#define CALIBRATION_MAX_CHANNELS 4
+#define CALIBRATION_RANGES 4            // INA219PGA settings
+
+#define CALIBRATION_GAIN_SHIFT 14
+#define CALIBRATION_UNITY_GAIN (1U << CALIBRATION_GAIN_SHIFT)
+// keeps a corrected reading within 32 bits before it's clamped
+#define CALIBRATION_MAX_GAIN (2 * CALIBRATION_UNITY_GAIN)
+
+#define CALIBRATION_VERSION 1
+
+// loads the saved corrections, if there are good ones
+extern void Calibration_Initialize (void);
+
+// returns the reading corrected for the channel and range it came from
+extern int16_t Calibration_correct (
+    const uint8_t channel,
+    const uint8_t range,
+    const int16_t reading,
+    const int16_t bias);
+
+// the offset the reading is corrected by, calibrated or not
+extern int16_t Calibration_offset (
+    const uint8_t channel,
+    const uint8_t range,
+    const int16_t bias);
+
+// these change the corrections in use straight away. they return false
+// if the channel, range or gain is out of range, or the last save is
+// still being written
+extern bool Calibration_setOffset (
+    const uint8_t channel,
+    const uint8_t range,
+    const int8_t offset);
+
+extern bool Calibration_setGain (
+    const uint8_t channel,
+    const uint8_t range,
+    const uint16_t gain);
+
+// back to no corrections. returns false if the last save is still being
+// written
+extern bool Calibration_clear (void);
+
+// returns false if the last save is still being written
+extern bool Calibration_save (void);
+
+extern bool Calibration_isSaving (void);
+
+#endif  // CALIBRATION_H
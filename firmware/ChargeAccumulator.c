@@ -0,0 +1,57 @@
+//
+// Charge Accumulator
+//
+
+#include "ChargeAccumulator.h"
+
+void ChargeAccumulator_setUnit (
+    const uint64_t units,
+    ChargeUnit *unit)
+{
+    // normalize the reciprocal to 32 bits, so it's as precise as it can
+    // be whatever the size of the unit. for large units the divisor is
+    // shifted down to keep the dividend within 64 bits. the shifted
+    // divisor is rounded up, so the reciprocal is still rounded down -
+    // a reciprocal that is too big would make quotients too big, and the
+    // remainder would wrap
+    uint8_t divisorShift = 0;
+    uint64_t reciprocal = (1ULL << 63) / units;
+    while (reciprocal < (1UL << 31)) {
+        ++divisorShift;
+        reciprocal = (1ULL << 63) / ((units >> divisorShift) + 1);
+    }
+    uint8_t shift = 31 + divisorShift;
+    while (reciprocal > UINT32_MAX) {
+        reciprocal >>= 1;
+        --shift;
+    }
+
+    unit->units = units;
+    unit->reciprocal = reciprocal;
+    unit->shift = shift;
+}
+
+uint32_t ChargeAccumulator_divide (
+    const uint64_t magnitude,
+    const ChargeUnit *unit,
+    uint64_t *remainder)
+{
+    // the reciprocal is never too big, so this is at most a little too
+    // small. the remainder check corrects it
+    const uint64_t high =
+        (uint64_t)(uint32_t)(magnitude >> 32) * unit->reciprocal;
+    const uint64_t low =
+        ((uint64_t)(uint32_t)magnitude * unit->reciprocal) >> 32;
+    uint32_t quotient = (high + low) >> unit->shift;
+    uint64_t rem = magnitude - ((uint64_t)quotient * unit->units);
+    while (rem >= unit->units) {
+        rem -= unit->units;
+        ++quotient;
+    }
+
+    if (remainder != NULL) {
+        *remainder = rem;
+    }
+
+    return quotient;
+}
@@ -0,0 +1,102 @@
+//
+// Charge Accumulator
+//
+//  What it does:
+//    Sums signed charge readings (e.g. current readings x sample
+//    durations) exactly, in 64 bits split into two 32 bit halves so that
+//    adding a reading is just a 32 bit add and a carry. Nothing is ever
+//    divided into the sum, so there are no remainders to lose.
+//    Converts the sum to display units (e.g. mAh) by multiplying by a
+//    precomputed reciprocal instead of dividing.
+//
+//  How to use it:
+//    Set up a ChargeUnit for each display unit with
+//    ChargeAccumulator_setUnit, giving the number of accumulator units
+//    in one of it. Add readings with ChargeAccumulator_add, and get the
+//    number of display units, and what's left over, with
+//    ChargeAccumulator_divide.
+//
+
+#ifndef CHARGEACCUMULATOR_H
+#define CHARGEACCUMULATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct ChargeAccumulator_struct {
+    uint32_t low;
+    int32_t high;       // carries out of low
+} ChargeAccumulator;
+
+typedef struct ChargeUnit_struct {
+    uint64_t units;         // accumulator units in one of these
+    uint32_t reciprocal;    // at most 2^(32 + shift) / units
+    uint8_t shift;
+} ChargeUnit;
+
+// units must be at least 2^8
+extern void ChargeAccumulator_setUnit (
+    const uint64_t units,
+    ChargeUnit *unit);
+
+inline void ChargeAccumulator_clear (
+    ChargeAccumulator *acc)
+{
+    acc->low = 0;
+    acc->high = 0;
+}
+
+inline void ChargeAccumulator_add (
+    const int32_t charge,
+    ChargeAccumulator *acc)
+{
+    const uint32_t low = acc->low + (uint32_t)charge;
+    if (charge < 0) {
+        // sign extend into the high half
+        --acc->high;
+    }
+    if (low < acc->low) {
+        ++acc->high;
+    }
+    acc->low = low;
+}
+
+// adds value x weight, which may need more than 32 bits, using only 32
+// bit multiplies
+inline void ChargeAccumulator_addProduct (
+    const int32_t value,
+    const uint16_t weight,
+    ChargeAccumulator *acc)
+{
+    // value is (value >> 16) * 2^16 + (the low 16 bits, unsigned)
+    const uint32_t lowProduct = (uint32_t)(uint16_t)value * weight;
+    const int32_t highProduct = (value >> 16) * (int32_t)weight;
+
+    uint32_t low = acc->low + lowProduct;
+    if (low < lowProduct) {
+        ++acc->high;
+    }
+    const uint32_t shiftedHighProduct = (uint32_t)highProduct << 16;
+    low += shiftedHighProduct;
+    if (low < shiftedHighProduct) {
+        ++acc->high;
+    }
+    acc->high += highProduct >> 16;
+    acc->low = low;
+}
+
+inline int64_t ChargeAccumulator_value (
+    const ChargeAccumulator *acc)
+{
+    return ((int64_t)acc->high << 32) | acc->low;
+}
+
+// returns magnitude / unit, rounded down, and the remainder in
+// 'remainder' (if it's not NULL). the result has to fit in 32 bits
+extern uint32_t ChargeAccumulator_divide (
+    const uint64_t magnitude,
+    const ChargeUnit *unit,
+    uint64_t *remainder);
+
+#endif  // CHARGEACCUMULATOR_H
@@ -0,0 +1,122 @@
+//
+// Checkpoint
+//
+
+#include "Checkpoint.h"
+
+#include <stddef.h>
+#include <util/crc16.h>
+#include "EEPROM.h"
+
+#define SLOT_SIZE sizeof(CheckpointRecord)
+#define NUM_SLOTS ((EEPROM_SCRATCH_ADDR - EEPROM_CHECKPOINT_ADDR) / SLOT_SIZE)
+
+static CheckpointRecord pending;    // the checkpoint being written
+static volatile bool writing;
+static uint8_t latestSlot;
+static uint32_t latestSequence;     // 0 if there is no checkpoint
+
+static uint16_t slotAddress (
+    const uint8_t slot)
+{
+    return EEPROM_CHECKPOINT_ADDR + (slot * SLOT_SIZE);
+}
+
+// CRC-16/CCITT of everything before the crc field
+static uint16_t recordCrc (
+    const CheckpointRecord *record)
+{
+    const uint8_t *bp = (const uint8_t*)record;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t b = 0; b < offsetof(CheckpointRecord, crc); ++b) {
+        crc = _crc_ccitt_update(crc, *bp++);
+    }
+    return crc;
+}
+
+static void writeCompletionHandler (
+    void *context)
+{
+    writing = false;
+}
+
+void Checkpoint_Initialize (void)
+{
+    writing = false;
+    latestSequence = 0;
+    // so that the first checkpoint goes in slot 0
+    latestSlot = NUM_SLOTS - 1;
+
+    CheckpointRecord record;
+    for (uint8_t slot = 0; slot < NUM_SLOTS; ++slot) {
+        EEPROM_readBlock(slotAddress(slot), SLOT_SIZE, &record);
+        // sequence numbers start at 1, so erased slots (all 1s) only
+        // pass if their CRC matches, which it doesn't
+        if ((record.crc == recordCrc(&record)) &&
+            (record.sequence > latestSequence)) {
+            latestSequence = record.sequence;
+            latestSlot = slot;
+        }
+    }
+}
+
+bool Checkpoint_restore (
+    CheckpointRecord *record)
+{
+    bool restored = false;
+
+    if (latestSequence != 0) {
+        EEPROM_readBlock(slotAddress(latestSlot), SLOT_SIZE, record);
+        restored = (record->crc == recordCrc(record));
+    }
+
+    return restored;
+}
+
+bool Checkpoint_save (
+    const CheckpointRecord *record)
+{
+    bool saved = false;
+
+    if (!writing) {
+        pending = *record;
+        pending.sequence = latestSequence + 1;
+        pending.crc = recordCrc(&pending);
+        const uint8_t slot = (latestSlot + 1) % NUM_SLOTS;
+        writing = true;
+        if (EEPROM_writeBlock(slotAddress(slot), SLOT_SIZE, &pending,
+            writeCompletionHandler, NULL)) {
+            latestSlot = slot;
+            latestSequence = pending.sequence;
+            saved = true;
+        } else {
+            writing = false;
+        }
+    }
+
+    return saved;
+}
+
+bool Checkpoint_clear (void)
+{
+    bool cleared = false;
+
+    if (!writing) {
+        writing = true;
+        if (EEPROM_fill(EEPROM_CHECKPOINT_ADDR, NUM_SLOTS * SLOT_SIZE, 0xFF,
+            writeCompletionHandler, NULL)) {
+            latestSequence = 0;
+            latestSlot = NUM_SLOTS - 1;
+            cleared = true;
+        } else {
+            writing = false;
+        }
+    }
+
+    return cleared;
+}
+
+uint32_t Checkpoint_sequence (void)
+{
+    return latestSequence;
+}
@@ -0,0 +1,65 @@
+//
+// Checkpoint
+//
+//  What it does:
+//    Keeps copies of the accumulated charge and energy totals in EEPROM
+//    so they survive a reset or a power cut. The checkpoint area is a
+//    ring of slots; each checkpoint goes in the slot after the latest
+//    one, so the writes are spread over all of them, and a checkpoint
+//    that is cut short by a reset leaves the one before it intact.
+//    Each slot has a sequence number, which goes up by one for each
+//    checkpoint, and a CRC. The latest checkpoint is the valid slot with
+//    the highest sequence number.
+//    The accumulators are stored as they are, along with the number of
+//    accumulator units in a uAh and a uWh, since those depend on the
+//    sample rate and shunt settings.
+//
+//  How to use it:
+//    Call Checkpoint_Initialize once at power-up, then Checkpoint_restore
+//    to get the latest checkpoint. Fill in a CheckpointRecord and call
+//    Checkpoint_save to write a new one. The write goes on in the
+//    background (see EEPROM.h).
+//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ChargeAccumulator.h"
+
+// channels beyond this aren't checkpointed, to keep the slots small
+#define CHECKPOINT_MAX_CHANNELS 4
+
+typedef struct CheckpointRecord_struct {
+    uint32_t sequence;              // set by Checkpoint_save
+    int32_t time;                   // mS since the totals were reset
+    uint64_t chargeUnitsPerMicroAmpHour;
+    uint64_t energyUnitsPerMicroWattHour;
+    uint8_t numChannels;
+    ChargeAccumulator charge[CHECKPOINT_MAX_CHANNELS];
+    ChargeAccumulator energy[CHECKPOINT_MAX_CHANNELS];
+    uint16_t crc;                   // set by Checkpoint_save
+} CheckpointRecord;
+
+// finds the latest checkpoint. reads the whole checkpoint area
+extern void Checkpoint_Initialize (void);
+
+// copies the latest checkpoint into record. returns false if there
+// isn't one
+extern bool Checkpoint_restore (
+    CheckpointRecord *record);
+
+// copies the record and queues it to be written to the next slot.
+// returns false if the last checkpoint (or clear) is still being written
+extern bool Checkpoint_save (
+    const CheckpointRecord *record);
+
+// erases all the checkpoints, in the background. returns false if the
+// last checkpoint is still being written
+extern bool Checkpoint_clear (void);
+
+// sequence number of the latest checkpoint, 0 if there isn't one
+extern uint32_t Checkpoint_sequence (void);
+
+#endif  // CHECKPOINT_H
@@ -1,95 +1,431 @@
-//
-// Command processor
-//
-// Interprets and executes commands from SMS or the console
-//
-
-#include "CommandProcessor.h"
-
-#include <stdlib.h>
-#include <avr/pgmspace.h>
-#include "USBTerminal.h"
-#include "SystemTime.h"
-#include "EEPROM.h"
-#include "Console.h"
-#include "I2CAsync.h"
-#include "StringUtils.h"
-#include "PowerMeter.h"
-
-#define CMD_TOKEN_BUFFER_LEN 80
-
-static const char tokenDelimiters[] = " \n\r";
-
-// appends n.nnV to outgoing message text
-static void appendVoltageToString (
-    const int16_t voltage,
-    CharString_t *str)
-{
-    StringUtils_appendDecimal(voltage, 1, 2, str);
-    CharString_appendP(PSTR("V"), str);
-}
-
-void CommandProcessor_processCommand (
-    const char* command)
-{
-#if 0
-	char msgbuf[80];
-    sprintf(msgbuf, "cmd: '%s'", command);
-    Console_print(msgbuf);
-    sprintf(msgbuf, "phone#: '%s'", phoneNumber);
-    Console_print(msgbuf);
-    sprintf(msgbuf, "time: '%s'", timestamp);
-    Console_print(msgbuf);
-#endif
-
-    char cmdTokenBuf[CMD_TOKEN_BUFFER_LEN];
-    strncpy(cmdTokenBuf, command, CMD_TOKEN_BUFFER_LEN-1);
-    cmdTokenBuf[CMD_TOKEN_BUFFER_LEN-1] = 0;
-    const char* cmdToken = strtok(cmdTokenBuf, tokenDelimiters);
-    if (cmdToken != NULL) {
-        if (strcasecmp_P(cmdToken, PSTR("reset")) == 0) {
-            PowerMeter_reset();
-        } else if (strcasecmp_P(cmdToken, PSTR("start")) == 0) {
-            PowerMeter_start();
-        } else if (strcasecmp_P(cmdToken, PSTR("stop")) == 0) {
-            PowerMeter_stop();
-        } else if (strcasecmp_P(cmdToken, PSTR("sample")) == 0) {
-            cmdToken = strtok(NULL, tokenDelimiters);
-            if (cmdToken != NULL) {
-                const unsigned int samplesPerSec = atoi(cmdToken);
-                Console_printP(PSTR("samples"));
-            }
-        } else if (strcasecmp_P(cmdToken, PSTR("report")) == 0) {
-            cmdToken = strtok(NULL, tokenDelimiters);
-            if (cmdToken != NULL) {
-                const unsigned int reportsPerSec = atoi(cmdToken);
-                Console_printP(PSTR("reports"));
-            }
-	} else if (strcasecmp_P(cmdToken, PSTR("eeread")) == 0) {
-            cmdToken = strtok(NULL, tokenDelimiters);
-            if (cmdToken != NULL) {
-                const unsigned int uiAddress = atoi(cmdToken);
-                const uint8_t eeromData = EEPROM_read(uiAddress);
-                CharString_define(30, eeromStr);
-                StringUtils_appendDecimal(uiAddress, 1, 0, &eeromStr);
-                CharString_appendP(PSTR(":"), &eeromStr);
-                StringUtils_appendDecimal(eeromData, 1, 0, &eeromStr);
-                Console_printCS(&eeromStr);
-            }
-        } else if (strcasecmp_P(cmdToken, PSTR("eewrite")) == 0) {
-            cmdToken = strtok(NULL, tokenDelimiters);
-            if (cmdToken != NULL) {
-                const unsigned int uiAddress = atoi(cmdToken);
-                cmdToken = strtok(NULL, tokenDelimiters);
-                if (cmdToken != NULL) {
-                    const uint8_t value = atoi(cmdToken);
-                    EEPROM_write(uiAddress, value);
-                }
-            }
-        } else {
-            Console_printP(PSTR("unrecognized command"));
-        }
-    }
-}
-//                uint32_t i1 = 30463UL;
-//                uint32_t i2 = 30582UL;
+//
+// Command processor
+//
+// Interprets and executes commands from SMS or the console
+//
+
+#include "CommandProcessor.h"
+
+#include <stdlib.h>
+#include <avr/pgmspace.h>
+#include "USBTerminal.h"
+#include "SystemTime.h"
+#include "EEPROM.h"
+#include "Console.h"
+#include "I2CAsync.h"
+#include "StringUtils.h"
+#include "PowerMeter.h"
+#include "Checkpoint.h"
+#include "Settings.h"
+#include "StackCheck.h"
+#include "ByteQueue.h"
+#include "ByteRing.h"
+
+#define CMD_TOKEN_BUFFER_LEN 80
+#define QBENCH_BYTES 64
+
+static const char tokenDelimiters[] = " \n\r";
+
+// parses a decimal number of at most maxValue into value. prints "bad
+// value" and returns false if the token isn't one, rather than letting it
+// wrap into the parameter it's meant for
+static bool parseNumber (
+    const char* token,
+    const uint32_t maxValue,
+    uint32_t *value)
+{
+    char *end;
+    const uint32_t number = strtoul(token, &end, 10);
+    const bool valid = (end != token) && (*end == 0) && (*token != '-') &&
+        (number <= maxValue);
+    if (valid) {
+        *value = number;
+    } else {
+        Console_printP(PSTR("bad value"));
+    }
+
+    return valid;
+}
+
+// appends the cycles per byte, to a tenth, that the given timer 3 counts
+// (8 cycles each) come to, less the counts it takes to read the timer
+static void appendCyclesPerByte (
+    const uint32_t counts,
+    const uint32_t overheadCounts,
+    CharString_t* destStr)
+{
+    StringUtils_appendDecimal32(
+        ((counts - overheadCounts) * 8 * 10) / QBENCH_BYTES, 1, 1, destStr);
+}
+
+// times QBENCH_BYTES bytes pushed then popped one at a time through a
+// ByteQueue and a ByteRing, and as one span through a ByteRing, with
+// interrupts off, and prints the cycles per byte of each, loop included.
+// the queue and the ring share a buffer on the stack
+static void benchmarkQueues (void)
+{
+    uint8_t buffer[QBENCH_BYTES];
+    uint8_t span[QBENCH_BYTES] = {0};
+    ByteQueue queue = {0, 0, 0, QBENCH_BYTES, buffer};
+    ByteRing ring = {0, 0, QBENCH_BYTES - 1, buffer};
+    volatile uint8_t sink;
+    uint32_t start;
+    uint32_t overheadCounts;
+    uint32_t queueCounts;
+    uint32_t ringCounts;
+    uint32_t spanCounts;
+
+    char SREGSave = SREG;
+    cli();
+    start = SystemTime_nowCounts();
+    overheadCounts = SystemTime_nowCounts() - start;
+
+    start = SystemTime_nowCounts();
+    for (uint8_t i = 0; i < QBENCH_BYTES; ++i) {
+        ByteQueue_push(i, &queue);
+    }
+    while (!ByteQueue_is_empty(&queue)) {
+        sink = ByteQueue_pop(&queue);
+    }
+    queueCounts = SystemTime_nowCounts() - start;
+
+    start = SystemTime_nowCounts();
+    for (uint8_t i = 0; i < QBENCH_BYTES; ++i) {
+        ByteRing_push(i, &ring);
+    }
+    while (!ByteRing_isEmpty(&ring)) {
+        sink = ByteRing_pop(&ring);
+    }
+    ringCounts = SystemTime_nowCounts() - start;
+
+    start = SystemTime_nowCounts();
+    ByteRing_pushSpan(span, QBENCH_BYTES, &ring);
+    sink = ByteRing_popSpan(span, QBENCH_BYTES, &ring);
+    spanCounts = SystemTime_nowCounts() - start;
+    SREG = SREGSave;
+    (void)sink;
+
+    CharString_define(70, benchStr);
+    CharString_copyP(PSTR("push+pop cycles/byte: queue "), &benchStr);
+    appendCyclesPerByte(queueCounts, overheadCounts, &benchStr);
+    CharString_appendP(PSTR(", ring "), &benchStr);
+    appendCyclesPerByte(ringCounts, overheadCounts, &benchStr);
+    CharString_appendP(PSTR(", span "), &benchStr);
+    appendCyclesPerByte(spanCounts, overheadCounts, &benchStr);
+    Console_printCS(&benchStr);
+}
+
+// appends n.nnV to outgoing message text
+static void appendVoltageToString (
+    const int16_t voltage,
+    CharString_t *str)
+{
+    StringUtils_appendDecimal(voltage, 1, 2, str);
+    CharString_appendP(PSTR("V"), str);
+}
+
+void CommandProcessor_processCommand (
+    const char* command)
+{
+#if 0
+	char msgbuf[80];
+    sprintf(msgbuf, "cmd: '%s'", command);
+    Console_print(msgbuf);
+    sprintf(msgbuf, "phone#: '%s'", phoneNumber);
+    Console_print(msgbuf);
+    sprintf(msgbuf, "time: '%s'", timestamp);
+    Console_print(msgbuf);
+#endif
+
+    char cmdTokenBuf[CMD_TOKEN_BUFFER_LEN];
+    strncpy(cmdTokenBuf, command, CMD_TOKEN_BUFFER_LEN-1);
+    cmdTokenBuf[CMD_TOKEN_BUFFER_LEN-1] = 0;
+    const char* cmdToken = strtok(cmdTokenBuf, tokenDelimiters);
+    if (cmdToken != NULL) {
+        if (strcasecmp_P(cmdToken, PSTR("reset")) == 0) {
+            PowerMeter_reset();
+        } else if (strcasecmp_P(cmdToken, PSTR("start")) == 0) {
+            PowerMeter_start();
+        } else if (strcasecmp_P(cmdToken, PSTR("stop")) == 0) {
+            PowerMeter_stop();
+        } else if (strcasecmp_P(cmdToken, PSTR("mode")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("timed")) == 0) {
+                    PowerMeter_setSampleMode(psm_timed);
+                } else if (strcasecmp_P(cmdToken, PSTR("cnvr")) == 0) {
+                    PowerMeter_setSampleMode(psm_conversionReady);
+                } else {
+                    Console_printP(PSTR("mode is timed or cnvr"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("scale")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("fw")) == 0) {
+                    PowerMeter_setScaling(pss_firmware);
+                } else if (strcasecmp_P(cmdToken, PSTR("hw")) == 0) {
+                    PowerMeter_setScaling(pss_hardware);
+                } else {
+                    Console_printP(PSTR("scale is fw or hw"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("range")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("auto")) == 0) {
+                    PowerMeter_setAutoRange(true);
+                } else if (strcasecmp_P(cmdToken, PSTR("fixed")) == 0) {
+                    PowerMeter_setAutoRange(false);
+                } else {
+                    Console_printP(PSTR("range is auto or fixed"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("format")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("text")) == 0) {
+                    PowerMeter_setOutputFormat(pof_text);
+                } else if (strcasecmp_P(cmdToken, PSTR("binary")) == 0) {
+                    PowerMeter_setOutputFormat(pof_binary);
+                } else {
+                    Console_printP(PSTR("format is text or binary"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("stream")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("on")) == 0) {
+                    PowerMeter_setRawStreaming(true);
+                } else if (strcasecmp_P(cmdToken, PSTR("off")) == 0) {
+                    PowerMeter_setRawStreaming(false);
+                } else {
+                    Console_printP(PSTR("stream is on or off"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("backpressure")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                if (strcasecmp_P(cmdToken, PSTR("on")) == 0) {
+                    PowerMeter_setBackPressure(true);
+                } else if (strcasecmp_P(cmdToken, PSTR("off")) == 0) {
+                    PowerMeter_setBackPressure(false);
+                } else {
+                    Console_printP(PSTR("backpressure is on or off"));
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("shunt")) == 0) {
+            const char* shuntToken = strtok(NULL, tokenDelimiters);
+            const char* currentToken = strtok(NULL, tokenDelimiters);
+            if ((shuntToken != NULL) && (currentToken != NULL)) {
+                uint32_t shuntMilliOhms;
+                uint32_t maxMilliAmps;
+                if (parseNumber(shuntToken, UINT16_MAX, &shuntMilliOhms) &&
+                    parseNumber(currentToken, UINT16_MAX, &maxMilliAmps)) {
+                    PowerMeter_setShunt(shuntMilliOhms, maxMilliAmps);
+                }
+            } else {
+                Console_printP(PSTR("shunt <mOhms> <max mA>"));
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("sample")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                uint32_t samplesPerSec;
+                if (parseNumber(cmdToken, UINT16_MAX, &samplesPerSec)) {
+                    PowerMeter_setSampleRate(samplesPerSec);
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("report")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                uint32_t reportIntervalMs;
+                if (parseNumber(cmdToken, UINT32_MAX, &reportIntervalMs)) {
+                    PowerMeter_setReportInterval(reportIntervalMs);
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("channels")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                uint32_t numChannels;
+                if (parseNumber(cmdToken, UINT8_MAX, &numChannels)) {
+                    PowerMeter_setNumChannels(numChannels);
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("config")) == 0) {
+            // the settings that are kept in EEPROM and used at power-up
+            cmdToken = strtok(NULL, tokenDelimiters);
+            const char* nameToken = strtok(NULL, tokenDelimiters);
+            const char* valueToken = strtok(NULL, tokenDelimiters);
+            PowerMeterSettings settings;
+            PowerMeter_getSettings(&settings);
+            if (cmdToken == NULL) {
+                Console_printP(PSTR("config get|set|save|defaults"));
+            } else if (strcasecmp_P(cmdToken, PSTR("get")) == 0) {
+                if (nameToken != NULL) {
+                    Settings_print(nameToken, &settings);
+                } else {
+                    Settings_printAll();
+                }
+            } else if (strcasecmp_P(cmdToken, PSTR("set")) == 0) {
+                if ((nameToken != NULL) && (valueToken != NULL)) {
+                    if (Settings_set(nameToken, valueToken, &settings)) {
+                        PowerMeter_applySettings(&settings);
+                    }
+                } else {
+                    Console_printP(PSTR("config set <name> <value>"));
+                }
+            } else if (strcasecmp_P(cmdToken, PSTR("save")) == 0) {
+                if (Settings_save(&settings)) {
+                    Console_printP(PSTR("saved"));
+                } else {
+                    Console_printP(PSTR("eeprom busy"));
+                }
+            } else if (strcasecmp_P(cmdToken, PSTR("defaults")) == 0) {
+                // not saved until config save
+                PowerMeter_defaultSettings(&settings);
+                PowerMeter_applySettings(&settings);
+            } else {
+                Console_printP(PSTR("config get|set|save|defaults"));
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("calibrate")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            const char* currentToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken == NULL) {
+                Console_printP(PSTR("calibrate zero|gain <mA>|clear"));
+            } else if (strcasecmp_P(cmdToken, PSTR("zero")) == 0) {
+                PowerMeter_calibrateZero();
+            } else if (strcasecmp_P(cmdToken, PSTR("gain")) == 0) {
+                if (currentToken != NULL) {
+                    uint32_t knownMilliAmps;
+                    if (parseNumber(currentToken, UINT16_MAX, &knownMilliAmps)) {
+                        PowerMeter_calibrateGain(knownMilliAmps);
+                    }
+                } else {
+                    Console_printP(PSTR("calibrate gain <known mA>"));
+                }
+            } else if (strcasecmp_P(cmdToken, PSTR("clear")) == 0) {
+                PowerMeter_clearCalibration();
+            } else {
+                Console_printP(PSTR("calibrate zero|gain <mA>|clear"));
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("checkpoint")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            if (cmdToken != NULL) {
+                uint32_t seconds;
+                if (parseNumber(cmdToken, UINT16_MAX, &seconds)) {
+                    PowerMeter_setCheckpointInterval(seconds);
+                }
+            } else {
+                CharString_define(30, checkpointStr);
+                CharString_copyP(PSTR("checkpoint: "), &checkpointStr);
+                StringUtils_appendDecimal32(Checkpoint_sequence(), 1, 0, &checkpointStr);
+                Console_printCS(&checkpointStr);
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("usb")) == 0) {
+            CharString_define(70, usbStr);
+            CharString_copyP(PSTR("usb bytes: "), &usbStr);
+            StringUtils_appendDecimal32(USBTerminal_bytesToHost(), 1, 0, &usbStr);
+            CharString_appendP(PSTR(", packets: "), &usbStr);
+            StringUtils_appendDecimal32(USBTerminal_packetsToHost(), 1, 0, &usbStr);
+            CharString_appendP(PSTR(", dropped lines: "), &usbStr);
+            StringUtils_appendDecimal32(USBTerminal_droppedLines(), 1, 0, &usbStr);
+            Console_printCS(&usbStr);
+        } else if (strcasecmp_P(cmdToken, PSTR("i2c")) == 0) {
+            CharString_define(60, i2cStr);
+            CharString_copyP(PSTR("i2c queue: "), &i2cStr);
+            StringUtils_appendDecimal(I2CAsync_queueLength(), 1, 0, &i2cStr);
+            CharString_appendP(PSTR(", max: "), &i2cStr);
+            StringUtils_appendDecimal(I2CAsync_queueHighWater(), 1, 0, &i2cStr);
+            CharString_appendP(PSTR(", rejected: "), &i2cStr);
+            StringUtils_appendDecimal32(I2CAsync_rejectedCount(), 1, 0, &i2cStr);
+            Console_printCS(&i2cStr);
+            CharString_copyP(PSTR("retries: "), &i2cStr);
+            StringUtils_appendDecimal32(I2CAsync_retryCount(), 1, 0, &i2cStr);
+            CharString_appendP(PSTR(", recoveries: "), &i2cStr);
+            StringUtils_appendDecimal32(I2CAsync_recoveryCount(), 1, 0, &i2cStr);
+            CharString_appendP(PSTR(", timeouts: "), &i2cStr);
+            StringUtils_appendDecimal32(I2CAsync_errorCount(isc_timeout), 1, 0, &i2cStr);
+            Console_printCS(&i2cStr);
+            // errors by TWI status code (in hex). 80+ is 0x80 and up
+            for (uint8_t status = isc_busError; status <= 0x80; status += 8) {
+                const uint16_t errorCount = I2CAsync_errorCount((I2CStatusCode)status);
+                if (errorCount > 0) {
+                    char statusBuf[4];
+                    CharString_copyP(PSTR("status "), &i2cStr);
+                    CharString_append(itoa(status, statusBuf, 16), &i2cStr);
+                    CharString_appendP((status == 0x80) ? PSTR("+: ") : PSTR(": "), &i2cStr);
+                    StringUtils_appendDecimal32(errorCount, 1, 0, &i2cStr);
+                    Console_printCS(&i2cStr);
+                }
+            }
+	} else if (strcasecmp_P(cmdToken, PSTR("eeread")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            uint32_t uiAddress;
+            if ((cmdToken != NULL) &&
+                parseNumber(cmdToken, UINT16_MAX, &uiAddress)) {
+                const uint8_t eeromData = EEPROM_read(uiAddress);
+                CharString_define(30, eeromStr);
+                StringUtils_appendDecimal(uiAddress, 1, 0, &eeromStr);
+                CharString_appendP(PSTR(":"), &eeromStr);
+                StringUtils_appendDecimal(eeromData, 1, 0, &eeromStr);
+                Console_printCS(&eeromStr);
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("eewrite")) == 0) {
+            cmdToken = strtok(NULL, tokenDelimiters);
+            uint32_t uiAddress;
+            if ((cmdToken != NULL) &&
+                parseNumber(cmdToken, UINT16_MAX, &uiAddress)) {
+                cmdToken = strtok(NULL, tokenDelimiters);
+                uint32_t value;
+                if ((cmdToken != NULL) &&
+                    parseNumber(cmdToken, UINT8_MAX, &value)) {
+                    if (!EEPROM_write(uiAddress, value)) {
+                        Console_printP(PSTR("eeprom busy"));
+                    }
+                }
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("eefill")) == 0) {
+            // writes in the background, so it can be used while sampling
+            const char* addressToken = strtok(NULL, tokenDelimiters);
+            const char* lengthToken = strtok(NULL, tokenDelimiters);
+            const char* valueToken = strtok(NULL, tokenDelimiters);
+            if ((addressToken != NULL) && (lengthToken != NULL) &&
+                (valueToken != NULL)) {
+                uint32_t address;
+                uint32_t length;
+                uint32_t value;
+                if (parseNumber(addressToken, UINT16_MAX, &address) &&
+                    parseNumber(lengthToken, UINT16_MAX, &length) &&
+                    parseNumber(valueToken, UINT8_MAX, &value) &&
+                    !EEPROM_fill(address, length, value, NULL, NULL)) {
+                    Console_printP(PSTR("eeprom busy or out of range"));
+                }
+            } else {
+                Console_printP(PSTR("eefill <address> <length> <value>"));
+            }
+        } else if (strcasecmp_P(cmdToken, PSTR("eestat")) == 0) {
+            CharString_define(50, eeStr);
+            CharString_copyP(PSTR("eeprom written: "), &eeStr);
+            StringUtils_appendDecimal32(EEPROM_bytesWritten(), 1, 0, &eeStr);
+            CharString_appendP(PSTR(", unchanged: "), &eeStr);
+            StringUtils_appendDecimal32(EEPROM_bytesSkipped(), 1, 0, &eeStr);
+            CharString_appendP(EEPROM_isIdle() ? PSTR(", idle") : PSTR(", busy"), &eeStr);
+            Console_printCS(&eeStr);
+        } else if (strcasecmp_P(cmdToken, PSTR("eetest")) == 0) {
+            PowerMeter_testEEPROM();
+        } else if (strcasecmp_P(cmdToken, PSTR("sbench")) == 0) {
+            PowerMeter_benchmarkScaling();
+        } else if (strcasecmp_P(cmdToken, PSTR("stack")) == 0) {
+            CharString_define(30, stackStr);
+            CharString_copyP(PSTR("stack never used: "), &stackStr);
+            StringUtils_appendDecimal32(StackCheck_unusedBytes(), 1, 0, &stackStr);
+            Console_printCS(&stackStr);
+        } else if (strcasecmp_P(cmdToken, PSTR("qbench")) == 0) {
+            benchmarkQueues();
+        } else {
+            Console_printP(PSTR("unrecognized command"));
+        }
+    }
+}
+//                uint32_t i1 = 30463UL;
+//                uint32_t i2 = 30582UL;
@@ -1,28 +1,35 @@
-//
-//  Console
-//
-//  This unit responds to commands from the USB host
-//
-#ifndef CONSOLE_H
-#define CONSOLE_H
-
-#include "CharString.h"
-
-// sets up control pins. called once at power-up
-extern void Console_Initialize (void);
-
-// reads commands from FromUSB_Buffer and writes responses to
-// ToUSB_Buffer.
-// called in each iteration of the mainloop
-extern void Console_task (void);
-
-extern void Console_print (
-    const char* text);
-
-extern void Console_printP (
-    PGM_P text);
-
-extern void Console_printCS (
-    const CharString_t *text);
-
-#endif  // Console_H
+//
+//  Console
+//
+//  This unit responds to commands from the USB host
+//
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "CharString.h"
+
+// sets up control pins. called once at power-up
+extern void Console_Initialize (void);
+
+// reads commands from FromUSB_Buffer and writes responses to
+// ToUSB_Buffer.
+// called in each iteration of the mainloop
+extern void Console_task (void);
+
+extern void Console_print (
+    const char* text);
+
+extern void Console_printP (
+    PGM_P text);
+
+extern void Console_printCS (
+    const CharString_t *text);
+
+// sends part of a line, for lines too long to build in one go. a part is
+// sent whole or not at all; returns true if it was sent. lines from the
+// other Console_print functions are dropped until the line is ended
+extern bool Console_printPartCS (
+    const CharString_t *text,
+    const bool endsLine);
+
+#endif  // Console_H
@@ -1,35 +1,245 @@
-//
-// EEPROM access
-//
-
-#include "EEPROM.h"
-
-void EEPROM_write (
-    const unsigned int uiAddress,
-    const uint8_t ucData)
-{
-    /* Wait for completion of previous write */
-    while(EECR & (1<<EEPE))
-        ;
-    /* Set up address and Data Registers */
-    EEAR = uiAddress;
-    EEDR = ucData;
-    /* Write logical one to EEMPE */
-    EECR |= (1<<EEMPE);
-    /* Start eeprom write by setting EEPE */
-    EECR |= (1<<EEPE);
-}
-
-uint8_t EEPROM_read (
-    const unsigned int uiAddress)
-{
-    /* Wait for completion of previous write */
-    while (EECR & (1<<EEPE))
-        ;
-    /* Set up address register */
-    EEAR = uiAddress;
-    /* Start eeprom read by writing EERE */
-    EECR |= (1<<EERE);
-    /* Return data from Data Register */
-    return EEDR;
-}
\ No newline at end of file
+//
+// EEPROM access
+//
+
+#include "EEPROM.h"
+
+#include <stddef.h>
+#include <avr/interrupt.h>
+
+#define QUEUE_MASK (EEPROM_QUEUE_LEN - 1)
+
+// EEPM1:0 programming modes
+#define MODE_ERASE_AND_WRITE 0
+#define MODE_ERASE_ONLY (1<<EEPM0)
+#define MODE_WRITE_ONLY (1<<EEPM1)
+
+#define MAX_BYTES_CHECKED_PER_INTERRUPT 16
+
+// a queued write. address, data and length are advanced as the bytes
+// are written
+typedef struct EEPROMWrite_struct {
+    uint16_t address;
+    uint16_t length;            // bytes left to write
+    const uint8_t *data;        // NULL to write fillValue
+    uint8_t fillValue;
+    EEPROM_CompletionHandler completionHandler;
+    void *context;
+} EEPROMWrite;
+
+static EEPROMWrite writeQueue[EEPROM_QUEUE_LEN];
+static volatile uint8_t queueHead;      // write in progress
+static volatile uint8_t queueLength;    // includes write in progress
+static volatile uint32_t bytesWritten;
+static volatile uint32_t bytesSkipped;
+
+// reads a byte. expects EEPE to be clear
+static uint8_t readByte (
+    const uint16_t address)
+{
+    EEAR = address;
+    EECR |= (1<<EERE);
+    return EEDR;
+}
+
+// starts writing one byte, using the shortest operation that will do.
+// called with interrupts disabled, and EEPE clear
+static void startByteWrite (
+    const uint16_t address,
+    const uint8_t oldValue,
+    const uint8_t newValue)
+{
+    uint8_t mode;
+    if (newValue == 0xFF) {
+        mode = MODE_ERASE_ONLY;
+    } else if ((oldValue & newValue) == newValue) {
+        // only clears bits
+        mode = MODE_WRITE_ONLY;
+    } else {
+        mode = MODE_ERASE_AND_WRITE;
+    }
+
+    EEAR = address;
+    EEDR = newValue;
+    // EEMPE must be set, then EEPE within 4 cycles
+    EECR = (EECR & ~((1<<EEPM1) | (1<<EEPM0))) | mode | (1<<EEMPE);
+    EECR |= (1<<EEPE);
+}
+
+static bool queueWrite (
+    const uint16_t address,
+    const uint16_t length,
+    const uint8_t *data,
+    const uint8_t fillValue,
+    EEPROM_CompletionHandler completionHandler,
+    void *context)
+{
+    bool queued = false;
+
+    if ((length <= EEPROM_SIZE) && (address <= (EEPROM_SIZE - length))) {
+        char SREGSave;
+        SREGSave = SREG;
+        cli();
+
+        if (queueLength < EEPROM_QUEUE_LEN) {
+            EEPROMWrite *write =
+                &writeQueue[(queueHead + queueLength) & QUEUE_MASK];
+            write->address = address;
+            write->length = length;
+            write->data = data;
+            write->fillValue = fillValue;
+            write->completionHandler = completionHandler;
+            write->context = context;
+            ++queueLength;
+            // the ready interrupt fires as soon as EEPE is clear
+            EECR |= (1<<EERIE);
+            queued = true;
+        }
+
+        SREG = SREGSave;
+    }
+
+    return queued;
+}
+
+bool EEPROM_isIdle (void)
+{
+    char SREGSave;
+    SREGSave = SREG;
+    cli();
+
+    const bool idle = queueLength == 0;
+
+    SREG = SREGSave;
+
+    return idle;
+}
+
+bool EEPROM_writeBlock (
+    const uint16_t address,
+    const uint16_t length,
+    const void *data,
+    EEPROM_CompletionHandler completionHandler,
+    void *context)
+{
+    return queueWrite(address, length, (const uint8_t*)data, 0,
+        completionHandler, context);
+}
+
+bool EEPROM_fill (
+    const uint16_t address,
+    const uint16_t length,
+    const uint8_t value,
+    EEPROM_CompletionHandler completionHandler,
+    void *context)
+{
+    return queueWrite(address, length, NULL, value,
+        completionHandler, context);
+}
+
+bool EEPROM_write (
+    const unsigned int uiAddress,
+    const uint8_t ucData)
+{
+    return queueWrite(uiAddress, 1, NULL, ucData, NULL, NULL);
+}
+
+void EEPROM_readBlock (
+    const uint16_t address,
+    const uint16_t length,
+    void *data)
+{
+    char SREGSave;
+    SREGSave = SREG;
+    cli();
+    // keep the ready interrupt from starting another write while we read
+    const uint8_t readyInterrupt = EECR & (1<<EERIE);
+    EECR &= ~(1<<EERIE);
+    SREG = SREGSave;
+
+    // wait (with interrupts on) for the byte being written
+    while (EECR & (1<<EEPE))
+        ;
+    uint8_t *bp = (uint8_t*)data;
+    for (uint16_t i = 0; i < length; ++i) {
+        *bp++ = readByte(address + i);
+    }
+
+    cli();
+    EECR |= readyInterrupt;
+    SREG = SREGSave;
+}
+
+uint8_t EEPROM_read (
+    const unsigned int uiAddress)
+{
+    uint8_t value;
+    EEPROM_readBlock(uiAddress, 1, &value);
+    return value;
+}
+
+uint32_t EEPROM_bytesWritten (void)
+{
+    char SREGSave;
+    SREGSave = SREG;
+    cli();
+    const uint32_t count = bytesWritten;
+    SREG = SREGSave;
+    return count;
+}
+
+uint32_t EEPROM_bytesSkipped (void)
+{
+    char SREGSave;
+    SREGSave = SREG;
+    cli();
+    const uint32_t count = bytesSkipped;
+    SREG = SREGSave;
+    return count;
+}
+
+// called whenever EEPE is clear and EERIE is set. starts the next byte
+// write that changes something, or turns itself off when the queue is
+// empty. a write is complete (and its handler is called) the next time
+// round after its last byte was started
+ISR(EE_READY_vect)
+{
+    // reading an unchanged byte takes a few cycles. this bounds the time
+    // spent here with interrupts off; the interrupt fires again straight
+    // away to carry on, after any other pending interrupts
+    uint8_t bytesToCheck = MAX_BYTES_CHECKED_PER_INTERRUPT;
+
+    while (queueLength > 0) {
+        EEPROMWrite *write = &writeQueue[queueHead];
+        if (write->length == 0) {
+            // the handler may queue another write in this slot
+            const EEPROM_CompletionHandler completionHandler =
+                write->completionHandler;
+            void *context = write->context;
+            queueHead = (queueHead + 1) & QUEUE_MASK;
+            --queueLength;
+            if (completionHandler != NULL) {
+                completionHandler(context);
+            }
+        } else if (bytesToCheck == 0) {
+            return;
+        } else {
+            --bytesToCheck;
+            const uint16_t address = write->address;
+            const uint8_t newValue = (write->data != NULL)
+                ? *write->data++
+                : write->fillValue;
+            ++write->address;
+            --write->length;
+            const uint8_t oldValue = readByte(address);
+            if (oldValue != newValue) {
+                startByteWrite(address, oldValue, newValue);
+                ++bytesWritten;
+                return;
+            }
+            ++bytesSkipped;
+        }
+    }
+
+    EECR &= ~(1<<EERIE);
+}
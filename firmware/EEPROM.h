@@ -1,16 +1,84 @@
-//
-// EEPROM access
-//
-#ifndef EEPROM_H
-#define EEPROM_H
-
-#include <avr/io.h> // for integer type definitions
-
-extern void EEPROM_write (
-    const unsigned int uiAddress,
-    const uint8_t ucData);
-
-uint8_t EEPROM_read (
-    const unsigned int uiAddress);
-
-#endif  // EEPROM_H
+//
+// EEPROM access
+//
+//  What it does:
+//    Reads the EEPROM directly, and writes it in the background. Writes
+//    are queued and carried out one byte at a time by the EEPROM ready
+//    interrupt, so the mainloop never waits the 3.4mS a byte write takes.
+//    Bytes that already hold the value being written are skipped, and
+//    bytes that only need bits cleared (or only set) use the shorter
+//    write-only (or erase-only) operation.
+//
+//  How to use it:
+//    Call EEPROM_writeBlock to queue a write of a block of data. The data
+//    is not copied, so it must be left alone until the completion handler
+//    is called (or until EEPROM_isIdle returns true). Completion handlers
+//    are called from the interrupt handler.
+//    EEPROM_read returns what is in the EEPROM now, not writes that are
+//    still queued.
+//
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <avr/io.h> // for integer type definitions
+#include <stdbool.h>
+
+// number of writes that can be queued, including the one in progress.
+// must be a power of 2
+#define EEPROM_QUEUE_LEN 4
+
+#define EEPROM_SIZE (E2END + 1)
+
+// EEPROM layout
+#define EEPROM_SETTINGS_ADDR 0x000      // Settings record, up to 64 bytes
+#define EEPROM_CALIBRATION_ADDR 0x040   // Calibration record, up to 64 bytes
+#define EEPROM_CHECKPOINT_ADDR 0x080    // Checkpoint slots, up to scratch
+#define EEPROM_SCRATCH_SIZE 64
+#define EEPROM_SCRATCH_ADDR (EEPROM_SIZE - EEPROM_SCRATCH_SIZE) // for tests
+
+typedef void (*EEPROM_CompletionHandler)(
+    void *context);
+
+// returns true if there are no writes queued or in progress
+extern bool EEPROM_isIdle (void);
+
+// queues a write of length bytes from data to the EEPROM at address.
+// completionHandler (which may be NULL) is called with context when the
+// last byte has been written. returns false if the queue is full or the
+// block doesn't fit in the EEPROM
+extern bool EEPROM_writeBlock (
+    const uint16_t address,
+    const uint16_t length,
+    const void *data,
+    EEPROM_CompletionHandler completionHandler,
+    void *context);
+
+// queues a write of value to length bytes starting at address. returns
+// false if the queue is full or the bytes don't fit in the EEPROM
+extern bool EEPROM_fill (
+    const uint16_t address,
+    const uint16_t length,
+    const uint8_t value,
+    EEPROM_CompletionHandler completionHandler,
+    void *context);
+
+// queues a write of one byte. returns false if the queue is full
+extern bool EEPROM_write (
+    const unsigned int uiAddress,
+    const uint8_t ucData);
+
+// these wait for a byte write in progress to finish (at most 3.4mS), but
+// not for the rest of the queue
+extern uint8_t EEPROM_read (
+    const unsigned int uiAddress);
+
+extern void EEPROM_readBlock (
+    const uint16_t address,
+    const uint16_t length,
+    void *data);
+
+// number of bytes written, and skipped because they were unchanged
+extern uint32_t EEPROM_bytesWritten (void);
+extern uint32_t EEPROM_bytesSkipped (void);
+
+#endif  // EEPROM_H
@@ -1,260 +1,522 @@
-//
-//  I2C Asynchronous interface
-//
-
-#include "I2CAsync.h"
-#include <avr/io.h>
-
-#include "Console.h"
-#include "SystemTime.h"
-#include <stdlib.h>
-
-#define TIMEOUT_INTERVAL (0.1 * SYSTEMTIME_TICKS_PER_SECOND)
-
-typedef enum I2CState_enum {
-    is_idle,
-    is_waitingForWriteStartTransmission,
-    is_waitingForSLAWTransmission,
-    is_waitingForDataByteWrite,
-    is_waitingForReadStartTransmission,
-    is_waitingForSLARTransmission,
-    is_waitingForDataByteRead
-} I2CState;
-
-// state variables
-static I2CState i2cState;
-static uint8_t i2cAddress;
-static uint8_t i2cWriteDataLength;
-static const uint8_t* i2cWriteData;
-static uint8_t i2cReadDataLength;
-static uint8_t* i2cReadData;
-static uint8_t i2cDataCount;
-static I2CAsync_CompletionHandler i2cCompletionHandler;
-static SystemTime_t timeoutTime;
-
-static void sendStart (void)
-{
-    TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-}
-
-static void sendStop (void)
-{
-    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
-}
-
-static I2CStatusCode i2cStatus (void)
-{
-    return ((I2CStatusCode)(TWSR & 0xF8));
-}
-
-static void terminateRead (
-    const I2CStatusCode status)
-{
-    sendStop();
-    i2cState = is_idle;
-    i2cCompletionHandler(false, status, 0, NULL);
-}
-
-static void terminateWrite (
-    const I2CStatusCode status)
-{
-    sendStop();
-    i2cState = is_idle;
-    i2cCompletionHandler(false, status, 0, NULL);
-}
-
-static void checkTimeout (void)
-{
-    if (SystemTime_timeHasArrived(&timeoutTime)) {
-        sendStop();
-        TWCR &= ~(1<<TWEN);
-        i2cState = is_idle;
-        i2cCompletionHandler(false, isc_timeout, 0, NULL);
-    }
-}
-
-static void printStatus (void)
-{
-    const I2CStatusCode status = i2cStatus();
-    CharString_define(20, str);
-    CharString_copyP(PSTR("i2c status: "), &str);
-    char statbuf[10];
-    itoa((uint8_t)status, statbuf, 16);
-    CharString_append(statbuf, &str);
-    Console_printCS(&str);
-}
-
-void I2CAsync_Initialize (void)
-{
-    TWBR = 3;   // with a 16MHz CPU clock this makes the SCL frequency 400KHz
-
-    i2cState = is_idle;
-}
-
-void I2CAsync_task (void)
-{
-    switch (i2cState) {
-        case is_idle :
-            break;
-        case is_waitingForWriteStartTransmission :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if (status == isc_startTransmitted) {
-                    // start has been transmitted
-                    // send SLA+W
-                    TWDR = (i2cAddress << 1) & 0xFE; 
-                    TWCR = (1<<TWINT) | (1<<TWEN);
-                    i2cState = is_waitingForSLAWTransmission;
-                    SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                } else {
-                    // unexpected status
-                    terminateWrite(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-        case is_waitingForSLAWTransmission :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if (status == isc_SLAWACK) {
-                    // write first data byte
-                    TWDR = i2cWriteData[0];
-                    TWCR = (1<<TWINT) | (1<<TWEN);
-                    i2cDataCount = 1;
-                    i2cState = is_waitingForDataByteWrite;
-                    SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                } else {
-                    // unexpected status
-                    terminateWrite(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-        case is_waitingForDataByteWrite :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if (status == isc_dataTransmittedAck) {
-                    if (i2cDataCount < i2cWriteDataLength) {
-                        TWDR = i2cWriteData[i2cDataCount++];
-                        TWCR = (1<<TWINT) | (1<<TWEN);
-                    } else {
-                        // all bytes written
-                        sendStop();
-                        if (i2cReadDataLength > 0) {
-                            // we are reading data after this write
-                            sendStart();
-                            i2cState = is_waitingForReadStartTransmission;
-                        } else {
-                            i2cState = is_idle;
-                            i2cCompletionHandler(true, status, 0, i2cReadData);
-                        }
-                    }
-                    SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                } else {
-                    // unexpected status
-                    terminateWrite(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-        case is_waitingForReadStartTransmission :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if (status == isc_startTransmitted) {
-                    // start has been transmitted
-                    // send SLA+R
-                    TWDR = ((i2cAddress << 1) & 0xFE) | 0x01; 
-                    TWCR = (1<<TWINT) | (1<<TWEN);
-                    i2cState = is_waitingForSLARTransmission;
-                    SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                } else {
-                    // unexpected status
-                    terminateRead(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-        case is_waitingForSLARTransmission :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if (status == isc_SLARACK) {
-                    // request first data byte
-                    TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
-                    i2cDataCount = 0;
-                    i2cState = is_waitingForDataByteRead;
-                    SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                } else {
-                    // unexpected status
-                    terminateRead(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-        case is_waitingForDataByteRead :
-            if (TWCR & (1<<TWINT)) {
-                const I2CStatusCode status = i2cStatus();
-                if ((status == isc_dataReceivedAck) ||
-                    (status == isc_dataReceicedNack)) {
-                    i2cReadData[i2cDataCount++] = TWDR;
-                    if (i2cDataCount < i2cReadDataLength) {
-                        // request next or last data byte
-                        TWCR = (1<<TWINT) | (1<<TWEN) | 
-                            ((i2cDataCount < (i2cReadDataLength - 1))
-                            ? (1<<TWEA) // next byte
-                            : 0);       // last byte
-                        SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-                    } else {
-                        // all bytes read
-                        sendStop();
-                        i2cState = is_idle;
-                        i2cCompletionHandler(true, status, i2cDataCount, i2cReadData);
-                    }
-                } else {
-                    // unexpected status
-                    terminateRead(status);
-                }
-            } else {
-                checkTimeout();
-            }
-            break;
-    }
-}
-
-bool I2CAsync_isIdle (void)
-{
-    return (i2cState == is_idle);
-}
-
-extern bool I2CAsync_transferData (
-    const uint8_t address,
-    const uint8_t writeDataLength,
-    const uint8_t *writeData,
-    const uint8_t readDataLength,
-    uint8_t *readData,
-    I2CAsync_CompletionHandler completionHandler)
-{
-    bool startedSuccessfully = false;
-
-    if (I2CAsync_isIdle()) {
-        i2cAddress = address;
-        i2cWriteDataLength = writeDataLength;
-        i2cWriteData = writeData;
-        i2cReadDataLength = readDataLength;
-        i2cReadData = readData;
-        i2cCompletionHandler = completionHandler;
-        sendStart();
-        i2cState = (writeDataLength > 0) 
-            ? is_waitingForWriteStartTransmission
-            : is_waitingForReadStartTransmission;
-        SystemTime_futureTime(TIMEOUT_INTERVAL, &timeoutTime);
-
-        startedSuccessfully = true;
-    }
-
-    return startedSuccessfully;
-}
+//
+//  I2C Asynchronous interface
+//
+
+#include "I2CAsync.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+
+#include "Log.h"
+#include "SystemTime.h"
+#include <stdlib.h>
+
+// set to 1 to have I2CAsync_task poll TWINT and advance transfers from the
+// mainloop instead of from the TWI interrupt
+#ifndef I2CASYNC_POLLED
+#define I2CASYNC_POLLED 0
+#endif
+
+// a transfer is abandoned if any one step of it takes longer than this.
+// at 400KHz a step takes about 25uS
+#define TIMEOUT_MICROS 1000
+#define TIMEOUT_TICKS SYSTEMTIME_MICROS_TO_TICKS(TIMEOUT_MICROS)
+
+#define QUEUE_MASK (I2CASYNC_QUEUE_LEN - 1)
+
+// a failed transfer is tried this many more times before its completion
+// handler is told it failed
+#define MAX_RETRIES 2
+
+// TWI pins, for clocking out a slave that is holding SDA low
+#define I2C_PORT      PORTD
+#define I2C_DIR       DDRD
+#define I2C_IN        PIND
+#define SCL_PIN       PD0
+#define SDA_PIN       PD1
+#define CLOCK_OUT_PULSES 9
+#define HALF_BIT_MICROS 5   // 100KHz while bit banging
+
+// errorCounts has a slot for each status code from 0x00 to 0x80 (status
+// code / 8), where 0x80 also counts every code above it, and one for
+// timeouts
+#define LAST_STATUS_COUNT 16                    // 0x80 and up
+#define TIMEOUT_COUNT (LAST_STATUS_COUNT + 1)
+#define NUM_ERROR_COUNTS (TIMEOUT_COUNT + 1)
+
+typedef enum I2CState_enum {
+    is_idle,
+    is_waitingForWriteStartTransmission,
+    is_waitingForSLAWTransmission,
+    is_waitingForDataByteWrite,
+    is_waitingForReadStartTransmission,
+    is_waitingForSLARTransmission,
+    is_waitingForDataByteRead
+} I2CState;
+
+// a queued transfer. carries its own copy of the data to write, and a
+// place for the data read
+typedef struct I2CTransaction_struct {
+    uint8_t address;
+    uint8_t writeDataLength;
+    uint8_t writeData[I2CASYNC_MAX_DATA_LEN];
+    uint8_t readDataLength;
+    uint8_t readData[I2CASYNC_MAX_DATA_LEN];
+    uint8_t retriesRemaining;
+    I2CAsync_CompletionHandler completionHandler;
+    void *context;          // passed to the completion handler
+} I2CTransaction;
+
+// state variables
+static volatile I2CState i2cState;
+static I2CTransaction transactionQueue[I2CASYNC_QUEUE_LEN];
+static volatile uint8_t queueHead;      // transaction in progress
+static volatile uint8_t queueLength;    // includes transaction in progress
+static uint8_t queueHighWater;
+static uint16_t rejectedCount;
+static uint16_t errorCounts[NUM_ERROR_COUNTS];
+static uint16_t retryCount;
+static uint16_t recoveryCount;
+static I2CTransaction* transaction;     // transaction in progress
+static uint8_t i2cDataCount;
+static SystemTime_Tick_t timeoutTime;
+
+// writes the given control bits to TWCR, enabling the TWI interrupt
+// unless transfers are polled
+static void setControl (
+    const uint8_t controlBits)
+{
+#if I2CASYNC_POLLED
+    TWCR = controlBits | (1<<TWEN);
+#else
+    TWCR = controlBits | (1<<TWEN) | (1<<TWIE);
+#endif
+}
+
+static void sendStart (void)
+{
+    // let a STOP that was just requested go out on the bus first
+    while (TWCR & (1<<TWSTO))
+        ;
+    setControl((1<<TWINT) | (1<<TWSTA));
+}
+
+static void sendStop (void)
+{
+    // STOP does not set TWINT, so no interrupt is needed for it
+    TWCR = (1<<TWINT) | (1<<TWSTO) | (1<<TWEN);
+}
+
+static I2CStatusCode i2cStatus (void)
+{
+    return ((I2CStatusCode)(TWSR & 0xF8));
+}
+
+// starts the transaction at the head of the queue, if there is one
+// and the bus is not already in use. called with interrupts disabled
+static void startNextTransaction (void)
+{
+    if ((i2cState == is_idle) && (queueLength > 0)) {
+        transaction = &transactionQueue[queueHead];
+        sendStart();
+        i2cState = (transaction->writeDataLength > 0)
+            ? is_waitingForWriteStartTransmission
+            : is_waitingForReadStartTransmission;
+        SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+    }
+}
+
+// takes the finished transaction off the queue, calls its completion
+// handler, and goes straight on to the next queued transaction
+static void completeTransaction (
+    const bool success,
+    const I2CStatusCode status)
+{
+    // copy out what the handler needs so that the queue slot is free
+    // for the handler to queue another transaction
+    const I2CAsync_CompletionHandler completionHandler =
+        transaction->completionHandler;
+    void *context = transaction->context;
+    const uint8_t readDataLength = success ? i2cDataCount : 0;
+    uint8_t readData[I2CASYNC_MAX_DATA_LEN];
+    memcpy(readData, transaction->readData, readDataLength);
+    queueHead = (queueHead + 1) & QUEUE_MASK;
+    --queueLength;
+    i2cState = is_idle;
+
+    if (completionHandler != NULL) {
+        completionHandler(success, status, readDataLength, readData, context);
+    }
+
+    startNextTransaction();
+}
+
+// resets the TWI and gets the bus back to idle. if a slave is holding SDA
+// low (because it was interrupted in the middle of sending a byte) we clock
+// SCL by hand until it lets go, then send a STOP by hand.
+static void recoverBus (void)
+{
+    ++recoveryCount;
+
+    // disable the TWI so we can drive the pins directly. the pins are
+    // open drain: we pull a line low by making it an output (port bit is
+    // 0) and release it by making it an input
+    TWCR = 0;
+    I2C_PORT &= ~((1 << SCL_PIN) | (1 << SDA_PIN));
+    I2C_DIR &= ~((1 << SCL_PIN) | (1 << SDA_PIN));
+    _delay_us(HALF_BIT_MICROS);
+
+    uint8_t pulses = 0;
+    while ((pulses < CLOCK_OUT_PULSES) && !(I2C_IN & (1 << SDA_PIN))) {
+        I2C_DIR |= (1 << SCL_PIN);
+        _delay_us(HALF_BIT_MICROS);
+        I2C_DIR &= ~(1 << SCL_PIN);
+        _delay_us(HALF_BIT_MICROS);
+        ++pulses;
+    }
+
+    // STOP: SDA goes from low to high while SCL is high
+    I2C_DIR |= (1 << SDA_PIN);
+    _delay_us(HALF_BIT_MICROS);
+    I2C_DIR &= ~(1 << SDA_PIN);
+    _delay_us(HALF_BIT_MICROS);
+
+    // the TWI is enabled again by the next START
+}
+
+// returns the errorCounts slot for a status code
+static uint8_t errorCountIndex (
+    const I2CStatusCode status)
+{
+    uint8_t index;
+    if (status == isc_timeout) {
+        index = TIMEOUT_COUNT;
+    } else {
+        index = ((uint8_t)status) >> 3;
+        if (index > LAST_STATUS_COUNT) {
+            index = LAST_STATUS_COUNT;
+        }
+    }
+
+    return index;
+}
+
+// ends a transfer that went wrong. the transfer is tried again, from the
+// START, until it runs out of retries; then its completion handler is
+// told it failed. a transfer that timed out is not tried again: it has
+// already held the bus for TIMEOUT_MICROS, and a slave that stalled once
+// is likely to stall again, so it would hold up the transfers queued
+// behind it (the next samples) for three times as long
+static void failTransaction (
+    const I2CStatusCode status)
+{
+    ++errorCounts[errorCountIndex(status)];
+
+    switch (status) {
+        case isc_busError :
+        case isc_SLAArbitrationLost :
+        case isc_timeout :
+            // the bus, or the TWI, is in an unknown state
+            recoverBus();
+            break;
+        default :
+            // the slave NACKed. the bus is fine, just release it
+            sendStop();
+            break;
+    }
+
+    if ((transaction->retriesRemaining > 0) && (status != isc_timeout)) {
+        --transaction->retriesRemaining;
+        ++retryCount;
+        i2cState = is_idle;
+        startNextTransaction();     // same transaction is still at the head
+    } else {
+        completeTransaction(false, status);
+    }
+}
+
+static void checkTimeout (void)
+{
+    // the TWI interrupt may complete the transfer while we are looking
+    // at it, so check and terminate with interrupts disabled
+    char SREGSave = SREG;
+    cli();
+    if ((i2cState != is_idle) &&
+        SystemTime_tickHasArrived(&timeoutTime)) {
+        failTransaction(isc_timeout);
+    }
+    SREG = SREGSave;
+}
+
+static void printStatus (void)
+{
+    Log_message1("i2c status: %x", (uint8_t)i2cStatus());
+}
+
+void I2CAsync_Initialize (void)
+{
+    TWBR = 3;   // with a 16MHz CPU clock this makes the SCL frequency 400KHz
+
+    i2cState = is_idle;
+    queueHead = 0;
+    queueLength = 0;
+    queueHighWater = 0;
+    rejectedCount = 0;
+    memset(errorCounts, 0, sizeof(errorCounts));
+    retryCount = 0;
+    recoveryCount = 0;
+}
+
+// advances the transfer by one step. called when TWINT is set, from the
+// TWI interrupt, or from I2CAsync_task if I2CASYNC_POLLED
+static void handleTWIEvent (void)
+{
+    switch (i2cState) {
+        case is_idle :
+            break;
+        case is_waitingForWriteStartTransmission :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if (status == isc_startTransmitted) {
+                    // start has been transmitted
+                    // send SLA+W
+                    TWDR = (transaction->address << 1) & 0xFE;
+                    setControl(1<<TWINT);
+                    i2cState = is_waitingForSLAWTransmission;
+                    SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+        case is_waitingForSLAWTransmission :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if (status == isc_SLAWACK) {
+                    // write first data byte
+                    TWDR = transaction->writeData[0];
+                    setControl(1<<TWINT);
+                    i2cDataCount = 1;
+                    i2cState = is_waitingForDataByteWrite;
+                    SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+        case is_waitingForDataByteWrite :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if (status == isc_dataTransmittedAck) {
+                    if (i2cDataCount < transaction->writeDataLength) {
+                        TWDR = transaction->writeData[i2cDataCount++];
+                        setControl(1<<TWINT);
+                    } else {
+                        // all bytes written
+                        if (transaction->readDataLength > 0) {
+                            // we are reading data after this write. use a
+                            // repeated START so the write and the read
+                            // happen as one transaction, without releasing
+                            // the bus in between
+                            sendStart();
+                            i2cState = is_waitingForReadStartTransmission;
+                        } else {
+                            sendStop();
+                            i2cDataCount = 0;
+                            completeTransaction(true, status);
+                        }
+                    }
+                    SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+        case is_waitingForReadStartTransmission :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if ((status == isc_startTransmitted) ||
+                    (status == isc_repeatedStartTransmitted)) {
+                    // start or repeated start has been transmitted
+                    // send SLA+R
+                    TWDR = ((transaction->address << 1) & 0xFE) | 0x01;
+                    setControl(1<<TWINT);
+                    i2cState = is_waitingForSLARTransmission;
+                    SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+        case is_waitingForSLARTransmission :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if (status == isc_SLARACK) {
+                    // request first data byte
+                    setControl((1<<TWINT) | (1<<TWEA));
+                    i2cDataCount = 0;
+                    i2cState = is_waitingForDataByteRead;
+                    SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+        case is_waitingForDataByteRead :
+            {
+                const I2CStatusCode status = i2cStatus();
+                if ((status == isc_dataReceivedAck) ||
+                    (status == isc_dataReceicedNack)) {
+                    transaction->readData[i2cDataCount++] = TWDR;
+                    if (i2cDataCount < transaction->readDataLength) {
+                        // request next or last data byte
+                        setControl((1<<TWINT) |
+                            ((i2cDataCount < (transaction->readDataLength - 1))
+                            ? (1<<TWEA) // next byte
+                            : 0));      // last byte
+                        SystemTime_futureTick(TIMEOUT_TICKS, &timeoutTime);
+                    } else {
+                        // all bytes read
+                        sendStop();
+                        completeTransaction(true, status);
+                    }
+                } else {
+                    // unexpected status
+                    failTransaction(status);
+                }
+            }
+            break;
+    }
+}
+
+void I2CAsync_task (void)
+{
+    if (i2cState != is_idle) {
+#if I2CASYNC_POLLED
+        if (TWCR & (1<<TWINT)) {
+            // the timer interrupt queues sample reads, so the queue is
+            // only changed with interrupts disabled, as it would be in
+            // the TWI interrupt
+            char SREGSave = SREG;
+            cli();
+            handleTWIEvent();
+            SREG = SREGSave;
+        } else {
+            checkTimeout();
+        }
+#else
+        // the TWI interrupt does the work. all we do here is look
+        // out for a transfer that has stalled
+        checkTimeout();
+#endif
+    }
+}
+
+bool I2CAsync_isIdle (void)
+{
+    return (queueLength == 0);
+}
+
+bool I2CAsync_transferData (
+    const uint8_t address,
+    const uint8_t writeDataLength,
+    const uint8_t *writeData,
+    const uint8_t readDataLength,
+    I2CAsync_CompletionHandler completionHandler,
+    void *context)
+{
+    bool queuedSuccessfully = false;
+
+    // may be called from an interrupt handler as well as from the mainloop
+    char SREGSave = SREG;
+    cli();
+    if ((queueLength < I2CASYNC_QUEUE_LEN) &&
+        (writeDataLength <= I2CASYNC_MAX_DATA_LEN) &&
+        (readDataLength <= I2CASYNC_MAX_DATA_LEN)) {
+        I2CTransaction* newTransaction =
+            &transactionQueue[(queueHead + queueLength) & QUEUE_MASK];
+        newTransaction->address = address;
+        newTransaction->writeDataLength = writeDataLength;
+        memcpy(newTransaction->writeData, writeData, writeDataLength);
+        newTransaction->readDataLength = readDataLength;
+        newTransaction->retriesRemaining = MAX_RETRIES;
+        newTransaction->completionHandler = completionHandler;
+        newTransaction->context = context;
+        ++queueLength;
+        if (queueLength > queueHighWater) {
+            queueHighWater = queueLength;
+        }
+
+        startNextTransaction();
+
+        queuedSuccessfully = true;
+    } else {
+        ++rejectedCount;
+    }
+    SREG = SREGSave;
+
+    return queuedSuccessfully;
+}
+
+uint8_t I2CAsync_queueLength (void)
+{
+    return queueLength;
+}
+
+uint8_t I2CAsync_queueHighWater (void)
+{
+    return queueHighWater;
+}
+
+uint16_t I2CAsync_rejectedCount (void)
+{
+    char SREGSave = SREG;
+    cli();
+    const uint16_t count = rejectedCount;
+    SREG = SREGSave;
+
+    return count;
+}
+
+uint16_t I2CAsync_errorCount (
+    const I2CStatusCode status)
+{
+    char SREGSave = SREG;
+    cli();
+    const uint16_t count = errorCounts[errorCountIndex(status)];
+    SREG = SREGSave;
+
+    return count;
+}
+
+uint16_t I2CAsync_retryCount (void)
+{
+    char SREGSave = SREG;
+    cli();
+    const uint16_t count = retryCount;
+    SREG = SREGSave;
+
+    return count;
+}
+
+uint16_t I2CAsync_recoveryCount (void)
+{
+    char SREGSave = SREG;
+    cli();
+    const uint16_t count = recoveryCount;
+    SREG = SREGSave;
+
+    return count;
+}
+
+#if !I2CASYNC_POLLED
+ISR(TWI_vect)
+{
+    handleTWIEvent();
+}
+#endif
@@ -1,67 +1,111 @@
-//
-//  I2C Asynchronous interface - Master only
-//
-//  What it does:
-//    Interface to AVR hardware I2C. The functions in this unit return
-//    immediately.
-//    Handler functions are called when the read or write functions complete.
-//    Based on AtMega32U4 spec
-//
-//  How to use it:
-//    Call I2CAsync_Initialize() once at the beginning of the program (powerup)
-//    Call I2CAsync_task() every iteration of the program mainloop.
-//    Optionally define a completion handler to be called when the I2C transfer
-//    completes.
-//    If I2CAsync_isIdle() returns false you can call I2CAsync_transferData()
-//    to write data and the completion handler 
-//
-
-#ifndef I2CASYNC_H
-#define I2CASYNC_H
-
-#include <stdint.h>
-#include <stdbool.h>
-#include <string.h>
-#include <stddef.h>
-
-// Status codes from I2C TWSR
-typedef enum I2CStatusCode_enum {
-    isc_startTransmitted = 0x08,
-    isc_repeatedStartTransmitted = 0x10,
-    isc_SLAWACK = 0x18,
-    isc_SLAWNACK = 0x20,
-    isc_dataTransmittedAck = 0x28,
-    isc_dataTransmittedNack = 0x30,
-    isc_SLAArbitrationLost = 0x38,
-    isc_SLARACK = 0x40,
-    isc_SLARNACK = 0x48,
-    isc_dataReceivedAck = 0x50,
-    isc_dataReceicedNack = 0x58,
-    isc_timeout = 0x7F
-} I2CStatusCode;
-
-typedef void (*I2CAsync_CompletionHandler)(
-    const bool success,
-    const I2CStatusCode i2cStatus,
-    const uint8_t readDataLength,
-    const uint8_t* readData);
-
-extern void I2CAsync_Initialize (void);
-
-extern void I2CAsync_task (void);
-
-extern bool I2CAsync_isIdle (void);
-
-// sends the given data bytes to the given address.
-// calls writeHandler when the operation is complete.
-// returns false if there is a read or write already
-// in progress.
-extern bool I2CAsync_transferData (
-    const uint8_t address,
-    const uint8_t writeDataLength,
-    const uint8_t *writeData,
-    const uint8_t readDataLength,
-    uint8_t *readData,
-    I2CAsync_CompletionHandler completionHandler);
-
-#endif      // I2CASYNC_H
+//
+//  I2C Asynchronous interface - Master only
+//
+//  What it does:
+//    Interface to AVR hardware I2C. The functions in this unit return
+//    immediately.
+//    Handler functions are called when the read or write functions complete.
+//    Transfers are driven by the TWI interrupt, so completion handlers are
+//    called from the interrupt handler. Compile with I2CASYNC_POLLED=1 to
+//    have I2CAsync_task drive them from the mainloop instead.
+//    Based on AtMega32U4 spec
+//
+//  How to use it:
+//    Call I2CAsync_Initialize() once at the beginning of the program (powerup)
+//    Call I2CAsync_task() every iteration of the program mainloop (it
+//    handles timeouts, and advances transfers if I2CASYNC_POLLED).
+//    Optionally define a completion handler to be called when the I2C transfer
+//    completes.
+//    Call I2CAsync_transferData() to queue a transfer. Transfers are
+//    carried out one after the other in the order they were queued, and
+//    the completion handler of each is called when it completes.
+//    I2CAsync_transferData() may be called from an interrupt handler,
+//    including from a completion handler.
+//    A transfer that fails is retried a couple of times before its
+//    completion handler is told it failed, except one that times out,
+//    which fails straight away. If the bus is stuck, it is recovered by
+//    resetting the TWI and clocking out the slave.
+//
+
+#ifndef I2CASYNC_H
+#define I2CASYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+
+// number of transfers that can be queued, including the one in progress.
+// must be a power of 2
+#define I2CASYNC_QUEUE_LEN 8
+
+// maximum number of bytes written or read by one transfer
+#define I2CASYNC_MAX_DATA_LEN 4
+
+// Status codes from I2C TWSR
+typedef enum I2CStatusCode_enum {
+    isc_busError = 0x00,
+    isc_startTransmitted = 0x08,
+    isc_repeatedStartTransmitted = 0x10,
+    isc_SLAWACK = 0x18,
+    isc_SLAWNACK = 0x20,
+    isc_dataTransmittedAck = 0x28,
+    isc_dataTransmittedNack = 0x30,
+    isc_SLAArbitrationLost = 0x38,
+    isc_SLARACK = 0x40,
+    isc_SLARNACK = 0x48,
+    isc_dataReceivedAck = 0x50,
+    isc_dataReceicedNack = 0x58,
+    isc_timeout = 0x7F
+} I2CStatusCode;
+
+typedef void (*I2CAsync_CompletionHandler)(
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const uint8_t readDataLength,
+    const uint8_t* readData,
+    void *context);
+
+extern void I2CAsync_Initialize (void);
+
+extern void I2CAsync_task (void);
+
+// returns true if there are no transfers queued or in progress
+extern bool I2CAsync_isIdle (void);
+
+// queues a transfer that sends the given data bytes to the given address
+// and then reads readDataLength bytes from it. if there is both data to
+// write and data to read, the read follows the write with a repeated
+// START, so that the two are one combined transaction. the data bytes are copied,
+// so the caller's buffer may be reused immediately. the bytes read are
+// passed to completionHandler when the transfer is complete, along with
+// context, which lets one handler serve several devices.
+// returns false if the queue is full or a length exceeds
+// I2CASYNC_MAX_DATA_LEN.
+extern bool I2CAsync_transferData (
+    const uint8_t address,
+    const uint8_t writeDataLength,
+    const uint8_t *writeData,
+    const uint8_t readDataLength,
+    I2CAsync_CompletionHandler completionHandler,
+    void *context);
+
+// queue statistics
+// number of transfers queued, including the one in progress
+extern uint8_t I2CAsync_queueLength (void);
+// largest number of transfers that have been queued at once
+extern uint8_t I2CAsync_queueHighWater (void);
+// number of calls to I2CAsync_transferData that returned false
+extern uint16_t I2CAsync_rejectedCount (void);
+
+// error statistics
+// number of transfer attempts that failed with the given status. codes
+// from 0x80 up, which a master never expects, are all counted as 0x80
+extern uint16_t I2CAsync_errorCount (
+    const I2CStatusCode status);
+// number of times a failed transfer was tried again
+extern uint16_t I2CAsync_retryCount (void);
+// number of times the bus was reset and clocked out
+extern uint16_t I2CAsync_recoveryCount (void);
+
+#endif      // I2CASYNC_H
@@ -1,107 +1,165 @@
-//
-// INA219 high side current sensor
-//  on Adafruit breakout
-//
-
-#include "INA219.h"
-
-#include "CharString.h"
-#include "StringUtils.h"
-#include "Console.h"
-
-#define INA219_I2C_ADDR 0x40
-
-#define PTR_LEN 1
-#define REGISTER_DATA_LEN 2
-#define CONFIGURATION_DATA_LEN 3
-#define DATA_BUFFER_LEN 3
-
-static INA219_WriteCompletionHandler clientWriteCompletionHandler = 0;
-static INA219_ReadCompletionHandler clientReadCompletionHandler = 0;
-static uint8_t dataBuffer[DATA_BUFFER_LEN];
-
-void writeHandler (
-    const bool success,
-    const I2CStatusCode i2cStatus,
-    const uint8_t readDataLength,
-    const uint8_t* readData)
-{
-    if (clientWriteCompletionHandler != 0) {
-        clientWriteCompletionHandler(success, i2cStatus);
-    }
-}
-
-void readHandler (
-    const bool success,
-    const I2CStatusCode i2cStatus,
-    const uint8_t readDataLength,
-    const uint8_t* readData)
-{
-    if (clientReadCompletionHandler != 0) {
-        // assuming readDataLength == 2
-        const int16_t registerValue = (readData[0] << 8) + readData[1];
-        clientReadCompletionHandler(success, i2cStatus, registerValue);
-    }
-}
-
-bool INA219_setConfiguration (
-    const bool reset,
-    const INA219BRNG busVoltageRange,
-    const INA219PGA pga,
-    const INA219ADC busAdc,
-    const INA219ADC shuntAdc,
-    const INA219Mode mode,
-    INA219_WriteCompletionHandler completionHandler)
-{
-    dataBuffer[0] = ira_configuration;
-    const int16_t configurationWord = 
-        ((reset ? 1 : 0) << 15) |
-        (busVoltageRange << 13) |
-        (pga << 11) |
-        (busAdc << 7) |
-        (shuntAdc << 3) |
-        mode;
-
-    CharString_define(60, msg);
-    CharString_copyP(PSTR("config: "), &msg);
-    StringUtils_appendDecimal(configurationWord, 1, 0, &msg);
-    Console_printCS(&msg);
-
-    dataBuffer[1] = (configurationWord >> 8) & 0xFF;
-    dataBuffer[2] = configurationWord & 0xFF;
-    clientWriteCompletionHandler = completionHandler;
-    return I2CAsync_transferData(INA219_I2C_ADDR,
-        CONFIGURATION_DATA_LEN, dataBuffer,
-        0, 0,
-        writeHandler);
-}
-
-bool INA219_setCalibration (
-    const uint16_t fullScaleDrop,
-    INA219_WriteCompletionHandler completionHandler)
-{
-    // not implemented yet
-    return false;
-}
-
-bool INA219_setRegisterPtr (
-    const INA219RegisterAddr registerAddr,
-    INA219_WriteCompletionHandler completionHandler)
-{
-    dataBuffer[0] = registerAddr;
-    clientWriteCompletionHandler = completionHandler;
-    return I2CAsync_transferData(INA219_I2C_ADDR,
-        PTR_LEN, dataBuffer,
-        0, 0,
-        writeHandler);
-}
-
-bool INA219_readRegister (
-    INA219_ReadCompletionHandler completionHandler)
-{
-    clientReadCompletionHandler = completionHandler;
-    return I2CAsync_transferData(INA219_I2C_ADDR,
-        0, 0,
-        REGISTER_DATA_LEN, dataBuffer,
-        readHandler);
-}
+//
+// INA219 high side current sensor
+//  on Adafruit breakout
+//
+
+#include "INA219.h"
+
+#define PTR_LEN 1
+#define REGISTER_DATA_LEN 2
+#define CONFIGURATION_DATA_LEN 3
+#define CALIBRATION_DATA_LEN 3
+#define DATA_BUFFER_LEN 3     // the I2C interface copies it when queueing
+
+// 0.04096 in uA x mOhm units
+#define CALIBRATION_SCALE 40960000UL
+#define MAX_CALIBRATION 0xFFFE
+
+static void writeHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const uint8_t readDataLength,
+    const uint8_t* readData,
+    void *context)
+{
+    INA219 *device = (INA219 *)context;
+    if (device->writeCompletionHandler != 0) {
+        device->writeCompletionHandler(success, i2cStatus, device);
+    }
+}
+
+static void readHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const uint8_t readDataLength,
+    const uint8_t* readData,
+    void *context)
+{
+    INA219 *device = (INA219 *)context;
+    if (device->readCompletionHandler != 0) {
+        const int16_t registerValue = (readDataLength == REGISTER_DATA_LEN)
+            ? ((readData[0] << 8) + readData[1])
+            : 0;
+        device->readCompletionHandler(success, i2cStatus, registerValue, device);
+    }
+}
+
+void INA219_initialize (
+    const uint8_t address,
+    INA219_WriteCompletionHandler writeCompletionHandler,
+    INA219_ReadCompletionHandler readCompletionHandler,
+    INA219 *device)
+{
+    device->address = address;
+    device->writeCompletionHandler = writeCompletionHandler;
+    device->readCompletionHandler = readCompletionHandler;
+}
+
+bool INA219_setConfiguration (
+    const bool reset,
+    const INA219BRNG busVoltageRange,
+    const INA219PGA pga,
+    const INA219ADC busAdc,
+    const INA219ADC shuntAdc,
+    const INA219Mode mode,
+    INA219 *device)
+{
+    uint8_t dataBuffer[DATA_BUFFER_LEN];
+    dataBuffer[0] = ira_configuration;
+    const int16_t configurationWord = 
+        ((reset ? 1 : 0) << 15) |
+        (busVoltageRange << 13) |
+        (pga << 11) |
+        (busAdc << 7) |
+        (shuntAdc << 3) |
+        mode;
+
+    dataBuffer[1] = (configurationWord >> 8) & 0xFF;
+    dataBuffer[2] = configurationWord & 0xFF;
+    return I2CAsync_transferData(device->address,
+        CONFIGURATION_DATA_LEN, dataBuffer,
+        0,
+        writeHandler, device);
+}
+
+uint16_t INA219_currentLSBMicroAmps (
+    const uint16_t maxExpectedMilliAmps)
+{
+    // the current register is 15 bits plus sign
+    const uint32_t minLSB =
+        (((uint32_t)maxExpectedMilliAmps * 1000) + 32767) / 32768;
+    uint16_t decade = 1;
+    for (;;) {
+        if (decade >= minLSB) {
+            return decade;
+        } else if ((2 * decade) >= minLSB) {
+            return 2 * decade;
+        } else if ((5 * decade) >= minLSB) {
+            return 5 * decade;
+        }
+        decade *= 10;
+    }
+}
+
+uint16_t INA219_calibrationValue (
+    const uint16_t shuntMilliOhms,
+    const uint16_t currentLSBMicroAmps)
+{
+    // from the datasheet, cal = 0.04096 / (current LSB (A) x shunt (ohms))
+    const uint32_t divisor = (uint32_t)currentLSBMicroAmps * shuntMilliOhms;
+    const uint32_t cal = (divisor != 0) ? (CALIBRATION_SCALE / divisor) : 0;
+    // bit 0 of the register is always 0
+    return (cal <= MAX_CALIBRATION) ? (cal & 0xFFFE) : 0;
+}
+
+bool INA219_setCalibration (
+    const uint16_t shuntMilliOhms,
+    const uint16_t currentLSBMicroAmps,
+    INA219 *device)
+{
+    const uint16_t cal =
+        INA219_calibrationValue(shuntMilliOhms, currentLSBMicroAmps);
+    if (cal == 0) {
+        return false;
+    }
+
+    uint8_t dataBuffer[DATA_BUFFER_LEN];
+    dataBuffer[0] = ira_calibration;
+    dataBuffer[1] = (cal >> 8) & 0xFF;
+    dataBuffer[2] = cal & 0xFF;
+    return I2CAsync_transferData(device->address,
+        CALIBRATION_DATA_LEN, dataBuffer,
+        0,
+        writeHandler, device);
+}
+
+bool INA219_setRegisterPtr (
+    const INA219RegisterAddr registerAddr,
+    INA219 *device)
+{
+    const uint8_t dataBuffer[PTR_LEN] = { registerAddr };
+    return I2CAsync_transferData(device->address,
+        PTR_LEN, dataBuffer,
+        0,
+        writeHandler, device);
+}
+
+bool INA219_readRegister (
+    INA219 *device)
+{
+    return I2CAsync_transferData(device->address,
+        0, 0,
+        REGISTER_DATA_LEN,
+        readHandler, device);
+}
+
+bool INA219_readRegisterAt (
+    const INA219RegisterAddr registerAddr,
+    INA219 *device)
+{
+    const uint8_t dataBuffer[PTR_LEN] = { registerAddr };
+    return I2CAsync_transferData(device->address,
+        PTR_LEN, dataBuffer,
+        REGISTER_DATA_LEN,
+        readHandler, device);
+}
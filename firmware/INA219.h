@@ -1,105 +1,157 @@
-//
-// INA219 high side current sensor
-//  on Adafruit breakout
-//
-//  How to use it
-//  After calling one of the functions you must wait until its
-//  completion handler is called before calling another function
-//
-#ifndef INA219_H
-#define INA219_H
-
-#include <stdint.h>
-#include <stdbool.h>
-#include <string.h>
-#include <stddef.h>
-#include "I2CAsync.h"
-
-// Bus voltage range
-typedef enum INA219BRNG_enum {
-    ibrng_16V = 0,
-    ibrng_32V = 1
-} INA219BRNG;
-
-// PGA gains
-typedef enum INA219PGA_enum {
-    ipga_unity = 0,
-    ipga_div2  = 1,
-    ipga_div4  = 2,
-    ipga_div8  = 3
-} INA219PGA;
-
-// ADC resolution / averaging
-typedef enum INA219ADC_enum {
-    iadc_9bit      = 0,
-    iadc_10bit     = 1,
-    iadc_11bit     = 2,
-    iadc_12bit     = 3,
-    iadc_1sample   = 8,
-    iadc_2sample   = 9,
-    iadc_4sample   = 10,
-    iadc_8sample   = 11,
-    iadc_16sample  = 12,
-    iadc_32sample  = 13,
-    iadc_64sample  = 14,
-    iadc_128sample = 15
-} INA219ADC;
-
-// mode settings
-typedef enum INA219Mode_enum {
-    im_powerDown             = 0,
-    im_shuntTriggered        = 1,
-    im_busTriggered          = 2,
-    im_shuntAndBusTriggered  = 3,
-    im_ADCOff                = 4,
-    im_shuntContinuous       = 5,
-    im_busContinuous         = 6,
-    im_shuntAndBusContinuous = 7
-} INA219Mode;
-
-// register pointers
-typedef enum INA219RegisterAddr_enum {
-    ira_configuration    = 0,
-    ira_shuntVoltage     = 1,
-    ira_busVoltage       = 2,
-    ira_powerMeasurement = 3,
-    ira_current          = 4,
-    ira_calibration      = 5
-} INA219RegisterAddr;
-
-typedef void (*INA219_WriteCompletionHandler)(
-    const bool success,
-    const I2CStatusCode i2cStatus);
-typedef void (*INA219_ReadCompletionHandler)(
-    const bool success,
-    const I2CStatusCode i2cStatus,
-    const int16_t registerValue);
-
-// returns true if the I2C interface is available
-extern bool INA219_setConfiguration (
-    const bool reset,
-    const INA219BRNG busVoltageRange,
-    const INA219PGA pga,
-    const INA219ADC busAdc,
-    const INA219ADC shuntAdc,
-    const INA219Mode mode,
-    INA219_WriteCompletionHandler completionHandler);
-
-// returns true if the I2C interface is available
-extern bool INA219_setCalibration (
-    const uint16_t fullScaleDrop,
-    INA219_WriteCompletionHandler completionHandler);
-
-// sets the register pointer address to the register intended to be
-// read by INA219_readRegister
-// returns true if the I2C interface is available
-extern bool INA219_setRegisterPtr (
-    const INA219RegisterAddr registerAddr,
-    INA219_WriteCompletionHandler completionHandler);
-
-// reads the register that the current register pointer points to
-// returns true if the I2C interface is available
-extern bool INA219_readRegister (
-    INA219_ReadCompletionHandler completionHandler);
-
+//
+// INA219 high side current sensor
+//  on Adafruit breakout
+//
+//  How to use it
+//  Define an INA219 for each device and call INA219_initialize once for
+//  each, then call the other functions. Operations are queued on the I2C
+//  interface and carried out in order, so you don't have to wait for one
+//  to complete before requesting the next. The device's completion
+//  handlers are called as each operation completes (from the TWI
+//  interrupt), and are passed the device.
+//
+#ifndef INA219_H
+#define INA219_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "I2CAsync.h"
+
+// Bus voltage range
+typedef enum INA219BRNG_enum {
+    ibrng_16V = 0,
+    ibrng_32V = 1
+} INA219BRNG;
+
+// PGA gains
+typedef enum INA219PGA_enum {
+    ipga_unity = 0,
+    ipga_div2  = 1,
+    ipga_div4  = 2,
+    ipga_div8  = 3
+} INA219PGA;
+
+// ADC resolution / averaging
+typedef enum INA219ADC_enum {
+    iadc_9bit      = 0,
+    iadc_10bit     = 1,
+    iadc_11bit     = 2,
+    iadc_12bit     = 3,
+    iadc_1sample   = 8,
+    iadc_2sample   = 9,
+    iadc_4sample   = 10,
+    iadc_8sample   = 11,
+    iadc_16sample  = 12,
+    iadc_32sample  = 13,
+    iadc_64sample  = 14,
+    iadc_128sample = 15
+} INA219ADC;
+
+// mode settings
+typedef enum INA219Mode_enum {
+    im_powerDown             = 0,
+    im_shuntTriggered        = 1,
+    im_busTriggered          = 2,
+    im_shuntAndBusTriggered  = 3,
+    im_ADCOff                = 4,
+    im_shuntContinuous       = 5,
+    im_busContinuous         = 6,
+    im_shuntAndBusContinuous = 7
+} INA219Mode;
+
+// the A1 and A0 pins select one of 16 addresses from here
+#define INA219_BASE_I2C_ADDR 0x40
+#define INA219_MAX_DEVICES 16
+
+// register pointers
+typedef enum INA219RegisterAddr_enum {
+    ira_configuration    = 0,
+    ira_shuntVoltage     = 1,
+    ira_busVoltage       = 2,
+    ira_powerMeasurement = 3,
+    ira_current          = 4,
+    ira_calibration      = 5
+} INA219RegisterAddr;
+
+typedef struct INA219_struct INA219;
+
+typedef void (*INA219_WriteCompletionHandler)(
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    INA219 *device);
+typedef void (*INA219_ReadCompletionHandler)(
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const int16_t registerValue,
+    INA219 *device);
+
+struct INA219_struct {
+    uint8_t address;
+    INA219_WriteCompletionHandler writeCompletionHandler;
+    INA219_ReadCompletionHandler readCompletionHandler;
+};
+
+// sets the device's I2C address, and the handlers that are called when
+// write operations (configuration, calibration, register pointer) and
+// register reads complete
+extern void INA219_initialize (
+    const uint8_t address,
+    INA219_WriteCompletionHandler writeCompletionHandler,
+    INA219_ReadCompletionHandler readCompletionHandler,
+    INA219 *device);
+
+// returns true if the operation was queued
+extern bool INA219_setConfiguration (
+    const bool reset,
+    const INA219BRNG busVoltageRange,
+    const INA219PGA pga,
+    const INA219ADC busAdc,
+    const INA219ADC shuntAdc,
+    const INA219Mode mode,
+    INA219 *device);
+
+// returns the current register LSB to use for a maximum expected
+// current: the smallest of 1, 2, 5, 10, 20, 50... uA that covers it
+extern uint16_t INA219_currentLSBMicroAmps (
+    const uint16_t maxExpectedMilliAmps);
+
+// returns the calibration register value that gives the current LSB with
+// the given shunt, or 0 if it is out of range. the power LSB is then
+// 20 x the current LSB
+extern uint16_t INA219_calibrationValue (
+    const uint16_t shuntMilliOhms,
+    const uint16_t currentLSBMicroAmps);
+
+// sets the calibration register so that the current and power registers
+// read in current LSBs and 20 x current LSBs
+// returns true if the operation was queued (false if the calibration is
+// out of range)
+extern bool INA219_setCalibration (
+    const uint16_t shuntMilliOhms,
+    const uint16_t currentLSBMicroAmps,
+    INA219 *device);
+
+// sets the register pointer address to the register intended to be
+// read by INA219_readRegister
+// returns true if the operation was queued
+extern bool INA219_setRegisterPtr (
+    const INA219RegisterAddr registerAddr,
+    INA219 *device);
+
+// reads the register that the current register pointer points to
+// returns true if the operation was queued
+extern bool INA219_readRegister (
+    INA219 *device);
+
+// sets the register pointer and reads the register in one combined
+// (repeated START) transaction. the register pointer is left pointing
+// at registerAddr, so subsequent reads of the same register can use
+// INA219_readRegister.
+// returns true if the operation was queued
+extern bool INA219_readRegisterAt (
+    const INA219RegisterAddr registerAddr,
+    INA219 *device);
+
 #endif  // INA219_H
\ No newline at end of file
@@ -0,0 +1,113 @@
+//
+//  Log
+//
+
+#include "Log.h"
+
+#include <stdlib.h>
+#include "BinaryFrame.h"
+#include "CharString.h"
+#include "StringUtils.h"
+#include "Console.h"
+
+#define MAX_TEXT_LENGTH 64
+
+static bool deferredMessages = false;
+
+static void appendVarint (
+    const int32_t value,
+    BinaryFrame *frame)
+{
+    // zigzag, so small negative numbers are short too
+    uint32_t bits = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    while (bits >= 0x80) {
+        BinaryFrame_appendU8((bits & 0x7F) | 0x80, frame);
+        bits >>= 7;
+    }
+    BinaryFrame_appendU8(bits, frame);
+}
+
+static void sendDeferred (
+    PGM_P format,
+    const uint8_t numArgs,
+    const int32_t *args)
+{
+    BinaryFrame_define(frame);
+    BinaryFrame_appendU16((uint16_t)format, &frame);
+    for (uint8_t a = 0; a < numArgs; ++a) {
+        appendVarint(args[a], &frame);
+    }
+    // a message that doesn't fit is dropped. the frame sequence number
+    // tells the host it missed one
+    BinaryFrame_send(LOG_FRAME_TYPE, &frame);
+}
+
+static void printText (
+    PGM_P format,
+    const uint8_t numArgs,
+    const int32_t *args)
+{
+    CharString_define(MAX_TEXT_LENGTH, msg);
+    uint8_t argIndex = 0;
+    char c;
+    while ((c = pgm_read_byte(format++)) != 0) {
+        if (c == '%') {
+            const char conversion = pgm_read_byte(format);
+            if (conversion != 0) {
+                ++format;
+            }
+            const int32_t arg = (argIndex < numArgs) ? args[argIndex] : 0;
+            switch (conversion) {
+                case 'd' :
+                    StringUtils_appendDecimal32(arg, 1, 0, &msg);
+                    ++argIndex;
+                    break;
+                case 'u' : {
+                    char digits[11];
+                    CharString_append(ultoa((uint32_t)arg, digits, 10), &msg);
+                    ++argIndex;
+                    }
+                    break;
+                case 'x' : {
+                    char digits[9];
+                    CharString_append(ultoa((uint32_t)arg, digits, 16), &msg);
+                    ++argIndex;
+                    }
+                    break;
+                default :
+                    CharString_appendC('%', &msg);
+                    break;
+            }
+        } else {
+            CharString_appendC(c, &msg);
+        }
+    }
+    Console_printCS(&msg);
+}
+
+void Log_setDeferred (
+    const bool deferred)
+{
+    deferredMessages = deferred;
+}
+
+bool Log_isDeferred (void)
+{
+    return deferredMessages;
+}
+
+void Log_messageP (
+    PGM_P format,
+    const uint8_t numArgs,
+    const int32_t arg1,
+    const int32_t arg2,
+    const int32_t arg3)
+{
+    const int32_t args[3] = {arg1, arg2, arg3};
+
+    if (deferredMessages) {
+        sendDeferred(format, numArgs, args);
+    } else {
+        printText(format, numArgs, args);
+    }
+}
@@ -0,0 +1,62 @@
+//
+//  Log
+//
+//  What it does:
+//    Prints diagnostic messages. Each message has a format string in
+//    program memory and up to three integer arguments. The format string
+//    may contain %d and %u (decimal), %x (hex) and %%.
+//
+//    In text mode the message is formatted here and printed on the
+//    console, as Console_printP would. In deferred mode only the address
+//    of the format string (which is unique to the call) and the arguments
+//    are sent, in a LOG_FRAME_TYPE binary frame:
+//
+//      u16 format string address, then one varint per argument
+//
+//    Each varint is the zigzag-encoded argument ((n << 1) ^ (n >> 31)),
+//    7 bits per byte, least significant first, top bit set on all but the
+//    last byte. The host looks the format string up at that address in
+//    the firmware's .elf file and formats the message itself (see
+//    tools/pmdecode.py --elf). A typical message is 8 to 12 bytes on the
+//    wire instead of 20 to 60, and needs no number formatting here.
+//
+//  How to use it:
+//    Log_message("Config failed");
+//    Log_message1("channels: %u", numChannels);
+//    Log_message3("shunt mOhm: %u, LSB uA: %u, cal: %u", shunt, lsb, cal);
+//    The format must be a string literal. Call these from the main loop
+//    only (not from interrupt handlers).
+//
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+#define LOG_FRAME_TYPE 5
+
+#define Log_message(format) \
+    Log_messageP(PSTR(format), 0, 0, 0, 0)
+#define Log_message1(format, arg1) \
+    Log_messageP(PSTR(format), 1, (arg1), 0, 0)
+#define Log_message2(format, arg1, arg2) \
+    Log_messageP(PSTR(format), 2, (arg1), (arg2), 0)
+#define Log_message3(format, arg1, arg2, arg3) \
+    Log_messageP(PSTR(format), 3, (arg1), (arg2), (arg3))
+
+// selects deferred (binary) or text messages. text is the default
+extern void Log_setDeferred (
+    const bool deferred);
+
+extern bool Log_isDeferred (void);
+
+// use the Log_message macros instead of calling this directly
+extern void Log_messageP (
+    PGM_P format,
+    const uint8_t numArgs,
+    const int32_t arg1,
+    const int32_t arg2,
+    const int32_t arg3);
+
+#endif  // LOG_H
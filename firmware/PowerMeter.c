@@ -1,197 +1,2282 @@
-//
-// Power Meter
-//
-// uses 16-bit timer/counter 1 to provide a 1mS tick.
-//
-
-#include "PowerMeter.h"
-
-#include "INA219.h"
-#include "CharString.h"
-#include "StringUtils.h"
-#include "Console.h"
-#include <avr/io.h>
-#include <avr/interrupt.h>
-
-typedef enum PowerMeterState_enum {
-    pms_initial,
-    pms_waitingForConfigCompletion,
-    pms_stopped,
-    pms_waitingForTick,
-    pms_waitingForRegisterPtrSet,
-    pms_waitingForCurrentReading
-} PowerMeterState;
-
-static PowerMeterState pmState = pms_initial;
-
-static bool enabled;
-static volatile bool tick1mS;
-static volatile bool reportIsDue;
-static bool INA219OperationComplete;
-static volatile uint16_t numTicks;
-static uint16_t ticksPerReport; // number of 1mS ticks per report
-static uint16_t numSamples;
-static int32_t sampleSum;
-static int16_t latestCurrentReading;
-static volatile int32_t accumulatedTime;    // time in 1mS ticks since last reset
-static int32_t accumulatedCurrent;          // power in mAh since last reset
-static int16_t adcBias; // compensates for ADC bias
-
-static void writeCompletionHandler (
-    const bool success,
-    const I2CStatusCode i2cStatus)
-{
-    INA219OperationComplete = true;
-}
-
-static void readCompletionHandler (
-    const bool success,
-    const I2CStatusCode i2cStatus,
-    const int16_t registerValue)
-{
-    INA219OperationComplete = true;
-    latestCurrentReading = registerValue;
-}
-
-void PowerMeter_start (void)
-{
-    enabled = true;
-}
-
-void PowerMeter_stop (void)
-{
-    enabled = false;
-}
-
-void PowerMeter_reset (void)
-{
-    accumulatedCurrent = 0;
-    accumulatedTime = 0;
-}
-
-void PowerMeter_Initialize (void)
-{
-    enabled = false;
-    ticksPerReport = 100;   // start off with reporting 10 times per second
-    accumulatedCurrent = 0;
-
-    adcBias = 5;
-
-    // set up timer1 to fire interrupt every millisecond
-    TCCR1B = (TCCR1B & 0xF8) | 3; // prescale by 64
-    TCCR1B = (TCCR1B & 0xE7) | (1 << 3); // set CTC mode
-    OCR1A = (F_CPU / 64) / 1000;
-
-    pmState = pms_initial;
-}
-
-void PowerMeter_task (void)
-{
-    switch (pmState) {
-        case pms_initial :
-            if (INA219_setConfiguration(
-                false, ibrng_32V, ipga_div8, iadc_12bit, iadc_2sample, im_shuntContinuous,
-                writeCompletionHandler)) {
-                Console_printP(PSTR("Configuring"));
-                pmState = pms_waitingForConfigCompletion;
-            }
-            break;
-        case pms_waitingForConfigCompletion :
-            if (INA219OperationComplete) {
-                Console_printP(PSTR("Config complete"));
-                pmState = pms_stopped;
-            }
-            break;
-        case pms_stopped :
-            if (enabled) {
-                tick1mS = false;
-                reportIsDue = false;
-                numTicks = 0;
-                numSamples = 0;
-                sampleSum = 0;
-
-                Console_printP(PSTR("Starting"));
-
-                // start the timer
-                TCNT1 = 0;  // start the time counter at 0
-                TIFR1 |= (1 << OCF1A);  // "clear" the timer compare flag
-                TIMSK1 |= (1 << OCIE1A);// enable timer compare match interrupt
-
-                INA219OperationComplete = false;
-                if (INA219_setRegisterPtr(ira_shuntVoltage, writeCompletionHandler)) {
-                    Console_printP(PSTR("setting register ptr"));
-                    pmState = pms_waitingForRegisterPtrSet;
-                }
-            }
-            break;
-        case pms_waitingForRegisterPtrSet :
-            if (INA219OperationComplete) {
-                Console_printP(PSTR("waiting for first tick"));
-                pmState = pms_waitingForTick;
-            }
-            break;
-        case pms_waitingForTick :
-            if (enabled) {
-                if (tick1mS) {
-                    // request current reading
-                    INA219OperationComplete = false;
-                    if (INA219_readRegister(readCompletionHandler)) {
-                        tick1mS = false;
-                        pmState = pms_waitingForCurrentReading;
-                    }
-                }
-            } else {
-                // disabled - stop timer interrupts
-                TIFR1 |= (1 << OCF1A);  // "clear" the timer compare flag
-                TIMSK1 &= ~(1 << OCIE1A);// disable timer compare match interrupt
-                pmState = pms_stopped;
-            }
-            break;
-        case pms_waitingForCurrentReading :
-            if (INA219OperationComplete) {
-                ++numSamples;
-                sampleSum += (latestCurrentReading + adcBias);
-
-                if (reportIsDue) {
-                    int32_t reportTime;
-                    char SREGSave = SREG;
-                    cli();
-                    reportIsDue = false;
-                    reportTime = accumulatedTime;
-                    SREG = SREGSave;
-
-                    const int32_t sampleAverageCurrent = sampleSum / numSamples;
-                    accumulatedCurrent += sampleAverageCurrent;
-
-                    // report sample and accumulated current
-                    CharString_define(40, report);
-                    StringUtils_appendDecimal32(reportTime, 1, 3, &report);
-                    CharString_appendP(PSTR(", "), &report);
-                    StringUtils_appendDecimal32(sampleAverageCurrent, 1, 1, &report);
-                    CharString_appendP(PSTR(", "), &report);
-                    // compute hundreths of mAh
-                    const int32_t accumulatedMAh =
-                        accumulatedCurrent / (360 * (1000 / ticksPerReport));
-                    StringUtils_appendDecimal32(accumulatedMAh, 1, 2, &report);
-                    Console_printCS(&report);
-
-                    // reset for next report
-                    numSamples = 0;
-                    sampleSum = 0;
-                }
-                pmState = pms_waitingForTick;
-            }
-            break;
-    }
-}
-
-ISR(TIMER1_COMPA_vect)
-{
-    tick1mS = true;
-    ++numTicks;
-    if (numTicks >= ticksPerReport) {
-        reportIsDue = true;
-        numTicks = 0;
-    }
-    ++accumulatedTime;
-}
+//
+// Power Meter
+//
+// uses compare B of SystemTime's free running timer 3 to provide the sample
+// tick, moving the compare on by a tick's worth of counts each time. The
+// tick rate, and the INA219 ADC setting to go with it, are set by
+// PowerMeter_setSampleRate (1000 samples per second by default).
+//
+// Sampling is interrupt driven: the timer 3 compare B interrupt starts the
+// INA219 read, and the read is completed by the TWI interrupt (or by
+// I2CAsync_task if I2CASYNC_POLLED), which puts the reading into
+// sampleBuffer. PowerMeter_task only takes samples out
+// of sampleBuffer, so the time it takes to get around the mainloop does
+// not affect when samples are taken.
+//
+// In conversion ready mode (psm_conversionReady) each tick reads the
+// bus voltage register, and only if its CNVR bit shows that a new
+// conversion has completed goes on to read the shunt voltage and then the
+// power register (which clears CNVR). Each conversion is then read
+// exactly once, and is weighted by the time since the previous one. The
+// bus voltage for each conversion comes with the CNVR bit, so energy costs
+// no extra I2C traffic in this mode.
+//
+// In timed mode (psm_timed) the register pointer is left at the shunt
+// voltage so that a sample is a single read, and the bus voltage, which
+// changes much more slowly than the current, is read after every
+// BUS_VOLTAGE_READ_TICKS'th sample. The next sample then points back at
+// the shunt voltage as part of its read.
+//
+// With firmware scaling (pss_firmware) the shunt voltage is read and
+// scaled here, using the shunt resistance. With hardware scaling
+// (pss_hardware, conversion ready mode only) the INA219 is calibrated for
+// the shunt, and the current register is read in place of the shunt
+// voltage. The power register read that clears CNVR then gives the power
+// too, so the AVR doesn't have to multiply for it.
+//
+// With auto-ranging on, PowerMeter_task watches the readings (and the OVF
+// flag, in conversion ready mode) and moves the PGA gain up as soon as a
+// reading nears full scale, and down once readings have fitted well
+// inside the next range down for a while. Each sample carries the gain it
+// was converted at. The shunt voltage register is 10uV/bit at every gain,
+// so readings don't need rescaling, but the first samples after a switch
+// may straddle it and are left out like failed reads.
+//
+// Up to POWERMETER_MAX_CHANNELS INA219s, at consecutive I2C addresses from
+// INA219_BASE_I2C_ADDR, can be metered at once. Each tick reads every
+// channel in turn, each read starting as soon as the one before it
+// completes, so the channels are sampled at most one read chain apart
+// from each other. Each channel has its own totals, and one report line
+// covers all of them. The channels' state, and the report snapshots, are
+// laid out in channelPool for the number of channels in use, so RAM isn't
+// set aside for channels that aren't there. Channels can only be added
+// while the pool has room for their state and a snapshot each.
+//
+// Reports go out as text lines, or, with binary output (pof_binary), as
+// frames (see BinaryFrame) holding these little-endian records:
+//
+//   REPORT_FRAME_UNITS, when sampling starts:
+//     u8 channels, u32 report interval mS, u16 samples/s,
+//     u64 charge sum per uAh, u64 energy sum per uWh, u8 scaling,
+//     u16 shunt mOhm, u16 current LSB uA, u16 weight units per tick,
+//     u32 weight units per second
+//   REPORT_FRAME_CHANNELS, up to REPORT_CHANNELS_PER_FRAME channels each:
+//     u32 report time mS, u8 first channel, u8 channel count, then for
+//     each channel: i32 average current in 0.1 mA, i64 charge sum,
+//     i64 energy sum
+//   REPORT_FRAME_GAP, before the next report after reports were dropped:
+//     u16 reports dropped
+//
+// The sums are sent as they are, leaving the conversion to mAh and mWh
+// to the host, so a binary report costs no decimal formatting and no 64
+// bit division. tools/pmdecode.py decodes them.
+//
+// With raw streaming on, every sample also goes to the host, uncorrected,
+// through SampleStream. It is sent from PowerMeter_task, as samples are
+// taken out of sampleBuffer, so streaming never holds up sampling.
+//
+// Each report is a snapshot of the channels' averages and totals, taken
+// into a small queue and written out from there, a part (a channel of a
+// text line, or a frame) at a time as there is room in the USB buffer. A
+// text line is never cut short or mixed with other output. Without back
+// pressure a report that can't be started straight away is dropped; with
+// it (PowerMeter_setBackPressure), reports wait in the queue until it is
+// full. Either way the host is told how many were dropped, by a "# gap"
+// line or a REPORT_FRAME_GAP frame in place of the missing reports.
+//
+// Reports are due when the elapsed time reaches the next multiple of the
+// report interval, so over many reports the intervals are exact even when
+// the interval isn't a whole number of sample ticks. The charge is summed
+// sample by sample in readings x weight units, which is exact, and only
+// converted to mAh for display (see ChargeAccumulator). A sample's weight
+// is the time it covers in timer 3 counts, shifted down at slow sample
+// rates so that a few periods (after failed reads) fit in 16 bits.
+//
+// Each sample also carries the SystemTime_nowMicros time its reading was
+// taken at: when its conversion was seen to be ready in conversion ready
+// mode, or when it was read in timed mode. The raw sample stream sends it
+// so that the host can line the samples up with other captures.
+//
+// With firmware scaling, each reading is corrected for the zero offset
+// and gain of the PGA range it was converted at (see Calibration). The
+// corrections are measured while sampling: the calibrated channels are
+// held at each range in turn, with auto-ranging suspended, until
+// CALIBRATION_SAMPLES good readings have been summed at that range.
+//
+
+#include "PowerMeter.h"
+
+#include "INA219.h"
+#include "ChargeAccumulator.h"
+#include "ReportClock.h"
+#include "CharString.h"
+#include "StringUtils.h"
+#include "Console.h"
+#include "Log.h"
+#include "BinaryFrame.h"
+#include "SampleStream.h"
+#include "Checkpoint.h"
+#include "EEPROM.h"
+#include "Settings.h"
+#include "Calibration.h"
+#include "SystemTime.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+typedef enum PowerMeterState_enum {
+    pms_initial,
+    pms_waitingForConfigCompletion,
+    pms_stopped,
+    pms_waitingForRegisterPtrSet,
+    pms_sampling,
+    pms_waitingForLastSample
+} PowerMeterState;
+
+// the read of a sample currently in progress
+typedef enum SampleReadStep_enum {
+    srs_conversionReady,        // reading bus voltage register for CNVR
+    srs_current,                // shunt voltage or current register
+    srs_clearConversionReady,   // reading power register to clear CNVR
+    srs_busVoltage              // timed mode bus voltage read
+} SampleReadStep;
+
+// bits in the bus voltage register
+#define BUS_VOLTAGE_CNVR 0x0002     // conversion ready
+#define BUS_VOLTAGE_OVF  0x0001     // math overflow
+#define BUS_VOLTAGE_SHIFT 3         // bus voltage is above the flags, 4mV/bit
+
+// samples between bus voltage reads in timed mode
+#define BUS_VOLTAGE_READ_TICKS 16
+
+// a sample's power, in 10uV shunt readings x 4mV, is shifted down by
+// this to keep the energy sum from filling up too quickly. with the
+// default 100 mOhm shunt it then takes about 27 days to fill at full
+// scale (3.2A at 32V) and the 2MHz timer clock
+#define POWER_SHIFT 7               // 51.2uW at 100 mOhms
+
+// sample rate limits. the fastest INA219 conversion (9 bit) takes 84uS.
+// the INA219 converts the shunt and then the bus voltage, and only has a
+// new shunt reading (and sets CNVR) once both are done, so in either mode
+// a tick can't be shorter than the two conversions at their fastest. a
+// sample also has to be read over I2C before the next one is due: one
+// transfer in timed mode, up to three in conversion ready mode
+#define MIN_CONVERSION_MICROS 84
+#define MIN_SAMPLE_MICROS (2 * MIN_CONVERSION_MICROS)   // shunt and bus
+#define MIN_SAMPLES_PER_SECOND 10
+#define MAX_SAMPLES_PER_SECOND (1000000UL / MIN_SAMPLE_MICROS)
+#define MIN_TIMED_SAMPLE_MICROS 100
+#define MIN_CONVERSION_READY_SAMPLE_MICROS 350
+#define DEFAULT_SAMPLES_PER_SECOND 1000
+
+#define DEFAULT_ADC_BIAS 5
+#define DEFAULT_SHUNT_MILLIOHMS 100
+#define DEFAULT_MAX_CURRENT_MILLIAMPS 3200
+#define PGA_UNITY_FULL_SCALE_MICROVOLTS 40000UL
+#define NUM_PGA_SETTINGS 4
+
+// auto-ranging switches up above 7/8 of full scale, and down after
+// RANGE_DOWN_SAMPLES samples in a row below 3/8 of the next range down
+#define RANGE_DOWN_SAMPLES 16
+#define RANGE_SETTLING_SAMPLES 2
+
+// a conversion ready weight covers the time since the channel's last
+// conversion that was read, which may be several periods after failed
+// reads. weights cover up to this many periods; longer gaps are capped
+#define MAX_WEIGHT_PERIODS 4
+
+// readings averaged for each range when calibrating
+#define CALIBRATION_SAMPLES 4096
+// readings timed for each scaling path by PowerMeter_benchmarkScaling
+#define SCALING_BENCH_SAMPLES 64
+// a gain correction outside 1/2 to 2 means something isn't connected
+// the way calibration expects
+#define MIN_CALIBRATION_GAIN ((int32_t)CALIBRATION_UNITY_GAIN / 2)
+#define MAX_CALIBRATION_GAIN ((int32_t)CALIBRATION_MAX_GAIN)
+
+#define DEFAULT_REPORT_INTERVAL_MS 100
+
+// the checkpoint slots then last about 8 years of continuous sampling
+#define DEFAULT_CHECKPOINT_SECONDS 300
+#define MAX_CHECKPOINT_SECONDS 32767
+#define MAX_REPORT_INTERVAL_MS 86400000UL   // 24 hours
+#define COUNTS_PER_MS (SYSTEMTIME_COUNTS_PER_SECOND / 1000)
+
+// binary output frame types
+#define REPORT_FRAME_UNITS 1
+#define REPORT_FRAME_CHANNELS 2
+#define REPORT_FRAME_GAP 4  // 3 is SAMPLESTREAM_FRAME_TYPE
+#define REPORT_CHANNELS_PER_FRAME 4
+
+// reports held for writing out. their channel snapshots share what is
+// left of channelPool after the channels' state
+#define REPORT_QUEUE_LEN 4
+
+// bytes for the per-channel state and the report snapshots
+#define CHANNEL_POOL_SIZE 512
+
+// INA219 ADC settings from fastest to slowest, and how long each takes
+// to do a conversion. the bus ADC only uses the ones that don't average
+#define NUM_ADC_SETTINGS 11
+#define NUM_BUS_ADC_SETTINGS 4
+static const uint8_t adcSettings[NUM_ADC_SETTINGS] PROGMEM = {
+    iadc_9bit, iadc_10bit, iadc_11bit, iadc_12bit,
+    iadc_2sample, iadc_4sample, iadc_8sample, iadc_16sample,
+    iadc_32sample, iadc_64sample, iadc_128sample
+};
+static const uint32_t adcConversionMicros[NUM_ADC_SETTINGS] PROGMEM = {
+    84, 148, 276, 532,
+    1060, 2130, 4260, 8510,
+    17020, 34050, 68100
+};
+
+// sample readings in transit from the TWI interrupt to PowerMeter_task
+#define SAMPLE_BUFFER_LEN 16    // must be a power of 2
+typedef struct PowerMeterSample_struct {
+    uint8_t channel;
+    uint8_t flags;      // SAMPLE_ bits
+    int16_t current;
+    uint16_t busVoltage;    // 4mV units
+    uint16_t power;         // power register, with hardware scaling
+    uint16_t weight;    // duration of the sample in weight units
+    SystemTime_Micros_t time;   // when the reading was taken
+} PowerMeterSample;
+
+// bits in PowerMeterSample flags
+#define SAMPLE_PGA_MASK     0x03    // INA219PGA the sample was converted at
+#define SAMPLE_VALID        0x04    // the read succeeded
+#define SAMPLE_SETTLING     0x08    // converted around a PGA change
+#define SAMPLE_OVERFLOW     0x10    // OVF flag was set (conversion ready mode)
+#define SAMPLE_ENDS_REPORT  0x20    // the last sample of a report interval
+#define SAMPLE_FOLLOWS_GAP  0x40    // samples of this channel were lost before it
+
+// a channel's part of a report, as it was at the end of the interval
+typedef struct ChannelReport_struct {
+    int32_t averageTenthsMilliAmps;
+    ChargeAccumulator charge;
+    ChargeAccumulator energy;
+} ChannelReport;
+
+typedef enum CalibrationStep_enum {
+    cs_none,
+    cs_zero,            // no current flowing
+    cs_gain             // a known current flowing
+} CalibrationStep;
+
+// the part of a channel's state used by the sample reads in the TWI
+// interrupt
+typedef struct ChannelReadState_struct {
+    INA219PGA activePga;            // the gain the INA219 is using
+    INA219PGA requestedPga;
+    bool rangeChangeInFlight;
+    uint8_t settlingSamplesRemaining;
+    uint32_t lastConversionTime;    // timer 3 counts, whole weight units
+    uint16_t lastBusVoltage;        // timed mode: latest bus voltage
+    uint8_t busVoltageTicks;        // timed mode: samples since
+    bool registerPtrAtShunt;        // timed mode
+} ChannelReadState;
+
+// the part of a channel's state used only by PowerMeter_task
+typedef struct ChannelTotals_struct {
+    uint64_t sampleWeightSum;       // weight units covered by valid samples
+    ChargeAccumulator sampleSum;    // sum of weighted samples
+    int32_t sampleAverageCurrent;   // average for the latest report
+    uint16_t lastHardwarePower;     // latest good power register reading
+    ChargeAccumulator accumulatedCharge;    // since last reset
+    ChargeAccumulator accumulatedEnergy;    // since last reset
+    uint16_t invalidSamples;        // sample read failed
+    uint8_t quietSamples;   // in a row that would fit the next range down
+    uint16_t rangeSwitches;
+    uint16_t settlingSamples;
+} ChannelTotals;
+
+static PowerMeterState pmState = pms_initial;
+
+static bool enabled;
+static PowerMeterSampleMode sampleMode;
+static PowerMeterScaling scaling;
+static uint16_t shuntMilliOhms;
+static uint16_t maxCurrentMilliAmps;
+static uint16_t currentLSBMicroAmps;        // with hardware scaling
+static INA219PGA maxPga;                    // covers the maximum current
+static bool autoRange;
+static int16_t rangeFullScale[NUM_PGA_SETTINGS];    // in current readings
+static uint16_t samplesPerSecond;
+static uint32_t samplePeriodMicros;
+static INA219ADC shuntAdc;
+static INA219ADC busAdc;
+static uint8_t weightShift;         // a weight unit is 2^this timer 3 counts
+static uint16_t weightPerTick;
+static uint32_t countsPerTick;              // timer 3 counts
+static uint32_t nextSampleTickCount;        // timer 3 count of next tick
+static ReportTick reportTick;
+static uint16_t countsRemainder;            // counts short of a whole mS
+static ChargeUnit milliAmpHour;     // in current readings x weight units
+static ChargeUnit microAmpHour;
+static ChargeUnit milliWattHour;    // in power units x weight units
+static ChargeUnit microWattHour;
+static uint32_t reportIntervalMs;
+static PowerMeterOutputFormat outputFormat;
+static bool rawStreaming;
+static bool unitsPending;           // the host needs the units frame
+static bool backPressure;
+static uint32_t reportQueueTimes[REPORT_QUEUE_LEN];     // mS
+static uint8_t reportQueueChannels;     // channel snapshots in the pool
+static uint8_t reportQueueHead;
+static uint8_t reportQueueLength;
+static uint8_t channelReportsHead;  // of the report at the queue head
+static uint8_t channelsWritten;     // of the report at the queue head
+static PowerMeterOutputFormat writingFormat;    // of the report at the head
+static uint16_t unreportedGap;      // reports dropped since the last marker
+static uint32_t droppedReports;     // since sampling started
+static uint8_t numChannels;
+static uint16_t checkpointSeconds;          // 0 for no checkpoints
+static SystemTime_t nextCheckpointTime;
+static bool checkpointRequested;            // save one as soon as we can
+static uint8_t channelPool[CHANNEL_POOL_SIZE];
+// in channelPool, for numChannels channels (see useChannels)
+static ChannelTotals *totals;
+static ChannelReport *channelReports;
+static volatile ChannelReadState *readStates;
+static INA219 *sensors;
+static SampleStreamChannel *streamChannels;
+static uint8_t setupChannel;                // next channel to set up
+static volatile uint8_t readChannel;        // channel being read this tick
+static volatile SampleReadStep sampleReadStep;
+static uint16_t conversionWeight;           // of the conversion being read
+static SystemTime_Micros_t conversionMicros;    // of the conversion being read
+static uint16_t conversionBusVoltage;       // of the conversion being read
+static bool conversionOverflow;             // of the conversion being read
+static int16_t conversionCurrent;           // hardware scaling
+static bool conversionCurrentIsValid;       // hardware scaling
+static volatile bool sampling;      // timer interrupt starts sample reads
+static volatile bool reportIsDue;
+static volatile bool sampleInFlight;       // sample reads are queued
+static volatile bool sampleInProgressEndsReport;
+static volatile uint8_t INA219OperationsPending;
+static volatile bool INA219OperationSucceeded;
+static volatile PowerMeterSample sampleBuffer[SAMPLE_BUFFER_LEN];
+static volatile uint8_t sampleBufferHead;   // next sample to be taken out
+static volatile uint8_t sampleBufferTail;   // where the next sample goes
+static volatile uint16_t missedSamples;     // I2C was busy when tick occurred
+static volatile uint16_t overrunSamples;    // sampleBuffer was full
+static volatile uint16_t cappedWeights;     // gap too long for a weight
+static volatile uint16_t timeGapChannels;   // bit per channel that lost samples
+static volatile int32_t reportTime;         // accumulatedTime at report tick
+static volatile int32_t accumulatedTime;    // time in mS since last reset
+static volatile int32_t nextReportTime;     // accumulatedTime of next report
+static int16_t adcBias; // compensates for ADC bias
+static CalibrationStep calibrationStep;
+static INA219PGA calibrationPga;            // range being calibrated
+static uint8_t calibrationChannels;
+static int16_t calibrationExpected;         // gain: reading it should give
+static int32_t calibrationSums[CALIBRATION_MAX_CHANNELS];
+static uint16_t calibrationCounts[CALIBRATION_MAX_CHANNELS];
+static bool eepromTestRunning;
+static volatile bool eepromTestDone;        // set by the EEPROM interrupt
+static uint16_t eepromTestMissedSamples;    // when the test started
+static uint16_t eepromTestOverrunSamples;   // when the test started
+static uint32_t eepromTestBytesWritten;     // when the test started
+static SystemTime_Micros_t eepromTestStartMicros;
+static SystemTime_Micros_t eepromTestMicros;    // the writes took
+
+static void writeCompletionHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    INA219 *device)
+{
+    volatile ChannelReadState *state = &readStates[device - sensors];
+    if (state->rangeChangeInFlight) {
+        // assume the gain changed even if the write failed part way
+        if (success) {
+            state->activePga = state->requestedPga;
+        }
+        state->settlingSamplesRemaining = RANGE_SETTLING_SAMPLES;
+        state->rangeChangeInFlight = false;
+    } else {
+        // stays false if any of a sequence of operations fails
+        INA219OperationSucceeded = INA219OperationSucceeded && success;
+        --INA219OperationsPending;
+    }
+}
+
+// counts a setup operation that has been queued. writeCompletionHandler
+// counts it off when it completes, which may be before this is called -
+// the count wraps around and comes back to 0
+static void countQueuedOperation (void)
+{
+    char SREGSave = SREG;
+    cli();
+    ++INA219OperationsPending;
+    SREG = SREGSave;
+}
+
+// returns the time in timer 3 counts, rounded down to a whole weight
+// unit so that differences between timestamps are whole weight units.
+// called from the TWI interrupt
+static uint32_t sampleTimestamp (void)
+{
+    return SystemTime_nowCounts() & ~((1UL << weightShift) - 1);
+}
+
+// in timed mode a tick that is missed loses the channels' samples for it,
+// so the host can't tell the time of their next samples from the weights.
+// in conversion ready mode the next conversion's weight covers the time.
+// called from interrupt handlers
+static void markMissedTick (void)
+{
+    if (sampleMode == psm_timed) {
+        timeGapChannels = 0xFFFF;
+    }
+}
+
+// returns the register that a sample's current is read from
+static INA219RegisterAddr currentRegister (void)
+{
+    return (scaling == pss_hardware) ? ira_current : ira_shuntVoltage;
+}
+
+// puts a sample for the channel being read into sampleBuffer
+static void pushSample (
+    const int16_t current,
+    const uint16_t busVoltage,
+    const uint16_t power,
+    const uint16_t weight,
+    const SystemTime_Micros_t time,
+    const bool overflow,
+    const bool isValid)
+{
+    const uint8_t channel = readChannel;
+    volatile ChannelReadState *state = &readStates[channel];
+    const uint8_t tail = sampleBufferTail;
+    const uint8_t nextTail = (tail + 1) & (SAMPLE_BUFFER_LEN - 1);
+    if (nextTail != sampleBufferHead) {
+        uint8_t flags = state->activePga;
+        if (overflow) {
+            flags |= SAMPLE_OVERFLOW;
+        }
+        if (state->settlingSamplesRemaining > 0) {
+            --state->settlingSamplesRemaining;
+            flags |= SAMPLE_SETTLING;
+        }
+        if (isValid) {
+            flags |= SAMPLE_VALID;
+        }
+        if (timeGapChannels & (1U << channel)) {
+            flags |= SAMPLE_FOLLOWS_GAP;
+        }
+        timeGapChannels &= ~(1U << channel);
+        // the report ends after the last channel's sample
+        if (channel == (numChannels - 1)) {
+            if (sampleInProgressEndsReport) {
+                flags |= SAMPLE_ENDS_REPORT;
+            }
+            sampleInProgressEndsReport = false;
+        }
+        sampleBuffer[tail].channel = channel;
+        sampleBuffer[tail].flags = flags;
+        sampleBuffer[tail].current = current;
+        sampleBuffer[tail].busVoltage = busVoltage;
+        sampleBuffer[tail].power = power;
+        sampleBuffer[tail].weight = weight;
+        sampleBuffer[tail].time = time;
+        sampleBufferTail = nextTail;
+    } else {
+        // PowerMeter_task has fallen behind
+        ++overrunSamples;
+        timeGapChannels |= (1U << channel);
+    }
+}
+
+static void endSampleRead (void)
+{
+    sampleInFlight = false;
+    if (sampleInProgressEndsReport) {
+        // the report interval ended but no sample went into sampleBuffer
+        // to say so. hand it on to the next sample so the report isn't lost
+        reportIsDue = true;
+    }
+}
+
+// starts the sample read of readChannel. returns true if it was queued
+static bool startChannelRead (void)
+{
+    INA219 *sensor = &sensors[readChannel];
+    volatile ChannelReadState *state = &readStates[readChannel];
+    bool readStarted;
+    if (sampleMode == psm_conversionReady) {
+        sampleReadStep = srs_conversionReady;
+        readStarted = INA219_readRegisterAt(ira_busVoltage, sensor);
+    } else {
+        sampleReadStep = srs_current;
+        if (state->registerPtrAtShunt) {
+            readStarted = INA219_readRegister(sensor);
+        } else {
+            // the last sample read the bus voltage
+            readStarted = INA219_readRegisterAt(ira_shuntVoltage, sensor);
+            state->registerPtrAtShunt = readStarted;
+        }
+    }
+
+    return readStarted;
+}
+
+// goes on to read the next channel, or ends this tick's sample reads
+// after the last one
+static void endChannelRead (void)
+{
+    ++readChannel;
+    if (readChannel < numChannels) {
+        if (startChannelRead()) {
+            return;
+        }
+        // I2C queue full - the rest of the channels miss this tick
+        ++missedSamples;
+        markMissedTick();
+    }
+    endSampleRead();
+}
+
+// called from the TWI interrupt as each register read that is part of a
+// sample completes
+static void sampleReadCompletionHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const int16_t registerValue,
+    INA219 *device)
+{
+    // reads are done one at a time, so device is sensors[readChannel]
+    volatile ChannelReadState *state = &readStates[readChannel];
+    switch (sampleReadStep) {
+        case srs_conversionReady :
+            if (!success) {
+                // don't know if there was a conversion. the time it covers
+                // goes to the next good one
+                pushSample(0, 0, 0, 0, SystemTime_nowMicros(), false, false);
+                endChannelRead();
+            } else if (registerValue & BUS_VOLTAGE_CNVR) {
+                const uint32_t conversionTime = sampleTimestamp();
+                conversionMicros = SystemTime_nowMicros();
+                const uint32_t weight =
+                    (conversionTime - state->lastConversionTime) >> weightShift;
+                if (weight > UINT16_MAX) {
+                    // the time beyond this isn't counted
+                    conversionWeight = UINT16_MAX;
+                    ++cappedWeights;
+                } else {
+                    conversionWeight = weight;
+                }
+                state->lastConversionTime = conversionTime;
+                conversionBusVoltage = (uint16_t)registerValue >> BUS_VOLTAGE_SHIFT;
+                conversionOverflow = (registerValue & BUS_VOLTAGE_OVF) != 0;
+                sampleReadStep = srs_current;
+                if (!INA219_readRegisterAt(currentRegister(), device)) {
+                    ++missedSamples;
+                    // the conversion's time is lost with it
+                    timeGapChannels |= (1U << readChannel);
+                    endChannelRead();
+                }
+            } else {
+                // no new conversion since the last one we read
+                endChannelRead();
+            }
+            break;
+        case srs_current :
+            if (sampleMode == psm_conversionReady) {
+                if (scaling == pss_hardware) {
+                    // the sample goes in once we have the power too
+                    conversionCurrent = registerValue;
+                    conversionCurrentIsValid = success;
+                } else {
+                    pushSample(registerValue, conversionBusVoltage, 0,
+                        conversionWeight, conversionMicros, conversionOverflow,
+                        success);
+                }
+                sampleReadStep = srs_clearConversionReady;
+                if (!INA219_readRegisterAt(ira_powerMeasurement, device)) {
+                    if (scaling == pss_hardware) {
+                        pushSample(conversionCurrent, conversionBusVoltage, 0,
+                            conversionWeight, conversionMicros,
+                            conversionOverflow, false);
+                    }
+                    endChannelRead();
+                }
+            } else {
+                pushSample(registerValue, state->lastBusVoltage, 0,
+                    weightPerTick, SystemTime_nowMicros(), false, success);
+                ++state->busVoltageTicks;
+                if (state->busVoltageTicks >= BUS_VOLTAGE_READ_TICKS) {
+                    state->busVoltageTicks = 0;
+                    sampleReadStep = srs_busVoltage;
+                    if (INA219_readRegisterAt(ira_busVoltage, device)) {
+                        state->registerPtrAtShunt = false;
+                    } else {
+                        endChannelRead();
+                    }
+                } else {
+                    endChannelRead();
+                }
+            }
+            break;
+        case srs_clearConversionReady :
+            if (scaling == pss_hardware) {
+                pushSample(conversionCurrent, conversionBusVoltage,
+                    registerValue, conversionWeight, conversionMicros,
+                    conversionOverflow, conversionCurrentIsValid && success);
+            }
+            endChannelRead();
+            break;
+        case srs_busVoltage :
+            if (success) {
+                state->lastBusVoltage = (uint16_t)registerValue >> BUS_VOLTAGE_SHIFT;
+            }
+            endChannelRead();
+            break;
+    }
+}
+
+// returns the average of a channel's weighted samples in the report
+// interval
+static int32_t bucketAverage (
+    const ChannelTotals *channel)
+{
+    const int64_t sum = ChargeAccumulator_value(&channel->sampleSum);
+    const uint64_t weightSum = channel->sampleWeightSum;
+    if ((weightSum <= INT32_MAX) &&
+        (sum >= INT32_MIN) && (sum <= INT32_MAX)) {
+        // short interval - 32 bit division is much quicker
+        return (int32_t)sum / (int32_t)weightSum;
+    } else {
+        return sum / (int64_t)weightSum;
+    }
+}
+
+// appends an accumulated total with 3 decimal places, e.g. as mAh,
+// given the units for mAh and uAh
+static void appendAccumulator (
+    const ChargeAccumulator *acc,
+    const ChargeUnit *milliUnit,
+    const ChargeUnit *microUnit,
+    CharString_t *str)
+{
+    const int64_t total = ChargeAccumulator_value(acc);
+    const uint64_t magnitude = (total < 0) ? -total : total;
+    uint64_t remainder;
+    const uint32_t milli =
+        ChargeAccumulator_divide(magnitude, milliUnit, &remainder);
+    const uint16_t micro =
+        ChargeAccumulator_divide(remainder, microUnit, NULL);
+    if (total < 0) {
+        CharString_appendP(PSTR("-"), str);
+    }
+    StringUtils_appendDecimal32(milli, 1, 0, str);
+    CharString_appendP(PSTR("."), str);
+    StringUtils_appendDecimal32(micro, 3, 0, str);
+}
+
+// returns the power of a sample in power units (see POWER_SHIFT)
+static int32_t samplePower (
+    const int16_t current,
+    const uint16_t busVoltage)
+{
+    return (((int32_t)current * busVoltage) + (1L << (POWER_SHIFT - 1)))
+        >> POWER_SHIFT;
+}
+
+// converts an average current reading to tenths of a mA
+static int32_t toTenthsMilliAmps (
+    const int32_t reading)
+{
+    if (scaling == pss_hardware) {
+        return (reading * currentLSBMicroAmps) / 100;
+    } else {
+        // a shunt reading is 10uV, i.e. 100 / shunt (mOhms) tenths of a mA
+        return (reading * 100) / shuntMilliOhms;
+    }
+}
+
+// sends what the host needs to decode the binary reports, if it's
+// pending and can be sent now (not in the middle of a text line).
+// returns true if it's not pending any more
+static bool sendBinaryUnits (void)
+{
+    if (unitsPending) {
+        BinaryFrame_define(frame);
+        BinaryFrame_appendU8(numChannels, &frame);
+        BinaryFrame_appendU32(reportIntervalMs, &frame);
+        BinaryFrame_appendU16(samplesPerSecond, &frame);
+        BinaryFrame_appendU64(microAmpHour.units, &frame);
+        BinaryFrame_appendU64(microWattHour.units, &frame);
+        BinaryFrame_appendU8(scaling, &frame);
+        BinaryFrame_appendU16(shuntMilliOhms, &frame);
+        BinaryFrame_appendU16(currentLSBMicroAmps, &frame);
+        BinaryFrame_appendU16(weightPerTick, &frame);
+        BinaryFrame_appendU32(SYSTEMTIME_COUNTS_PER_SECOND >> weightShift, &frame);
+        if (BinaryFrame_fits(&frame)) {
+            BinaryFrame_send(REPORT_FRAME_UNITS, &frame);
+            unitsPending = false;
+        }
+    }
+
+    return !unitsPending;
+}
+
+static ChannelReport *headChannelReport (
+    const uint8_t channel)
+{
+    return &channelReports[
+        (channelReportsHead + channel) % reportQueueChannels];
+}
+
+// takes a snapshot of the channels' averages and totals for a report.
+// returns false if there is no room in the queue for it
+static bool queueReport (
+    const uint32_t endTime)
+{
+    const uint8_t channelReportsInUse = reportQueueLength * numChannels;
+    if ((reportQueueLength >= REPORT_QUEUE_LEN) ||
+        ((channelReportsInUse + numChannels) > reportQueueChannels)) {
+        return false;
+    }
+
+    reportQueueTimes[(reportQueueHead + reportQueueLength) % REPORT_QUEUE_LEN] =
+        endTime;
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        ChannelReport *snapshot = headChannelReport(channelReportsInUse + ch);
+        snapshot->averageTenthsMilliAmps =
+            toTenthsMilliAmps(totals[ch].sampleAverageCurrent);
+        snapshot->charge = totals[ch].accumulatedCharge;
+        snapshot->energy = totals[ch].accumulatedEnergy;
+    }
+    ++reportQueueLength;
+
+    return true;
+}
+
+static void dequeueReport (void)
+{
+    channelReportsHead =
+        (channelReportsHead + numChannels) % reportQueueChannels;
+    reportQueueHead = (reportQueueHead + 1) % REPORT_QUEUE_LEN;
+    --reportQueueLength;
+    channelsWritten = 0;
+}
+
+// prints the next part of the report at the head of the queue: the time
+// and the first channel's average and accumulated current and energy,
+// then the other channels one at a time, all on one line. returns true if
+// there was room for it
+static bool printReportPart (void)
+{
+    CharString_define(60, part);
+    if (channelsWritten == 0) {
+        StringUtils_appendDecimal32(
+            reportQueueTimes[reportQueueHead], 1, 3, &part);
+    }
+    const ChannelReport *reported = headChannelReport(channelsWritten);
+    CharString_appendP(PSTR(", "), &part);
+    StringUtils_appendDecimal32(reported->averageTenthsMilliAmps, 1, 1, &part);
+    CharString_appendP(PSTR(", "), &part);
+    appendAccumulator(&reported->charge, &milliAmpHour, &microAmpHour, &part);
+    CharString_appendP(PSTR(", "), &part);
+    appendAccumulator(&reported->energy, &milliWattHour, &microWattHour, &part);
+
+    const bool endsLine = (channelsWritten + 1) >= numChannels;
+    if (!Console_printPartCS(&part, endsLine)) {
+        return false;
+    }
+    ++channelsWritten;
+
+    return true;
+}
+
+// sends the next frame of the report at the head of the queue. returns
+// true if there was room for it
+static bool sendReportFrame (void)
+{
+    uint8_t count = numChannels - channelsWritten;
+    if (count > REPORT_CHANNELS_PER_FRAME) {
+        count = REPORT_CHANNELS_PER_FRAME;
+    }
+
+    BinaryFrame_define(frame);
+    BinaryFrame_appendU32(reportQueueTimes[reportQueueHead], &frame);
+    BinaryFrame_appendU8(channelsWritten, &frame);
+    BinaryFrame_appendU8(count, &frame);
+    for (uint8_t ch = channelsWritten; ch < (channelsWritten + count); ++ch) {
+        const ChannelReport *reported = headChannelReport(ch);
+        BinaryFrame_appendU32(reported->averageTenthsMilliAmps, &frame);
+        BinaryFrame_appendU64(ChargeAccumulator_value(&reported->charge), &frame);
+        BinaryFrame_appendU64(ChargeAccumulator_value(&reported->energy), &frame);
+    }
+    if (!BinaryFrame_fits(&frame) ||
+        !BinaryFrame_send(REPORT_FRAME_CHANNELS, &frame)) {
+        return false;
+    }
+    channelsWritten += count;
+
+    return true;
+}
+
+// tells the host how many reports were dropped. returns true if there was
+// room for it
+static bool sendGapMarker (void)
+{
+    if (writingFormat == pof_binary) {
+        BinaryFrame_define(frame);
+        BinaryFrame_appendU16(unreportedGap, &frame);
+        if (!BinaryFrame_fits(&frame) ||
+            !BinaryFrame_send(REPORT_FRAME_GAP, &frame)) {
+            return false;
+        }
+    } else {
+        CharString_define(40, marker);
+        CharString_copyP(PSTR("# gap: "), &marker);
+        StringUtils_appendDecimal32(unreportedGap, 1, 0, &marker);
+        CharString_appendP(PSTR(" reports dropped"), &marker);
+        if (!Console_printPartCS(&marker, true)) {
+            return false;
+        }
+    }
+    unreportedGap = 0;
+
+    return true;
+}
+
+// writes out as much of the queued reports as there is room for
+static void writeReports (void)
+{
+    while (reportQueueLength > 0) {
+        if (channelsWritten == 0) {
+            // a report is written in the format that was set when it
+            // was started
+            writingFormat = outputFormat;
+            if ((writingFormat == pof_binary) && !sendBinaryUnits()) {
+                return;
+            }
+            if ((unreportedGap > 0) && !sendGapMarker()) {
+                return;
+            }
+        }
+        const bool partWritten = (writingFormat == pof_binary)
+            ? sendReportFrame()
+            : printReportPart();
+        if (!partWritten) {
+            return;
+        }
+        if (channelsWritten >= numChannels) {
+            dequeueReport();
+        }
+    }
+}
+
+// queues the report, and starts writing it out. without back pressure a
+// report is dropped if it can't be started straight away
+static void sendReport (
+    const uint32_t endTime)
+{
+    bool queued = false;
+    if (backPressure || (reportQueueLength == 0)) {
+        queued = queueReport(endTime);
+    }
+    if (queued) {
+        writeReports();
+        if (!backPressure && (reportQueueLength > 0) && (channelsWritten == 0)) {
+            // couldn't be started
+            dequeueReport();
+            queued = false;
+        }
+    }
+    if (!queued) {
+        ++unreportedGap;
+        ++droppedReports;
+    }
+}
+
+static bool totalsAreZero (void)
+{
+    bool zero = true;
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        zero = zero &&
+            (ChargeAccumulator_value(&totals[ch].accumulatedCharge) == 0) &&
+            (ChargeAccumulator_value(&totals[ch].accumulatedEnergy) == 0);
+    }
+
+    return zero;
+}
+
+// works out the display units for the charge and energy sums, which
+// depend on the weight unit and on how current is scaled
+static void setUnits (void)
+{
+    const uint32_t countsPerSecond = SYSTEMTIME_COUNTS_PER_SECOND >> weightShift;
+    uint64_t countsPerUAh;
+    uint64_t countsPerUWh;
+    if (scaling == pss_hardware) {
+        // a uAh is 3600uA for 1 second. the power LSB is 20 x the
+        // current LSB, in uW, and a uWh is 3600uW for 1 second
+        countsPerUAh = (3600ULL * countsPerSecond) / currentLSBMicroAmps;
+        countsPerUWh = (180ULL * countsPerSecond) / currentLSBMicroAmps;
+    } else {
+        // a shunt reading is 10000 / shunt uA, and a power unit (see
+        // POWER_SHIFT) is 10000 / shunt uA x 4mV x 2^7 = 5120 / shunt uW
+        countsPerUAh = (36ULL * shuntMilliOhms * countsPerSecond) / 100;
+        countsPerUWh = (45ULL * shuntMilliOhms * countsPerSecond) / 64;
+    }
+    // the totals are sums of readings x weights in the old units, and
+    // can't be converted exactly, so they start again
+    if (((countsPerUAh != microAmpHour.units) ||
+        (countsPerUWh != microWattHour.units)) && !totalsAreZero()) {
+        PowerMeter_reset();
+        Log_message("units changed: totals reset");
+    }
+    ChargeAccumulator_setUnit(countsPerUAh, &microAmpHour);
+    ChargeAccumulator_setUnit(countsPerUAh * 1000, &milliAmpHour);
+    ChargeAccumulator_setUnit(countsPerUWh, &microWattHour);
+    ChargeAccumulator_setUnit(countsPerUWh * 1000, &milliWattHour);
+
+    // full scale of each PGA range in current readings
+    for (uint8_t g = 0; g < NUM_PGA_SETTINGS; ++g) {
+        const uint32_t fullScaleMicroVolts = PGA_UNITY_FULL_SCALE_MICROVOLTS << g;
+        uint32_t fullScale;
+        if (scaling == pss_hardware) {
+            fullScale = (fullScaleMicroVolts * 1000) /
+                ((uint32_t)shuntMilliOhms * currentLSBMicroAmps);
+        } else {
+            fullScale = fullScaleMicroVolts / 10;
+        }
+        rangeFullScale[g] = (fullScale > INT16_MAX) ? INT16_MAX : fullScale;
+    }
+}
+
+static bool queueConfiguration (
+    const uint8_t channel)
+{
+    return INA219_setConfiguration(false, ibrng_32V,
+        readStates[channel].activePga, busAdc, shuntAdc,
+        im_shuntAndBusContinuous, &sensors[channel]);
+}
+
+// queues a change to a channel's PGA gain. the change takes effect when
+// the configuration write completes
+static void requestRange (
+    const uint8_t channel,
+    const INA219PGA newPga)
+{
+    volatile ChannelReadState *state = &readStates[channel];
+    totals[channel].quietSamples = 0;
+
+    // the timer and TWI interrupts queue sample reads and use the
+    // register pointer too
+    char SREGSave = SREG;
+    cli();
+    state->requestedPga = newPga;
+    state->rangeChangeInFlight = true;
+    if (INA219_setConfiguration(false, ibrng_32V, newPga, busAdc,
+        shuntAdc, im_shuntAndBusContinuous, &sensors[channel])) {
+        ++totals[channel].rangeSwitches;
+        // the write leaves the register pointer at the configuration
+        state->registerPtrAtShunt = false;
+    } else {
+        state->rangeChangeInFlight = false;
+    }
+    SREG = SREGSave;
+}
+
+// called for each good sample when auto-ranging
+static void updateRange (
+    const uint8_t channel,
+    const int16_t reading,
+    const INA219PGA samplePga,
+    const bool overflow)
+{
+    volatile ChannelReadState *state = &readStates[channel];
+    if (state->rangeChangeInFlight || (samplePga != state->activePga)) {
+        // wait for samples at the new gain
+        return;
+    }
+
+    const int16_t magnitude = (reading < 0) ? -reading : reading;
+    const int16_t fullScale = rangeFullScale[samplePga];
+    if ((overflow || (magnitude >= (fullScale - (fullScale / 8)))) &&
+        (samplePga < maxPga)) {
+        requestRange(channel, (INA219PGA)(samplePga + 1));
+    } else if ((samplePga > ipga_unity) &&
+        (magnitude < ((rangeFullScale[samplePga - 1] / 8) * 3))) {
+        ++totals[channel].quietSamples;
+        if (totals[channel].quietSamples >= RANGE_DOWN_SAMPLES) {
+            requestRange(channel, (INA219PGA)(samplePga - 1));
+        }
+    } else {
+        totals[channel].quietSamples = 0;
+    }
+}
+
+// returns true from when sampling is started until it has stopped and
+// its reports have all been written out (they depend on the settings)
+static bool isSampling (void)
+{
+    return (pmState == pms_waitingForRegisterPtrSet) ||
+        (pmState == pms_sampling) ||
+        (pmState == pms_waitingForLastSample) ||
+        (reportQueueLength > 0);
+}
+
+// returns the shortest sample period the I2C interface can keep up with
+// in the given mode, reading the given number of channels each tick. it
+// also has to cover a shunt and a bus conversion
+static uint32_t minSamplePeriodMicros (
+    const PowerMeterSampleMode mode,
+    const uint8_t channels)
+{
+    uint32_t periodMicros = (uint32_t)channels *
+        ((mode == psm_conversionReady)
+        ? MIN_CONVERSION_READY_SAMPLE_MICROS : MIN_TIMED_SAMPLE_MICROS);
+    if (periodMicros < MIN_SAMPLE_MICROS) {
+        periodMicros = MIN_SAMPLE_MICROS;
+    }
+
+    return periodMicros;
+}
+
+// sums a per-channel count over the channels in use
+static uint32_t sumCounts (
+    const size_t countOffset)
+{
+    uint32_t sum = 0;
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        sum += *(const uint16_t *)((const uint8_t *)&totals[ch] + countOffset);
+    }
+
+    return sum;
+}
+
+// clears the per-report sums of all channels
+static void clearReportSums (void)
+{
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        totals[ch].sampleWeightSum = 0;
+        ChargeAccumulator_clear(&totals[ch].sampleSum);
+    }
+}
+
+// the pool bytes a channel's state takes, besides its report snapshots
+#define CHANNEL_STATE_SIZE (sizeof(ChannelTotals) + \
+    sizeof(ChannelReadState) + sizeof(INA219) + sizeof(SampleStreamChannel))
+
+// returns the number of channels that can be metered: one per INA219
+// address, as far as the pool has room for them with a report snapshot
+// each
+static uint8_t maxChannels (void)
+{
+    const uint16_t poolChannels =
+        CHANNEL_POOL_SIZE / (CHANNEL_STATE_SIZE + sizeof(ChannelReport));
+
+    return (poolChannels < POWERMETER_MAX_CHANNELS)
+        ? poolChannels : POWERMETER_MAX_CHANNELS;
+}
+
+// lays out channelPool for the given number of channels, which resets
+// their totals. the report snapshots get the rest of the pool, up to
+// REPORT_QUEUE_LEN reports' worth. the report queue must be empty
+static void useChannels (
+    const uint8_t channels)
+{
+    uint8_t *next = channelPool;
+    totals = (ChannelTotals *)next;
+    next += channels * sizeof(ChannelTotals);
+    readStates = (volatile ChannelReadState *)next;
+    next += channels * sizeof(ChannelReadState);
+    sensors = (INA219 *)next;
+    next += channels * sizeof(INA219);
+    streamChannels = (SampleStreamChannel *)next;
+    next += channels * sizeof(SampleStreamChannel);
+    channelReports = (ChannelReport *)next;
+    const uint16_t snapshots =
+        (&channelPool[CHANNEL_POOL_SIZE] - next) / sizeof(ChannelReport);
+    reportQueueChannels = (snapshots < (REPORT_QUEUE_LEN * channels))
+        ? snapshots : (REPORT_QUEUE_LEN * channels);
+    channelReportsHead = 0;
+
+    numChannels = channels;
+    for (uint8_t ch = 0; ch < channels; ++ch) {
+        INA219_initialize(INA219_BASE_I2C_ADDR + ch, writeCompletionHandler,
+            sampleReadCompletionHandler, &sensors[ch]);
+        readStates[ch].activePga = maxPga;
+        readStates[ch].rangeChangeInFlight = false;
+        readStates[ch].settlingSamplesRemaining = 0;
+    }
+    PowerMeter_reset();
+    // the new channels need their configuration written before sampling
+    pmState = pms_initial;
+}
+
+void PowerMeter_start (void)
+{
+    enabled = true;
+}
+
+void PowerMeter_stop (void)
+{
+    enabled = false;
+}
+
+// writes the totals as they were at the given time to the next
+// checkpoint slot. if the last checkpoint is still being written this
+// is tried again next time
+static void saveCheckpoint (
+    const int32_t time)
+{
+    CheckpointRecord record;
+    record.time = time;
+    record.chargeUnitsPerMicroAmpHour = microAmpHour.units;
+    record.energyUnitsPerMicroWattHour = microWattHour.units;
+    record.numChannels = (numChannels < CHECKPOINT_MAX_CHANNELS)
+        ? numChannels : CHECKPOINT_MAX_CHANNELS;
+    for (uint8_t ch = 0; ch < CHECKPOINT_MAX_CHANNELS; ++ch) {
+        if (ch < record.numChannels) {
+            record.charge[ch] = totals[ch].accumulatedCharge;
+            record.energy[ch] = totals[ch].accumulatedEnergy;
+        } else {
+            ChargeAccumulator_clear(&record.charge[ch]);
+            ChargeAccumulator_clear(&record.energy[ch]);
+        }
+    }
+    if (Checkpoint_save(&record)) {
+        checkpointRequested = false;
+        SystemTime_futureTime(checkpointSeconds, &nextCheckpointTime);
+    }
+}
+
+// picks up the totals from the latest checkpoint, if it was taken with
+// the same units
+static void restoreCheckpoint (void)
+{
+    CheckpointRecord record;
+    if (Checkpoint_restore(&record) &&
+        (record.chargeUnitsPerMicroAmpHour == microAmpHour.units) &&
+        (record.energyUnitsPerMicroWattHour == microWattHour.units) &&
+        (record.numChannels <= CHECKPOINT_MAX_CHANNELS)) {
+        // channels that aren't in use now have no totals to restore to
+        const uint8_t channels = (record.numChannels < numChannels)
+            ? record.numChannels : numChannels;
+        for (uint8_t ch = 0; ch < channels; ++ch) {
+            totals[ch].accumulatedCharge = record.charge[ch];
+            totals[ch].accumulatedEnergy = record.energy[ch];
+        }
+        accumulatedTime = record.time;
+    }
+}
+
+// returns the first range to calibrate from the given one, or a range
+// past ipga_div8 if there are no more. a gain calibration only uses the
+// ranges the known current fits in
+static INA219PGA nextCalibrationRange (
+    INA219PGA pga)
+{
+    if (calibrationStep == cs_gain) {
+        while ((pga <= ipga_div8) && (calibrationExpected >=
+            (rangeFullScale[pga] - (rangeFullScale[pga] / 8)))) {
+            pga = (INA219PGA)(pga + 1);
+        }
+    }
+    return pga;
+}
+
+static void startCalibrationRange (
+    const INA219PGA pga)
+{
+    calibrationPga = pga;
+    for (uint8_t ch = 0; ch < calibrationChannels; ++ch) {
+        calibrationSums[ch] = 0;
+        calibrationCounts[ch] = 0;
+        if (readStates[ch].activePga != pga) {
+            requestRange(ch, pga);
+        }
+    }
+}
+
+// puts the channels back the way sampling left them
+static void endCalibration (void)
+{
+    calibrationStep = cs_none;
+    for (uint8_t ch = 0; ch < calibrationChannels; ++ch) {
+        if (readStates[ch].activePga != maxPga) {
+            requestRange(ch, maxPga);
+        }
+    }
+}
+
+// works out the corrections for the range that has been measured
+static void finishCalibrationRange (void)
+{
+    for (uint8_t ch = 0; ch < calibrationChannels; ++ch) {
+        const int32_t sum = calibrationSums[ch];
+        const int32_t count = calibrationCounts[ch];
+        if (calibrationStep == cs_zero) {
+            // minus the average, rounded
+            const int32_t offset = -((sum + ((sum < 0) ? -(count / 2) : (count / 2))) / count);
+            if ((offset < INT8_MIN) || (offset > INT8_MAX)) {
+                Log_message2("ch %u range %u: offset too big", ch, calibrationPga);
+            } else {
+                Calibration_setOffset(ch, calibrationPga, offset);
+                Log_message3("ch %u range %u offset: %d", ch, calibrationPga, offset);
+            }
+        } else {
+            // the offset corrected sum, against what it should have been
+            const int32_t measured = sum +
+                ((int32_t)Calibration_offset(ch, calibrationPga, adcBias) * count);
+            const int64_t expected =
+                ((int64_t)calibrationExpected * count) << CALIBRATION_GAIN_SHIFT;
+            const int32_t gain = (measured > 0) ? (expected / measured) : 0;
+            if ((gain < MIN_CALIBRATION_GAIN) || (gain > MAX_CALIBRATION_GAIN)) {
+                Log_message2("ch %u range %u: gain out of range", ch, calibrationPga);
+            } else {
+                Calibration_setGain(ch, calibrationPga, gain);
+                Log_message3("ch %u range %u gain x10000: %u", ch, calibrationPga,
+                    ((uint32_t)gain * 10000) >> CALIBRATION_GAIN_SHIFT);
+            }
+        }
+    }
+
+    const INA219PGA nextPga = nextCalibrationRange((INA219PGA)(calibrationPga + 1));
+    if (nextPga <= ipga_div8) {
+        startCalibrationRange(nextPga);
+    } else {
+        endCalibration();
+        if (Calibration_save()) {
+            Log_message("calibration saved");
+        } else {
+            Log_message("calibration not saved: eeprom busy");
+        }
+    }
+}
+
+// adds a good reading to the calibration sums, once the channel is
+// converting at the range being calibrated
+static void addCalibrationReading (
+    const uint8_t channel,
+    const int16_t reading,
+    const INA219PGA samplePga)
+{
+    if (channel >= calibrationChannels) {
+        return;
+    }
+    volatile ChannelReadState *state = &readStates[channel];
+    if (samplePga != calibrationPga) {
+        if (!state->rangeChangeInFlight && (state->activePga != calibrationPga)) {
+            // the range change couldn't be queued last time
+            requestRange(channel, calibrationPga);
+        }
+    } else if (calibrationCounts[channel] < CALIBRATION_SAMPLES) {
+        calibrationSums[channel] += reading;
+        ++calibrationCounts[channel];
+
+        bool rangeDone = true;
+        for (uint8_t ch = 0; ch < calibrationChannels; ++ch) {
+            rangeDone = rangeDone && (calibrationCounts[ch] >= CALIBRATION_SAMPLES);
+        }
+        if (rangeDone) {
+            finishCalibrationRange();
+        }
+    }
+}
+
+// returns true if a calibration can start now. otherwise says why not
+static bool canCalibrate (void)
+{
+    bool can = false;
+
+    if (pmState != pms_sampling) {
+        Log_message("start sampling first");
+    } else if (scaling != pss_firmware) {
+        Log_message("calibration needs fw scaling");
+    } else if (calibrationStep != cs_none) {
+        Log_message("already calibrating");
+    } else if (Calibration_isSaving()) {
+        Log_message("eeprom busy");
+    } else {
+        can = true;
+    }
+
+    return can;
+}
+
+bool PowerMeter_calibrateZero (void)
+{
+    const bool started = canCalibrate();
+
+    if (started) {
+        calibrationStep = cs_zero;
+        calibrationChannels = (numChannels < CALIBRATION_MAX_CHANNELS)
+            ? numChannels : CALIBRATION_MAX_CHANNELS;
+        startCalibrationRange(ipga_unity);
+        Log_message("calibrating zero");
+    }
+
+    return started;
+}
+
+bool PowerMeter_calibrateGain (
+    const uint16_t knownMilliAmps)
+{
+    bool started = false;
+
+    // a shunt voltage reading is 10uV
+    const uint32_t expected = ((uint32_t)knownMilliAmps * shuntMilliOhms) / 10;
+
+    if (canCalibrate()) {
+        if ((expected == 0) || (expected > INT16_MAX)) {
+            Log_message("current out of range for the shunt");
+        } else {
+            calibrationStep = cs_gain;
+            calibrationExpected = expected;
+            const INA219PGA firstPga = nextCalibrationRange(ipga_unity);
+            if (firstPga > ipga_div8) {
+                calibrationStep = cs_none;
+                Log_message("current out of range for the shunt");
+            } else {
+                calibrationChannels = (numChannels < CALIBRATION_MAX_CHANNELS)
+                    ? numChannels : CALIBRATION_MAX_CHANNELS;
+                startCalibrationRange(firstPga);
+                Log_message1("calibrating gain, expecting %d", calibrationExpected);
+                started = true;
+            }
+        }
+    }
+
+    return started;
+}
+
+bool PowerMeter_clearCalibration (void)
+{
+    bool cleared = false;
+
+    if (calibrationStep != cs_none) {
+        Log_message("already calibrating");
+    } else if (!Calibration_clear() || !Calibration_save()) {
+        Log_message("eeprom busy");
+    } else {
+        Log_message("calibration cleared");
+        cleared = true;
+    }
+
+    return cleared;
+}
+
+bool PowerMeter_setSampleMode (
+    const PowerMeterSampleMode mode)
+{
+    bool modeSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if (samplePeriodMicros < minSamplePeriodMicros(mode, numChannels)) {
+        Log_message("sample rate too high for this mode");
+    } else if ((mode == psm_timed) && (scaling == pss_hardware)) {
+        Log_message("hardware scaling needs cnvr mode");
+    } else {
+        sampleMode = mode;
+        modeSet = true;
+    }
+
+    return modeSet;
+}
+
+// returns true if the sample rate works with the given settings.
+// otherwise says why not
+static bool sampleRateIsValid (
+    const uint16_t newSamplesPerSecond,
+    const PowerMeterSampleMode mode,
+    const uint8_t channels,
+    const uint32_t intervalMs)
+{
+    bool valid = false;
+
+    if (newSamplesPerSecond < MIN_SAMPLES_PER_SECOND) {
+        Log_message("rate too low: minimum is 10");
+    } else if (newSamplesPerSecond > MAX_SAMPLES_PER_SECOND) {
+        Log_message("rate too high: INA219 can't convert that fast");
+    } else {
+        const uint32_t periodMicros = 1000000UL / newSamplesPerSecond;
+        if (periodMicros < minSamplePeriodMicros(mode, channels)) {
+            Log_message("rate too high: can't read samples that fast in this mode");
+        } else if (((uint64_t)intervalMs * 1000) < periodMicros) {
+            Log_message("rate too low for the report interval");
+        } else {
+            valid = true;
+        }
+    }
+
+    return valid;
+}
+
+// sets up the ADC and timer for a sample rate that has been checked
+static void applySampleRate (
+    const uint16_t newSamplesPerSecond)
+{
+    const uint32_t periodMicros = 1000000UL / newSamplesPerSecond;
+
+    // each shunt conversion is followed by a bus conversion, and both
+    // have to fit in a sample period. the shunt gets the most averaging
+    // that leaves room for the fastest bus conversion, and the bus gets
+    // as many bits as fit in the rest
+    uint8_t adcIndex = 0;
+    while (((adcIndex + 1) < NUM_ADC_SETTINGS) &&
+        ((pgm_read_dword(&adcConversionMicros[adcIndex + 1]) +
+        MIN_CONVERSION_MICROS) <= periodMicros)) {
+        ++adcIndex;
+    }
+    const uint32_t shuntConversionMicros =
+        pgm_read_dword(&adcConversionMicros[adcIndex]);
+    uint8_t busAdcIndex = 0;
+    while (((busAdcIndex + 1) < NUM_BUS_ADC_SETTINGS) &&
+        ((shuntConversionMicros +
+        pgm_read_dword(&adcConversionMicros[busAdcIndex + 1])) <= periodMicros)) {
+        ++busAdcIndex;
+    }
+
+    // use the finest weight unit that lets a 16 bit weight cover
+    // MAX_WEIGHT_PERIODS periods
+    const uint32_t countsPerPeriod = SYSTEMTIME_COUNTS_PER_SECOND / newSamplesPerSecond;
+    uint8_t shift = 0;
+    while (((countsPerPeriod * MAX_WEIGHT_PERIODS) >> shift) >= 65536UL) {
+        ++shift;
+    }
+
+    samplesPerSecond = newSamplesPerSecond;
+    samplePeriodMicros = periodMicros;
+    shuntAdc = (INA219ADC)pgm_read_byte(&adcSettings[adcIndex]);
+    busAdc = (INA219ADC)pgm_read_byte(&adcSettings[busAdcIndex]);
+    weightShift = shift;
+    weightPerTick = countsPerPeriod >> shift;
+    // a whole number of weight units, so the weights add up to the time
+    // exactly
+    countsPerTick = (uint32_t)weightPerTick << shift;
+    ReportClock_setTick(countsPerTick, COUNTS_PER_MS, &reportTick);
+    setUnits();
+
+    Log_message3("samples/s: %u, period uS: %u, conversion uS: %u",
+        samplesPerSecond, samplePeriodMicros,
+        shuntConversionMicros + pgm_read_dword(&adcConversionMicros[busAdcIndex]));
+}
+
+bool PowerMeter_setSampleRate (
+    const uint16_t newSamplesPerSecond)
+{
+    bool rateSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if (sampleRateIsValid(newSamplesPerSecond, sampleMode,
+        numChannels, reportIntervalMs)) {
+        applySampleRate(newSamplesPerSecond);
+        rateSet = true;
+    }
+
+    return rateSet;
+}
+
+bool PowerMeter_setScaling (
+    const PowerMeterScaling newScaling)
+{
+    bool scalingSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if ((newScaling == pss_hardware) && (sampleMode == psm_timed)) {
+        Log_message("hardware scaling needs cnvr mode");
+    } else {
+        scaling = newScaling;
+        setUnits();
+        scalingSet = true;
+    }
+
+    return scalingSet;
+}
+
+// returns true if the INA219 can measure up to maxExpectedMilliAmps with
+// the shunt. otherwise says why not
+static bool shuntIsValid (
+    const uint16_t newShuntMilliOhms,
+    const uint16_t maxExpectedMilliAmps)
+{
+    bool valid = false;
+
+    // shunt voltage at the maximum current
+    const uint32_t fullScaleMicroVolts =
+        (uint32_t)newShuntMilliOhms * maxExpectedMilliAmps;
+    const uint16_t newCurrentLSB =
+        INA219_currentLSBMicroAmps(maxExpectedMilliAmps);
+
+    if ((fullScaleMicroVolts == 0) ||
+        (fullScaleMicroVolts > (PGA_UNITY_FULL_SCALE_MICROVOLTS << ipga_div8))) {
+        Log_message("shunt voltage out of range: 320mV max");
+    } else if (INA219_calibrationValue(newShuntMilliOhms, newCurrentLSB) == 0) {
+        Log_message("can't calibrate for that shunt and current");
+    } else {
+        valid = true;
+    }
+
+    return valid;
+}
+
+// sets up the scaling for a shunt that has been checked
+static void applyShunt (
+    const uint16_t newShuntMilliOhms,
+    const uint16_t maxExpectedMilliAmps)
+{
+    const uint32_t fullScaleMicroVolts =
+        (uint32_t)newShuntMilliOhms * maxExpectedMilliAmps;
+
+    // use the most gain that covers the maximum current
+    INA219PGA newPga = ipga_unity;
+    while ((PGA_UNITY_FULL_SCALE_MICROVOLTS << newPga) < fullScaleMicroVolts) {
+        newPga = (INA219PGA)(newPga + 1);
+    }
+
+    shuntMilliOhms = newShuntMilliOhms;
+    maxCurrentMilliAmps = maxExpectedMilliAmps;
+    currentLSBMicroAmps = INA219_currentLSBMicroAmps(maxExpectedMilliAmps);
+    maxPga = newPga;
+    setUnits();
+
+    Log_message3("shunt mOhm: %u, current LSB uA: %u, cal: %u",
+        shuntMilliOhms, currentLSBMicroAmps,
+        INA219_calibrationValue(shuntMilliOhms, currentLSBMicroAmps));
+}
+
+bool PowerMeter_setShunt (
+    const uint16_t newShuntMilliOhms,
+    const uint16_t maxExpectedMilliAmps)
+{
+    bool shuntSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if (shuntIsValid(newShuntMilliOhms, maxExpectedMilliAmps)) {
+        applyShunt(newShuntMilliOhms, maxExpectedMilliAmps);
+        shuntSet = true;
+    }
+
+    return shuntSet;
+}
+
+bool PowerMeter_setAutoRange (
+    const bool enable)
+{
+    bool autoRangeSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else {
+        autoRange = enable;
+        autoRangeSet = true;
+    }
+
+    return autoRangeSet;
+}
+
+bool PowerMeter_setNumChannels (
+    const uint8_t newNumChannels)
+{
+    bool channelsSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if ((newNumChannels == 0) || (newNumChannels > maxChannels())) {
+        Log_message1("channels is 1 to %u", maxChannels());
+    } else if (samplePeriodMicros <
+        minSamplePeriodMicros(sampleMode, newNumChannels)) {
+        Log_message("sample rate too high for that many channels");
+    } else {
+        // the new channels start from zero
+        useChannels(newNumChannels);
+        Log_message1("channels: %u", numChannels);
+        channelsSet = true;
+    }
+
+    return channelsSet;
+}
+
+void PowerMeter_setOutputFormat (
+    const PowerMeterOutputFormat format)
+{
+    // takes effect from the next report. the host needs the units before
+    // it can decode binary reports
+    if ((format == pof_binary) && (outputFormat != pof_binary) &&
+        !rawStreaming && (pmState == pms_sampling)) {
+        unitsPending = true;
+        sendBinaryUnits();
+    }
+    outputFormat = format;
+    // a host decoding binary reports can expand the messages too
+    Log_setDeferred(format == pof_binary);
+}
+
+bool PowerMeter_setRawStreaming (
+    const bool enable)
+{
+    bool streamingSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else {
+        rawStreaming = enable;
+        streamingSet = true;
+    }
+
+    return streamingSet;
+}
+
+void PowerMeter_setBackPressure (
+    const bool enable)
+{
+    backPressure = enable;
+}
+
+// called from the EEPROM ready interrupt when the test's writes are done
+static void eepromTestCompletionHandler (
+    void *context)
+{
+    eepromTestMicros = SystemTime_nowMicros() - eepromTestStartMicros;
+    eepromTestDone = true;
+}
+
+bool PowerMeter_testEEPROM (void)
+{
+    bool testStarted = false;
+
+    if (pmState != pms_sampling) {
+        Log_message("start sampling first");
+    } else if (eepromTestRunning || !EEPROM_isIdle()) {
+        Log_message("eeprom busy");
+    } else {
+        // 0x5A and 0xA5 each need bits set and bits cleared to become the
+        // other, so every byte takes a full erase and write
+        const uint8_t value =
+            (EEPROM_read(EEPROM_SCRATCH_ADDR) == 0x5A) ? 0xA5 : 0x5A;
+        char SREGSave = SREG;
+        cli();
+        eepromTestMissedSamples = missedSamples;
+        eepromTestOverrunSamples = overrunSamples;
+        SREG = SREGSave;
+        eepromTestBytesWritten = EEPROM_bytesWritten();
+        eepromTestDone = false;
+        eepromTestStartMicros = SystemTime_nowMicros();
+        testStarted = EEPROM_fill(EEPROM_SCRATCH_ADDR, EEPROM_SCRATCH_SIZE,
+            value, eepromTestCompletionHandler, NULL);
+        eepromTestRunning = testStarted;
+    }
+
+    return testStarted;
+}
+
+// logs the EEPROM self-test's results once its writes are done
+static void checkEEPROMTest (void)
+{
+    if (eepromTestRunning && eepromTestDone) {
+        eepromTestRunning = false;
+        char SREGSave = SREG;
+        cli();
+        const uint16_t missed = missedSamples - eepromTestMissedSamples;
+        const uint16_t overruns = overrunSamples - eepromTestOverrunSamples;
+        SREG = SREGSave;
+        Log_message2("eeprom test: %u bytes in %u mS",
+            EEPROM_bytesWritten() - eepromTestBytesWritten,
+            eepromTestMicros / 1000);
+        Log_message2("eeprom test: missed samples: %u, overruns: %u",
+            missed, overruns);
+    }
+}
+
+void PowerMeter_benchmarkScaling (void)
+{
+    volatile int16_t currentSink;
+    volatile int32_t powerSink;
+    volatile uint16_t lastHardwarePower;
+    uint32_t start;
+    uint32_t overheadCounts;
+    uint32_t firmwareCounts;
+    uint32_t hardwareCounts;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+        return;
+    }
+
+    char SREGSave = SREG;
+    cli();
+    start = SystemTime_nowCounts();
+    overheadCounts = SystemTime_nowCounts() - start;
+
+    // readings spread over the range, some of them clamped, at 12V
+    start = SystemTime_nowCounts();
+    for (uint8_t i = 0; i < SCALING_BENCH_SAMPLES; ++i) {
+        const int16_t current = Calibration_correct(0, ipga_div8,
+            (int16_t)(i * 1021), adcBias);
+        currentSink = current;
+        powerSink = samplePower(current, 3000);
+    }
+    firmwareCounts = SystemTime_nowCounts() - start;
+
+    // what processSample does instead with the registers
+    start = SystemTime_nowCounts();
+    for (uint8_t i = 0; i < SCALING_BENCH_SAMPLES; ++i) {
+        currentSink = (int16_t)(i * 1021);
+        lastHardwarePower = i;
+        powerSink = lastHardwarePower;
+    }
+    hardwareCounts = SystemTime_nowCounts() - start;
+    SREG = SREGSave;
+    (void)currentSink;
+    (void)powerSink;
+
+    // timer 3 counts every 8 cycles
+    Log_message2("scaling cycles/sample: fw %u, hw %u",
+        ((firmwareCounts - overheadCounts) * 8) / SCALING_BENCH_SAMPLES,
+        ((hardwareCounts - overheadCounts) * 8) / SCALING_BENCH_SAMPLES);
+}
+
+bool PowerMeter_setReportInterval (
+    const uint32_t newReportIntervalMs)
+{
+    bool intervalSet = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if ((newReportIntervalMs == 0) ||
+        (newReportIntervalMs > MAX_REPORT_INTERVAL_MS)) {
+        Log_message("report interval is 1 to 86400000 mS");
+    } else if (((uint64_t)newReportIntervalMs * 1000) < samplePeriodMicros) {
+        Log_message("report interval shorter than sample period");
+    } else {
+        reportIntervalMs = newReportIntervalMs;
+        Log_message1("report interval mS: %u", reportIntervalMs);
+        intervalSet = true;
+    }
+
+    return intervalSet;
+}
+
+bool PowerMeter_setCheckpointInterval (
+    const uint16_t seconds)
+{
+    bool intervalSet = false;
+
+    if (seconds > MAX_CHECKPOINT_SECONDS) {
+        Log_message("checkpoint interval is 0 to 32767 S");
+    } else if ((seconds == 0) && !Checkpoint_clear()) {
+        // so that old totals don't come back at the next reset
+        Log_message("checkpoint being written, try again");
+    } else {
+        checkpointSeconds = seconds;
+        SystemTime_futureTime(checkpointSeconds, &nextCheckpointTime);
+        Log_message1("checkpoint interval S: %u", checkpointSeconds);
+        intervalSet = true;
+    }
+
+    return intervalSet;
+}
+
+void PowerMeter_getSettings (
+    PowerMeterSettings *settings)
+{
+    settings->samplesPerSecond = samplesPerSecond;
+    settings->reportIntervalMs = reportIntervalMs;
+    settings->numChannels = numChannels;
+    settings->sampleMode = sampleMode;
+    settings->scaling = scaling;
+    settings->autoRange = autoRange;
+    settings->shuntMilliOhms = shuntMilliOhms;
+    settings->maxCurrentMilliAmps = maxCurrentMilliAmps;
+    settings->adcBias = adcBias;
+    settings->outputFormat = outputFormat;
+    settings->rawStreaming = rawStreaming;
+    settings->backPressure = backPressure;
+    settings->checkpointSeconds = checkpointSeconds;
+}
+
+void PowerMeter_defaultSettings (
+    PowerMeterSettings *settings)
+{
+    settings->samplesPerSecond = DEFAULT_SAMPLES_PER_SECOND;
+    settings->reportIntervalMs = DEFAULT_REPORT_INTERVAL_MS;
+    settings->numChannels = 1;
+    settings->sampleMode = psm_conversionReady;
+    settings->scaling = pss_firmware;
+    settings->autoRange = false;
+    settings->shuntMilliOhms = DEFAULT_SHUNT_MILLIOHMS;
+    settings->maxCurrentMilliAmps = DEFAULT_MAX_CURRENT_MILLIAMPS;
+    settings->adcBias = DEFAULT_ADC_BIAS;
+    settings->outputFormat = pof_text;
+    settings->rawStreaming = false;
+    settings->backPressure = false;
+    settings->checkpointSeconds = DEFAULT_CHECKPOINT_SECONDS;
+}
+
+bool PowerMeter_applySettings (
+    const PowerMeterSettings *settings)
+{
+    bool applied = false;
+
+    if (isSampling()) {
+        Log_message("stop sampling first");
+    } else if ((settings->numChannels == 0) ||
+        (settings->numChannels > maxChannels())) {
+        Log_message1("channels is 1 to %u", maxChannels());
+    } else if ((settings->reportIntervalMs == 0) ||
+        (settings->reportIntervalMs > MAX_REPORT_INTERVAL_MS)) {
+        Log_message("report interval is 1 to 86400000 mS");
+    } else if ((settings->sampleMode > psm_conversionReady) ||
+        (settings->scaling > pss_hardware) ||
+        (settings->outputFormat > pof_binary)) {
+        Log_message("bad setting");
+    } else if ((settings->scaling == pss_hardware) &&
+        (settings->sampleMode == psm_timed)) {
+        Log_message("hardware scaling needs cnvr mode");
+    } else if (settings->checkpointSeconds > MAX_CHECKPOINT_SECONDS) {
+        Log_message("checkpoint interval is 0 to 32767 S");
+    } else if (sampleRateIsValid(settings->samplesPerSecond,
+            (PowerMeterSampleMode)settings->sampleMode,
+            settings->numChannels, settings->reportIntervalMs) &&
+        shuntIsValid(settings->shuntMilliOhms,
+            settings->maxCurrentMilliAmps)) {
+        sampleMode = (PowerMeterSampleMode)settings->sampleMode;
+        scaling = (PowerMeterScaling)settings->scaling;
+        autoRange = settings->autoRange;
+        reportIntervalMs = settings->reportIntervalMs;
+        // the units depend on the scaling, the shunt and the rate, so
+        // the rate goes last
+        applyShunt(settings->shuntMilliOhms, settings->maxCurrentMilliAmps);
+        applySampleRate(settings->samplesPerSecond);
+        adcBias = settings->adcBias;
+        PowerMeter_setOutputFormat(
+            (PowerMeterOutputFormat)settings->outputFormat);
+        rawStreaming = settings->rawStreaming;
+        backPressure = settings->backPressure;
+        if (settings->checkpointSeconds != checkpointSeconds) {
+            PowerMeter_setCheckpointInterval(settings->checkpointSeconds);
+        }
+        if (settings->numChannels != numChannels) {
+            useChannels(settings->numChannels);
+        }
+        applied = true;
+    }
+
+    return applied;
+}
+
+void PowerMeter_reset (void)
+{
+    char SREGSave = SREG;
+    cli();
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        ChargeAccumulator_clear(&totals[ch].accumulatedCharge);
+        ChargeAccumulator_clear(&totals[ch].accumulatedEnergy);
+    }
+    accumulatedTime = 0;
+    nextReportTime = reportIntervalMs;
+    SREG = SREGSave;
+    checkpointRequested = (checkpointSeconds != 0);
+}
+
+void PowerMeter_Initialize (void)
+{
+    enabled = false;
+    sampleMode = psm_conversionReady;
+    scaling = pss_firmware;
+    outputFormat = pof_text;
+    rawStreaming = false;
+    backPressure = false;
+    reportQueueHead = 0;
+    reportQueueLength = 0;
+    channelsWritten = 0;
+    unreportedGap = 0;
+    weightShift = 0;
+    samplePeriodMicros = 0;
+    checkpointSeconds = 0;
+    useChannels(1);
+    Checkpoint_Initialize();
+    Calibration_Initialize();
+    calibrationStep = cs_none;
+    eepromTestRunning = false;
+
+    // come up in the saved configuration
+    PowerMeterSettings settings;
+    if (!Settings_load(&settings) || !PowerMeter_applySettings(&settings)) {
+        PowerMeter_defaultSettings(&settings);
+        PowerMeter_applySettings(&settings);
+    }
+    for (uint8_t ch = 0; ch < numChannels; ++ch) {
+        readStates[ch].activePga = maxPga;
+    }
+
+    // needs the units, so after the settings
+    checkpointRequested = false;
+    SystemTime_futureTime(checkpointSeconds, &nextCheckpointTime);
+    if (checkpointSeconds != 0) {
+        restoreCheckpoint();
+    }
+    INA219OperationsPending = 0;
+    setupChannel = 0;
+
+    pmState = pms_initial;
+}
+
+// takes the next sample out of sampleBuffer, adds it to the totals and
+// the stream, and sends the report it ends, if it ends one
+static void processSample (void)
+{
+    const uint8_t head = sampleBufferHead;
+    const uint8_t channelIndex = sampleBuffer[head].channel;
+    ChannelTotals *channel = &totals[channelIndex];
+    const uint8_t flags = sampleBuffer[head].flags;
+    const int16_t currentReading = sampleBuffer[head].current;
+    const uint16_t busVoltage = sampleBuffer[head].busVoltage;
+    const uint16_t hardwarePower = sampleBuffer[head].power;
+    const uint16_t weight = sampleBuffer[head].weight;
+    const SystemTime_Micros_t sampleTime = sampleBuffer[head].time;
+    const bool followsGap = (flags & SAMPLE_FOLLOWS_GAP) != 0;
+    const bool isSettling = (flags & SAMPLE_SETTLING) != 0;
+    const bool isValid = ((flags & SAMPLE_VALID) != 0) && !isSettling;
+    const INA219PGA samplePga = (INA219PGA)(flags & SAMPLE_PGA_MASK);
+    const bool overflow = (flags & SAMPLE_OVERFLOW) != 0;
+    const bool endsReport = (flags & SAMPLE_ENDS_REPORT) != 0;
+    sampleBufferHead = (head + 1) & (SAMPLE_BUFFER_LEN - 1);
+
+    if (rawStreaming) {
+        SampleStream_add(channelIndex, currentReading, weight,
+            sampleTime, followsGap,
+            isSettling ? ssk_settling
+            : isValid ? ssk_absolute : ssk_invalid);
+    }
+
+    // failed reads are left out of the average rather than
+    // adding in whatever value they came back with. the charge
+    // for the time they cover is estimated from the last
+    // report's average
+    int16_t current = channel->sampleAverageCurrent;
+    int32_t power;
+    if (scaling == pss_hardware) {
+        if (isValid) {
+            current = currentReading;
+            channel->lastHardwarePower = hardwarePower;
+        }
+        power = channel->lastHardwarePower;
+    } else {
+        if (isValid) {
+            current = Calibration_correct(channelIndex,
+                samplePga, currentReading, adcBias);
+        }
+        power = samplePower(current, busVoltage);
+    }
+    if (isValid) {
+        const int32_t charge = (int32_t)current * weight;
+        channel->sampleWeightSum += weight;
+        ChargeAccumulator_add(charge, &channel->sampleSum);
+        ChargeAccumulator_add(charge, &channel->accumulatedCharge);
+        if (calibrationStep != cs_none) {
+            addCalibrationReading(channelIndex, currentReading, samplePga);
+        } else if (autoRange && sampling) {
+            // once sampling has stopped the range is left as it is
+            updateRange(channelIndex, currentReading, samplePga, overflow);
+        }
+    } else {
+        if (isSettling) {
+            ++channel->settlingSamples;
+        } else {
+            ++channel->invalidSamples;
+        }
+        ChargeAccumulator_add(
+            (int32_t)current * weight, &channel->accumulatedCharge);
+    }
+    ChargeAccumulator_addProduct(
+        power, weight, &channel->accumulatedEnergy);
+
+    if (endsReport) {
+        int32_t reportTimeSnapshot;
+        char SREGSave = SREG;
+        cli();
+        reportTimeSnapshot = reportTime;
+        SREG = SREGSave;
+
+        // if every read in the interval failed we carry the
+        // previous average forward
+        for (uint8_t ch = 0; ch < numChannels; ++ch) {
+            if (totals[ch].sampleWeightSum > 0) {
+                totals[ch].sampleAverageCurrent =
+                    bucketAverage(&totals[ch]);
+            }
+        }
+        if (rawStreaming) {
+            // keeps the samples at most one report interval
+            // behind
+            SampleStream_flush();
+        }
+        sendReport(reportTimeSnapshot);
+        if ((checkpointSeconds != 0) && (checkpointRequested ||
+            SystemTime_timeHasArrived(&nextCheckpointTime))) {
+            // the totals match the report just sent
+            saveCheckpoint(reportTimeSnapshot);
+        }
+
+        // reset for next report
+        clearReportSums();
+    }
+}
+
+void PowerMeter_task (void)
+{
+    checkEEPROMTest();
+
+    switch (pmState) {
+        case pms_initial :
+            // the I2C queue is short, so the channels are configured one
+            // at a time
+            INA219OperationSucceeded = true;
+            setupChannel = 0;
+            Log_message("Configuring");
+            pmState = pms_waitingForConfigCompletion;
+            break;
+        case pms_waitingForConfigCompletion :
+            if (INA219OperationsPending == 0) {
+                if (!INA219OperationSucceeded) {
+                    // try again
+                    Log_message("Config failed");
+                    pmState = pms_initial;
+                } else if (setupChannel < numChannels) {
+                    if (queueConfiguration(setupChannel)) {
+                        countQueuedOperation();
+                        ++setupChannel;
+                    }
+                } else {
+                    Log_message("Config complete");
+                    pmState = pms_stopped;
+                }
+            }
+            break;
+        case pms_stopped :
+            // reports still queued when sampling stopped
+            writeReports();
+            if (checkpointRequested) {
+                int32_t timeSnapshot;
+                char SREGSave = SREG;
+                cli();
+                timeSnapshot = accumulatedTime;
+                SREG = SREGSave;
+                saveCheckpoint(timeSnapshot);
+            }
+            if (enabled) {
+                Log_message("Starting");
+
+                // auto-ranging starts from the biggest range
+                for (uint8_t ch = 0; ch < numChannels; ++ch) {
+                    readStates[ch].activePga = maxPga;
+                    readStates[ch].rangeChangeInFlight = false;
+                    readStates[ch].settlingSamplesRemaining = 0;
+                }
+                INA219OperationSucceeded = true;
+                setupChannel = 0;
+                Log_message("setting register ptr");
+                pmState = pms_waitingForRegisterPtrSet;
+            }
+            break;
+        case pms_waitingForRegisterPtrSet :
+            if (INA219OperationsPending > 0) {
+                // wait for the channel being set up
+            } else if (!INA219OperationSucceeded) {
+                // try again
+                pmState = pms_stopped;
+            } else if (setupChannel < numChannels) {
+                // configure the ADC for the sample rate, calibrate, then
+                // point at the current reading. the queue does them in
+                // order
+                const uint8_t ch = setupChannel;
+                if (queueConfiguration(ch)) {
+                    countQueuedOperation();
+                    if (INA219_setCalibration(
+                        shuntMilliOhms, currentLSBMicroAmps, &sensors[ch])) {
+                        countQueuedOperation();
+                        if (INA219_setRegisterPtr(currentRegister(), &sensors[ch])) {
+                            countQueuedOperation();
+                            ++setupChannel;
+                        } else {
+                            // I2C queue full - start this channel again
+                            INA219OperationSucceeded = false;
+                        }
+                    } else {
+                        INA219OperationSucceeded = false;
+                    }
+                }
+            } else {
+                reportIsDue = false;
+                nextReportTime = accumulatedTime + reportIntervalMs;
+                for (uint8_t ch = 0; ch < numChannels; ++ch) {
+                    ChannelTotals *channel = &totals[ch];
+                    channel->sampleWeightSum = 0;
+                    ChargeAccumulator_clear(&channel->sampleSum);
+                    channel->sampleAverageCurrent = 0;
+                    channel->lastHardwarePower = 0;
+                    channel->invalidSamples = 0;
+                    channel->quietSamples = 0;
+                    channel->rangeSwitches = 0;
+                    channel->settlingSamples = 0;
+
+                    volatile ChannelReadState *state = &readStates[ch];
+                    state->lastBusVoltage = 0;
+                    state->busVoltageTicks = BUS_VOLTAGE_READ_TICKS - 1; // read it first
+                    state->registerPtrAtShunt = true;
+                }
+                countsRemainder = 0;
+                sampleBufferHead = 0;
+                sampleBufferTail = 0;
+                missedSamples = 0;
+                overrunSamples = 0;
+                // an EEPROM test still running counts from here
+                eepromTestMissedSamples = 0;
+                eepromTestOverrunSamples = 0;
+                cappedWeights = 0;
+                timeGapChannels = 0;
+                sampleInFlight = false;
+
+                // from here on sample reads are started by the timer
+                // interrupt and completed by the TWI interrupt
+                sampling = true;
+
+                // start the sample tick. the first one is a whole tick
+                // from now, and the first conversions are weighted from now
+                char SREGSave = SREG;
+                cli();
+                const uint32_t startCount = SystemTime_nowCounts();
+                for (uint8_t ch = 0; ch < numChannels; ++ch) {
+                    readStates[ch].lastConversionTime =
+                        startCount & ~((1UL << weightShift) - 1);
+                }
+                nextSampleTickCount = startCount + countsPerTick;
+                OCR3B = (uint16_t)nextSampleTickCount;
+                // timer 3 is shared - writing a 1 clears only this flag
+                TIFR3 = (1 << OCF3B);   // "clear" the timer compare flag
+                TIMSK3 |= (1 << OCIE3B);// enable timer compare match interrupt
+                SREG = SREGSave;
+
+                Log_message("sampling");
+                BinaryFrame_resetCounts();
+                SampleStream_start(streamChannels);
+                droppedReports = 0;
+                unitsPending = (outputFormat == pof_binary) || rawStreaming;
+                sendBinaryUnits();
+                pmState = pms_sampling;
+            }
+            break;
+        case pms_sampling :
+            sendBinaryUnits();
+            writeReports();
+            if (rawStreaming) {
+                SampleStream_task();
+            }
+            if (sampleBufferHead != sampleBufferTail) {
+                processSample();
+            } else if (!enabled) {
+                // disabled - stop timer interrupts
+                TIMSK3 &= ~(1 << OCIE3B);// disable timer compare match interrupt
+                TIFR3 = (1 << OCF3B);   // "clear" the timer compare flag
+                sampling = false;
+                if (calibrationStep != cs_none) {
+                    // the ranges done so far are in use, but not saved
+                    calibrationStep = cs_none;
+                    Log_message("calibration stopped");
+                }
+                pmState = pms_waitingForLastSample;
+            }
+            break;
+        case pms_waitingForLastSample :
+            {
+                // let a read that is in flight complete before handing the
+                // I2C interface back to the mainloop, take in the samples
+                // still in sampleBuffer, and finish the report line being
+                // written, so none of these get dropped. the reads are checked
+                // first: once they are done, the last sample is in the buffer
+                writeReports();
+                if (rawStreaming) {
+                    SampleStream_task();
+                }
+                const bool readsDone = I2CAsync_isIdle();
+                if (sampleBufferHead != sampleBufferTail) {
+                    processSample();
+                } else if (readsDone && (channelsWritten == 0)) {
+                    Log_message1("missed samples: %u", missedSamples);
+                    Log_message1("overrun samples: %u", overrunSamples);
+                    if (cappedWeights > 0) {
+                        Log_message1("capped weights: %u", cappedWeights);
+                    }
+                    Log_message1("dropped frames: %u", BinaryFrame_droppedCount());
+                    Log_message1("dropped reports: %u", droppedReports);
+                    if (rawStreaming) {
+                        SampleStream_flush();
+                        Log_message1("unstreamed samples: %u",
+                            SampleStream_droppedCount());
+                    }
+                    Log_message1("invalid samples: %u",
+                        sumCounts(offsetof(ChannelTotals, invalidSamples)));
+                    if (autoRange) {
+                        Log_message1("range switches: %u",
+                            sumCounts(offsetof(ChannelTotals, rangeSwitches)));
+                        Log_message1("settling samples: %u",
+                            sumCounts(offsetof(ChannelTotals, settlingSamples)));
+                    }
+                    // keep the totals as they were when sampling stopped
+                    checkpointRequested = (checkpointSeconds != 0);
+                    pmState = pms_stopped;
+                }
+            }
+            break;
+    }
+}
+
+// counts the time and starts the sample reads for a sample tick. called
+// from the timer 3 compare B interrupt
+static void sampleTick (void)
+{
+    accumulatedTime =
+        ReportClock_addTick(accumulatedTime, &reportTick, &countsRemainder);
+    if (ReportClock_isDue(accumulatedTime, nextReportTime)) {
+        reportIsDue = true;
+        reportTime = accumulatedTime;
+        nextReportTime += reportIntervalMs;
+    }
+
+    if (sampling) {
+        // start the first channel's sample read. it completes in the TWI
+        // interrupt, which goes on to read the other channels
+        const bool endsReport = reportIsDue;
+        bool readStarted = false;
+        if (!sampleInFlight) {
+            readChannel = 0;
+            readStarted = startChannelRead();
+        }
+        if (readStarted) {
+            sampleInFlight = true;
+            sampleInProgressEndsReport = endsReport;
+            reportIsDue = false;
+        } else {
+            // previous sample read not complete yet, or I2C queue full
+            ++missedSamples;
+            markMissedTick();
+        }
+    }
+}
+
+ISR(TIMER3_COMPB_vect)
+{
+    // the compare only matches the low 16 bits of the tick count, so it
+    // comes early when a tick is longer than that. ticks that went by
+    // while interrupts were held off are caught up on, and the next
+    // compare is never set to a count that has already gone by
+    do {
+        while (SystemTime_countHasArrived(nextSampleTickCount)) {
+            nextSampleTickCount += countsPerTick;
+            sampleTick();
+        }
+        OCR3B = (uint16_t)nextSampleTickCount;
+    } while (SystemTime_countHasArrived(nextSampleTickCount));
+}
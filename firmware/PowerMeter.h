@@ -1,25 +1,158 @@
-//
-// Power Meter - using INA219 high side current sensor
-//
-//  How to use it
-//
-
-#ifndef POWERMETER_H
-#define POWERMETER_H
-
-#include <stdint.h>
-#include <stdbool.h>
-#include <string.h>
-#include <stddef.h>
-
-extern void PowerMeter_start (void);
-
-extern void PowerMeter_stop (void);
-
-extern void PowerMeter_reset (void);
-
-extern void PowerMeter_Initialize (void);
-
-extern void PowerMeter_task (void);
-
+//
+// Power Meter - using INA219 high side current sensor
+//
+//  How to use it
+//
+
+#ifndef POWERMETER_H
+#define POWERMETER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+
+// INA219 addresses, consecutive from 0x40. fewer channels than this may
+// fit in RAM (see PowerMeter_setNumChannels)
+#define POWERMETER_MAX_CHANNELS 16
+
+typedef enum PowerMeterSampleMode_enum {
+    psm_timed,              // read the shunt voltage on every tick
+    psm_conversionReady     // read each INA219 conversion exactly once
+} PowerMeterSampleMode;
+
+typedef enum PowerMeterScaling_enum {
+    pss_firmware,           // read the shunt voltage and scale it here
+    pss_hardware            // read the INA219's current and power registers
+} PowerMeterScaling;
+
+typedef enum PowerMeterOutputFormat_enum {
+    pof_text,               // a line of text per report
+    pof_binary              // framed binary records (see PowerMeter.c)
+} PowerMeterOutputFormat;
+
+// all of the settings, as kept in EEPROM (see Settings.h)
+typedef struct PowerMeterSettings_struct {
+    uint16_t samplesPerSecond;
+    uint32_t reportIntervalMs;
+    uint8_t numChannels;
+    uint8_t sampleMode;             // PowerMeterSampleMode
+    uint8_t scaling;                // PowerMeterScaling
+    bool autoRange;
+    uint16_t shuntMilliOhms;
+    uint16_t maxCurrentMilliAmps;
+    int16_t adcBias;                // added to shunt voltage readings
+    uint8_t outputFormat;           // PowerMeterOutputFormat
+    bool rawStreaming;
+    bool backPressure;
+    uint16_t checkpointSeconds;
+} PowerMeterSettings;
+
+extern void PowerMeter_start (void);
+
+extern void PowerMeter_stop (void);
+
+extern void PowerMeter_reset (void);
+
+extern void PowerMeter_getSettings (
+    PowerMeterSettings *settings);
+
+extern void PowerMeter_defaultSettings (
+    PowerMeterSettings *settings);
+
+// checks the settings together, then uses them all. prints the reason
+// and returns false, leaving the settings as they were, if any can't be
+// used. changing the number of channels, or the units (see below),
+// resets the totals
+extern bool PowerMeter_applySettings (
+    const PowerMeterSettings *settings);
+
+// these take effect the next time sampling is started. they print the
+// reason and return false if the setting can't be used. the charge and
+// energy units depend on the sample rate, the scaling and the shunt, so
+// changing any of those resets the totals
+extern bool PowerMeter_setSampleMode (
+    const PowerMeterSampleMode mode);
+
+// sets the sample tick rate, and the INA219 shunt ADC resolution and
+// averaging, for the given number of samples per second
+extern bool PowerMeter_setSampleRate (
+    const uint16_t samplesPerSecond);
+
+// hardware scaling can only be used in conversion ready mode
+extern bool PowerMeter_setScaling (
+    const PowerMeterScaling scaling);
+
+// sets the shunt resistance, and the current that readings need to go
+// up to. these set the INA219 PGA gain and calibration
+extern bool PowerMeter_setShunt (
+    const uint16_t shuntMilliOhms,
+    const uint16_t maxExpectedMilliAmps);
+
+// with auto-ranging on, the PGA gain follows the readings, up to the
+// range set by PowerMeter_setShunt
+extern bool PowerMeter_setAutoRange (
+    const bool enable);
+
+// sets the number of INA219s to meter. the sample rate has to leave time
+// to read all of them each tick, and PowerMeter's channel pool has to
+// have room for their state
+extern bool PowerMeter_setNumChannels (
+    const uint8_t numChannels);
+
+// sets the time between reports, in mS. it can't be shorter than the
+// sample period
+extern bool PowerMeter_setReportInterval (
+    const uint32_t reportIntervalMs);
+
+// these measure the zero offset (with no current flowing) or the gain
+// (with knownMilliAmps flowing) of each PGA range of the first
+// CALIBRATION_MAX_CHANNELS channels, and save the corrections in EEPROM.
+// they need sampling running with firmware scaling, and take
+// CALIBRATION_SAMPLES samples per range
+extern bool PowerMeter_calibrateZero (void);
+
+extern bool PowerMeter_calibrateGain (
+    const uint16_t knownMilliAmps);
+
+// back to no corrections, and saves that
+extern bool PowerMeter_clearCalibration (void);
+
+// the totals are checkpointed to EEPROM this often while sampling, and
+// when sampling stops, and restored at power-up. 0 turns checkpoints off
+// and erases them. can be changed while sampling
+extern bool PowerMeter_setCheckpointInterval (
+    const uint16_t seconds);
+
+// with raw streaming on every sample is sent to the host, as well as the
+// reports
+extern bool PowerMeter_setRawStreaming (
+    const bool enable);
+
+// with back pressure on, reports that can't be sent straight away wait in
+// a short queue rather than being dropped. can be changed while sampling
+extern void PowerMeter_setBackPressure (
+    const bool enable);
+
+// binary also switches the Log messages to deferred (see Log.h). can be
+// changed while sampling
+extern void PowerMeter_setOutputFormat (
+    const PowerMeterOutputFormat format);
+
+// self-test: while sampling, fills the EEPROM scratch block (see EEPROM.h)
+// and, when the writes are done, logs how long they took and how many
+// samples were missed or overrun meanwhile. returns false if not
+// sampling or the EEPROM is busy
+extern bool PowerMeter_testEEPROM (void);
+
+// times the per-sample scaling arithmetic of firmware scaling (offset and
+// gain correction, and the power multiply) and of hardware scaling (the
+// chip's registers taken as they are) with interrupts off, and logs the
+// cycles per sample of each. needs sampling stopped
+extern void PowerMeter_benchmarkScaling (void);
+
+extern void PowerMeter_Initialize (void);
+
+extern void PowerMeter_task (void);
+
 #endif  // POWERMETER_H
\ No newline at end of file
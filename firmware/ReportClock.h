@@ -0,0 +1,69 @@
+//
+// Report Clock
+//
+//  What it does:
+//    Keeps the elapsed time in whole mS as ticks of a fixed number of
+//    timer counts go by. The counts that don't make a whole mS are
+//    carried from tick to tick, so the time never drifts whatever the
+//    tick length. Says when the time reaches a report time, so reports
+//    come on the first tick at or after each multiple of the report
+//    interval.
+//
+//  How to use it:
+//    Work out the tick length with ReportClock_setTick. On each tick,
+//    advance the time with ReportClock_addTick, and check it against
+//    the next report time with ReportClock_isDue. Both are cheap enough
+//    for an interrupt handler.
+//
+
+#ifndef REPORTCLOCK_H
+#define REPORTCLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct ReportTick_struct {
+    uint16_t ms;            // whole mS in a tick
+    uint16_t counts;        // and the counts left over
+    uint16_t countsPerMs;
+} ReportTick;
+
+// countsPerTick / countsPerMs must be less than 2^16
+inline void ReportClock_setTick (
+    const uint32_t countsPerTick,
+    const uint16_t countsPerMs,
+    ReportTick *tick)
+{
+    tick->ms = countsPerTick / countsPerMs;
+    tick->counts = countsPerTick % countsPerMs;
+    tick->countsPerMs = countsPerMs;
+}
+
+// returns the time, in mS, a tick after 'time'. countsRemainder carries
+// the counts that don't make a whole mS yet, and starts at 0. the time
+// wraps after about 24 days
+inline int32_t ReportClock_addTick (
+    const int32_t time,
+    const ReportTick *tick,
+    uint16_t *countsRemainder)
+{
+    uint32_t newTime = (uint32_t)time + tick->ms;
+    *countsRemainder += tick->counts;
+    if (*countsRemainder >= tick->countsPerMs) {
+        *countsRemainder -= tick->countsPerMs;
+        ++newTime;
+    }
+
+    return (int32_t)newTime;
+}
+
+// returns true if time has reached reportTime. correct across the wrap
+// as long as they're less than 2^31 mS apart
+inline bool ReportClock_isDue (
+    const int32_t time,
+    const int32_t reportTime)
+{
+    return (int32_t)((uint32_t)time - (uint32_t)reportTime) >= 0;
+}
+
+#endif  // REPORTCLOCK_H
@@ -0,0 +1,125 @@
+//
+// Sample Stream
+//
+
+#include "SampleStream.h"
+
+#include "BinaryFrame.h"
+
+#define HEADER_CHANNEL_SHIFT 4
+#define HEADER_TIME_FOLLOWS 0x08
+#define HEADER_WEIGHT_FOLLOWS 0x04
+#define MAX_SAMPLE_BYTES 9          // header, reading, weight, time
+
+static BinaryFrame batch;
+static bool batchHeld;              // full, waiting for room in USB buffer
+static uint16_t channelsInBatch;    // bit per channel sent in this batch
+static SampleStreamChannel *channels;
+static uint32_t nextSampleNumber;
+static uint32_t droppedSamples;
+
+// sends the held batch if there is room for it now. returns true if
+// there is no batch held any more
+static bool sendHeldBatch (void)
+{
+    if (batchHeld && BinaryFrame_fits(&batch)) {
+        BinaryFrame_send(SAMPLESTREAM_FRAME_TYPE, &batch);
+        BinaryFrame_clear(&batch);
+        batchHeld = false;
+    }
+
+    return !batchHeld;
+}
+
+void SampleStream_start (
+    SampleStreamChannel *channelsToUse)
+{
+    channels = channelsToUse;
+    BinaryFrame_clear(&batch);
+    batchHeld = false;
+    nextSampleNumber = 0;
+    droppedSamples = 0;
+}
+
+void SampleStream_add (
+    const uint8_t channel,
+    const int16_t reading,
+    const uint16_t weight,
+    const uint32_t time,
+    const bool followsGap,
+    const SampleStreamKind kind)
+{
+    if (!sendHeldBatch()) {
+        ++droppedSamples;
+        ++nextSampleNumber;
+        return;
+    }
+
+    if (batch.length == 0) {
+        BinaryFrame_appendU32(nextSampleNumber, &batch);
+        BinaryFrame_appendU32(droppedSamples, &batch);
+        channelsInBatch = 0;
+    }
+
+    SampleStreamChannel *last = &channels[channel];
+    const uint16_t channelBit = 1 << channel;
+    const bool channelSent = (channelsInBatch & channelBit) != 0;
+    uint8_t header = channel << HEADER_CHANNEL_SHIFT;
+    SampleStreamKind sentKind = kind;
+    const int16_t delta = reading - last->reading;
+    if ((kind == ssk_absolute) && channelSent &&
+        (delta >= INT8_MIN) && (delta <= INT8_MAX)) {
+        sentKind = ssk_delta;
+    }
+    header |= sentKind;
+    const bool sendWeight = !channelSent || (weight != last->weight);
+    if (sendWeight) {
+        header |= HEADER_WEIGHT_FOLLOWS;
+    }
+    const bool sendTime = !channelSent || followsGap;
+    if (sendTime) {
+        header |= HEADER_TIME_FOLLOWS;
+    }
+
+    BinaryFrame_appendU8(header, &batch);
+    if (sentKind == ssk_delta) {
+        BinaryFrame_appendU8((uint8_t)delta, &batch);
+    } else if (sentKind == ssk_absolute) {
+        BinaryFrame_appendU16((uint16_t)reading, &batch);
+    }
+    if (sendWeight) {
+        BinaryFrame_appendU16(weight, &batch);
+    }
+    if (sendTime) {
+        BinaryFrame_appendU32(time, &batch);
+    }
+    if ((sentKind == ssk_delta) || (sentKind == ssk_absolute)) {
+        last->reading = reading;
+    }
+    last->weight = weight;
+    channelsInBatch |= channelBit;
+    ++nextSampleNumber;
+
+    if ((batch.length + MAX_SAMPLE_BYTES) > BINARYFRAME_MAX_PAYLOAD) {
+        batchHeld = true;
+        sendHeldBatch();
+    }
+}
+
+void SampleStream_flush (void)
+{
+    if (!batchHeld && (batch.length > 0)) {
+        batchHeld = true;
+    }
+    sendHeldBatch();
+}
+
+void SampleStream_task (void)
+{
+    sendHeldBatch();
+}
+
+uint32_t SampleStream_droppedCount (void)
+{
+    return droppedSamples;
+}
@@ -0,0 +1,83 @@
+//
+// Sample Stream
+//
+//  What it does:
+//    Sends every sample to the USB host, delta-encoded and packed into
+//    batches of up to about 40 samples per BinaryFrame, so the USB
+//    overhead of each frame is shared between many samples.
+//    A batch that doesn't fit in the USB buffer is held and sent once it
+//    does. Samples that arrive while a batch is held can't be streamed;
+//    they are counted, and the count goes out with the next batch, so the
+//    host always knows exactly how many samples it didn't get.
+//
+//    Each batch (SAMPLESTREAM_FRAME_TYPE) holds:
+//      u32 number of the first sample in the batch (counting dropped ones)
+//      u32 samples dropped since streaming started
+//      then for each sample a header byte:
+//        bits 7-4  channel
+//        bit 3     a u32 time in uS (SystemTime_nowMicros) follows.
+//                  otherwise the time is the channel's last one plus
+//                  the weight
+//        bit 2     a u16 weight (see PowerMeter) follows. otherwise the
+//                  weight is the same as the channel's last one
+//        bits 1-0  ssk_* kind: a delta from the channel's last reading
+//                  (i8 follows), an absolute reading (i16 follows), or
+//                  an invalid or settling sample (no reading)
+//    The fields that follow the header are in the order reading, weight,
+//    time. Each batch starts afresh: the first reading, weight and time of
+//    each channel in a batch are sent in full. The time is also sent in
+//    full for a sample that follows lost samples of its channel.
+//
+//  How to use it:
+//    Call SampleStream_start when sampling starts, giving it a
+//    SampleStreamChannel for each channel, then SampleStream_add for
+//    each sample, and SampleStream_flush to send a partial batch (e.g. at
+//    the end of each report interval). Call SampleStream_task from the
+//    mainloop while streaming to send held batches.
+//
+
+#ifndef SAMPLESTREAM_H
+#define SAMPLESTREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SAMPLESTREAM_FRAME_TYPE 3
+
+typedef enum SampleStreamKind_enum {
+    ssk_delta,      // reading is within 127 of the last one
+    ssk_absolute,
+    ssk_invalid,    // the sample read failed
+    ssk_settling    // read while the PGA gain was changing
+} SampleStreamKind;
+
+// a channel's last reading and weight in the batch
+typedef struct SampleStreamChannel_struct {
+    int16_t reading;
+    uint16_t weight;
+} SampleStreamChannel;
+
+// channels must stay in place until sampling stops
+extern void SampleStream_start (
+    SampleStreamChannel *channels);
+
+// kind is ssk_invalid, ssk_settling, or ssk_absolute for a good reading
+// (it is sent as a delta when it can be)
+// followsGap is true if samples of the channel were lost since its last
+// one, so its time can't be worked out from the weights
+extern void SampleStream_add (
+    const uint8_t channel,
+    const int16_t reading,
+    const uint16_t weight,
+    const uint32_t time,
+    const bool followsGap,
+    const SampleStreamKind kind);
+
+extern void SampleStream_flush (void);
+
+extern void SampleStream_task (void);
+
+// samples that couldn't be streamed since SampleStream_start
+extern uint32_t SampleStream_droppedCount (void);
+
+#endif  // SAMPLESTREAM_H
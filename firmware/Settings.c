@@ -0,0 +1,285 @@
+//
+// Settings
+//
+
+#include "Settings.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <util/crc16.h>
+#include <avr/pgmspace.h>
+#include "EEPROM.h"
+#include "CharString.h"
+#include "StringUtils.h"
+#include "Console.h"
+
+typedef struct SettingsRecord_struct {
+    uint8_t version;
+    uint8_t length;                 // of settings
+    PowerMeterSettings settings;
+    uint16_t crc;
+} SettingsRecord;
+
+typedef enum SettingKind_enum {
+    sk_u8,
+    sk_u16,
+    sk_u32,
+    sk_i16,
+    sk_choice                       // u8 0 or 1, shown as a word
+} SettingKind;
+
+// where a setting is in PowerMeterSettings, and how to show it
+typedef struct SettingField_struct {
+    uint8_t offset;
+    uint8_t kind;                   // SettingKind
+    PGM_P choices[2];               // words for 0 and 1, for sk_choice
+} SettingField;
+
+static const char name_backpressure[] PROGMEM = "backpressure";
+static const char name_bias[] PROGMEM = "bias";
+static const char name_channels[] PROGMEM = "channels";
+static const char name_checkpoint[] PROGMEM = "checkpoint";
+static const char name_format[] PROGMEM = "format";
+static const char name_maxcurrent[] PROGMEM = "maxcurrent";
+static const char name_mode[] PROGMEM = "mode";
+static const char name_range[] PROGMEM = "range";
+static const char name_report[] PROGMEM = "report";
+static const char name_sample[] PROGMEM = "sample";
+static const char name_scale[] PROGMEM = "scale";
+static const char name_shunt[] PROGMEM = "shunt";
+static const char name_stream[] PROGMEM = "stream";
+
+static const char word_off[] PROGMEM = "off";
+static const char word_on[] PROGMEM = "on";
+static const char word_text[] PROGMEM = "text";
+static const char word_binary[] PROGMEM = "binary";
+static const char word_timed[] PROGMEM = "timed";
+static const char word_cnvr[] PROGMEM = "cnvr";
+static const char word_fixed[] PROGMEM = "fixed";
+static const char word_auto[] PROGMEM = "auto";
+static const char word_fw[] PROGMEM = "fw";
+static const char word_hw[] PROGMEM = "hw";
+
+// in alphabetical order, for StringUtils_lookupString. the names and
+// words are the same as the console commands that change them
+#define NUM_FIELDS 13
+static PGM_P const fieldNames[NUM_FIELDS] PROGMEM = {
+    name_backpressure, name_bias, name_channels, name_checkpoint,
+    name_format, name_maxcurrent, name_mode, name_range, name_report,
+    name_sample, name_scale, name_shunt, name_stream
+};
+static const SettingField fields[NUM_FIELDS] PROGMEM = {
+    {offsetof(PowerMeterSettings, backPressure), sk_choice, {word_off, word_on}},
+    {offsetof(PowerMeterSettings, adcBias), sk_i16, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, numChannels), sk_u8, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, checkpointSeconds), sk_u16, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, outputFormat), sk_choice, {word_text, word_binary}},
+    {offsetof(PowerMeterSettings, maxCurrentMilliAmps), sk_u16, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, sampleMode), sk_choice, {word_timed, word_cnvr}},
+    {offsetof(PowerMeterSettings, autoRange), sk_choice, {word_fixed, word_auto}},
+    {offsetof(PowerMeterSettings, reportIntervalMs), sk_u32, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, samplesPerSecond), sk_u16, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, scaling), sk_choice, {word_fw, word_hw}},
+    {offsetof(PowerMeterSettings, shuntMilliOhms), sk_u16, {NULL, NULL}},
+    {offsetof(PowerMeterSettings, rawStreaming), sk_choice, {word_off, word_on}}
+};
+
+static SettingsRecord saving;       // the record being written
+static volatile bool writing;
+static uint8_t printIndex = NUM_FIELDS;     // next field for printAll
+
+// CRC-16/CCITT of everything before the crc field
+static uint16_t recordCrc (
+    const SettingsRecord *record)
+{
+    const uint8_t *bp = (const uint8_t*)record;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t b = 0; b < offsetof(SettingsRecord, crc); ++b) {
+        crc = _crc_ccitt_update(crc, *bp++);
+    }
+    return crc;
+}
+
+static void writeCompletionHandler (
+    void *context)
+{
+    writing = false;
+}
+
+// returns the index of the named field, or NUM_FIELDS
+static uint8_t findField (
+    const char *name)
+{
+    CharString_define(16, nameStr);
+    CharString_copy(name, &nameStr);
+    return StringUtils_lookupString(&nameStr, (PGM_P*)fieldNames, NUM_FIELDS);
+}
+
+// appends "name value" for the field
+static void appendField (
+    const uint8_t index,
+    const PowerMeterSettings *settings,
+    CharString_t *str)
+{
+    SettingField field;
+    memcpy_P(&field, &fields[index], sizeof(SettingField));
+    const uint8_t *value = (const uint8_t*)settings + field.offset;
+
+    CharString_appendP((PGM_P)pgm_read_word(&fieldNames[index]), str);
+    CharString_appendC(' ', str);
+    switch (field.kind) {
+        case sk_u8 :
+            StringUtils_appendDecimal32(*value, 1, 0, str);
+            break;
+        case sk_u16 :
+            StringUtils_appendDecimal32(*(const uint16_t*)value, 1, 0, str);
+            break;
+        case sk_u32 :
+            StringUtils_appendDecimal32(*(const uint32_t*)value, 1, 0, str);
+            break;
+        case sk_i16 :
+            StringUtils_appendDecimal32(*(const int16_t*)value, 1, 0, str);
+            break;
+        case sk_choice :
+            CharString_appendP(field.choices[*value ? 1 : 0], str);
+            break;
+    }
+}
+
+bool Settings_load (
+    PowerMeterSettings *settings)
+{
+    SettingsRecord record;
+    EEPROM_readBlock(EEPROM_SETTINGS_ADDR, sizeof(SettingsRecord), &record);
+
+    const bool valid = (record.version == SETTINGS_VERSION) &&
+        (record.length == sizeof(PowerMeterSettings)) &&
+        (record.crc == recordCrc(&record));
+    if (valid) {
+        *settings = record.settings;
+    }
+
+    return valid;
+}
+
+bool Settings_save (
+    const PowerMeterSettings *settings)
+{
+    bool saved = false;
+
+    if (!writing) {
+        saving.version = SETTINGS_VERSION;
+        saving.length = sizeof(PowerMeterSettings);
+        saving.settings = *settings;
+        saving.crc = recordCrc(&saving);
+        writing = true;
+        saved = EEPROM_writeBlock(EEPROM_SETTINGS_ADDR, sizeof(SettingsRecord),
+            &saving, writeCompletionHandler, NULL);
+        if (!saved) {
+            writing = false;
+        }
+    }
+
+    return saved;
+}
+
+bool Settings_set (
+    const char *name,
+    const char *value,
+    PowerMeterSettings *settings)
+{
+    bool set = false;
+
+    const uint8_t index = findField(name);
+    if (index >= NUM_FIELDS) {
+        Console_printP(PSTR("unknown setting"));
+    } else {
+        SettingField field;
+        memcpy_P(&field, &fields[index], sizeof(SettingField));
+        uint8_t *dest = (uint8_t*)settings + field.offset;
+
+        if (field.kind == sk_choice) {
+            if (strcasecmp_P(value, field.choices[0]) == 0) {
+                *dest = 0;
+                set = true;
+            } else if (strcasecmp_P(value, field.choices[1]) == 0) {
+                *dest = 1;
+                set = true;
+            }
+        } else {
+            char *end;
+            const int32_t number = (field.kind == sk_i16)
+                ? strtol(value, &end, 10)
+                : (int32_t)strtoul(value, &end, 10);
+            if ((end != value) && (*end == 0)) {
+                switch (field.kind) {
+                    case sk_u8 :
+                        if ((number >= 0) && (number <= UINT8_MAX)) {
+                            *dest = number;
+                            set = true;
+                        }
+                        break;
+                    case sk_u16 :
+                        if ((number >= 0) && (number <= UINT16_MAX)) {
+                            *(uint16_t*)dest = number;
+                            set = true;
+                        }
+                        break;
+                    case sk_u32 :
+                        *(uint32_t*)dest = number;
+                        set = true;
+                        break;
+                    case sk_i16 :
+                        if ((number >= INT16_MIN) && (number <= INT16_MAX)) {
+                            *(int16_t*)dest = number;
+                            set = true;
+                        }
+                        break;
+                }
+            }
+        }
+        if (!set) {
+            Console_printP(PSTR("bad value"));
+        }
+    }
+
+    return set;
+}
+
+bool Settings_print (
+    const char *name,
+    const PowerMeterSettings *settings)
+{
+    const uint8_t index = findField(name);
+    if (index < NUM_FIELDS) {
+        CharString_define(30, line);
+        appendField(index, settings, &line);
+        Console_printCS(&line);
+    } else {
+        Console_printP(PSTR("unknown setting"));
+    }
+
+    return index < NUM_FIELDS;
+}
+
+void Settings_printAll (void)
+{
+    printIndex = 0;
+}
+
+void Settings_task (void)
+{
+    if (printIndex < NUM_FIELDS) {
+        PowerMeterSettings settings;
+        PowerMeter_getSettings(&settings);
+        while (printIndex < NUM_FIELDS) {
+            CharString_define(30, line);
+            appendField(printIndex, &settings, &line);
+            if (!Console_printPartCS(&line, true)) {
+                // the rest next time round
+                break;
+            }
+            ++printIndex;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+//
+// Settings
+//
+//  What it does:
+//    Keeps the PowerMeter settings in EEPROM, so the meter comes up in
+//    the configuration it was saved in. The record is:
+//
+//      u8 version  u8 length  PowerMeterSettings  CRC (2 bytes)
+//
+//    The CRC is CRC-16/CCITT over version, length and settings. A record
+//    with the wrong version or length, or a bad CRC, isn't used; the
+//    meter comes up with the defaults instead. SETTINGS_VERSION must go
+//    up whenever PowerMeterSettings changes.
+//    Also reads and prints single settings by name, for the console's
+//    config command.
+//
+//  How to use it:
+//    Settings_load reads the record at power-up. Settings_save writes a
+//    new one in the background (see EEPROM.h).
+//    Call Settings_task every iteration of the mainloop, to print the
+//    settings requested by Settings_printAll.
+//
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "PowerMeter.h"
+
+#define SETTINGS_VERSION 1
+
+// returns false if there are no good settings saved
+extern bool Settings_load (
+    PowerMeterSettings *settings);
+
+// returns false if the last save is still being written
+extern bool Settings_save (
+    const PowerMeterSettings *settings);
+
+// sets the named setting from its text value (a number, or a word such
+// as "on" or "cnvr"). prints the reason and returns false if the name
+// or the value isn't recognized
+extern bool Settings_set (
+    const char *name,
+    const char *value,
+    PowerMeterSettings *settings);
+
+// prints "name value" for the named setting. says so and returns false
+// if the name isn't recognized
+extern bool Settings_print (
+    const char *name,
+    const PowerMeterSettings *settings);
+
+// prints all of the current PowerMeter settings, a line at a time as
+// there is room in the USB buffer
+extern void Settings_printAll (void);
+
+extern void Settings_task (void);
+
+#endif  // SETTINGS_H
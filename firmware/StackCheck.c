@@ -0,0 +1,37 @@
+//
+// Stack Check
+//
+
+#include "StackCheck.h"
+
+#include <avr/io.h>
+
+#define FILL_BYTE 0xC5
+
+// the end of the static variables, from the linker. the stack grows
+// down towards it
+extern uint8_t __heap_start;
+
+// runs after the stack pointer is set up and before the static variables
+// are initialized, without a frame of its own, so it mustn't call
+// anything
+void StackCheck_fill (void) __attribute__ ((naked, used, section (".init3")));
+void StackCheck_fill (void)
+{
+    uint8_t *p = &__heap_start;
+    while (p < (uint8_t *)SP) {
+        *p++ = FILL_BYTE;
+    }
+}
+
+uint16_t StackCheck_unusedBytes (void)
+{
+    const uint8_t *p = &__heap_start;
+    uint16_t unused = 0;
+    while ((p < (const uint8_t *)SP) && (*p == FILL_BYTE)) {
+        ++p;
+        ++unused;
+    }
+
+    return unused;
+}
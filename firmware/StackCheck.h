@@ -0,0 +1,24 @@
+//
+// Stack Check
+//
+//  What it does:
+//    Fills the RAM between the static variables and the stack with a
+//    known byte before main runs, so that the part of it the stack has
+//    never reached can be counted later. That is the stack headroom the
+//    firmware has had so far.
+//
+//  How to use it:
+//    Just link it in; the fill runs by itself from .init3. Call
+//    StackCheck_unusedBytes once the firmware has been doing its worst
+//    for a while.
+//
+
+#ifndef STACKCHECK_H
+#define STACKCHECK_H
+
+#include <stdint.h>
+
+// returns the number of bytes below the stack that it has never used
+extern uint16_t StackCheck_unusedBytes (void);
+
+#endif  // STACKCHECK_H
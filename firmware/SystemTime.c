@@ -1,178 +1,270 @@
-//
-//  System Time
-//
-//  I/O Pin usage
-//      E6        time tick LED
-//
-//  Uses Timer/Counter 3
-//
-#include "SystemTime.h"
-
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <avr/wdt.h>
-#include "StringUtils.h"
-
-#define LED_PIN       PE6
-#define LED_OUTPORT   PORTE
-#define LED_DIR       DDRE
-
-static volatile uint16_t tickCounter = 0;
-static volatile SystemTime_t secondsSinceReset = 0;
-static bool shuttingDown = false;
-static SystemTime_TickNotification notificationFunction;
-
-void SystemTime_Initialize (void)
-{
-    // set LED pin to be an output
-    //LED_DIR |= (1 << LED_PIN); 
-
-    tickCounter = 0;
-    secondsSinceReset = 0;
-    notificationFunction = 0;
-
-    // set up timer3 to fire interrupt SYSTEMTIME_TICKS_PER_SECOND
-    TCCR3B = (TCCR3B & 0xF8) | 3; // prescale by 64
-    TCCR3B = (TCCR3B & 0xE7) | (1 << 3); // set CTC mode
-    OCR3A = (F_CPU / 64) / SYSTEMTIME_TICKS_PER_SECOND;
-    TCNT3 = 0;  // start the time counter at 0
-    TIFR3 |= (1 << OCF3A);  // "clear" the timer compare flag
-    TIMSK3 |= (1 << OCIE3A);// enable timer compare match interrupt
-}
-
-void SystemTime_registerForTickNotification (
-    SystemTime_TickNotification notificationFcn)
-{
-    notificationFunction = notificationFcn;
-}
-
-uint16_t currentTick (void)
-{
-    uint16_t tick;
-
-    char SREGSave = SREG;
-    cli();
-    tick = tickCounter;
-    SREG = SREGSave;
-
-    return tick;
-}
-
-void SystemTime_getCurrentTime (
-    SystemTime_t *curTime)
-{
-    // we disable interrupts during read of secondsSinceReset because
-    // it is updated in an interrupt handler
-    char SREGSave;
-    SREGSave = SREG;
-    cli();
-    *curTime = secondsSinceReset;
-    SREG = SREGSave;
-}
-
-void SystemTime_futureTime (
-    const int secondsFromNow,
-    SystemTime_t* futureTime)
-{
-    SystemTime_t currentTime;
-    SystemTime_getCurrentTime(&currentTime);
-    *futureTime = currentTime + (SystemTime_t)secondsFromNow;
-}
-
-bool SystemTime_timeHasArrived (
-    const SystemTime_t* time)
-{
-    bool timeHasArrived = false;
-
-    SystemTime_t currentTime;
-    SystemTime_getCurrentTime(&currentTime);
-    if (currentTime >= (*time)) {
-        timeHasArrived = true;
-    }
-    
-    return timeHasArrived;
-}
-
-void SystemTime_commenceShutdown (void)
-{
-    shuttingDown = true;
-    wdt_enable(WDTO_8S);
-}
-
-bool SystemTime_shuttingDown (void)
-{
-    return shuttingDown;
-}
-
-void SystemTime_task (void)
-{
-    // reset the watchdog timer
-    if (shuttingDown) {
-        LED_OUTPORT |= (1 << LED_PIN);
-    } else {
-        wdt_reset();
-
-        // blink the LED
-#if 0
-        const uint16_t blinkTime = SYSTEMTIME_TICKS_PER_SECOND / 2;
-        if (currentTick() < blinkTime) {
-            LED_OUTPORT |= (1 << LED_PIN);
-        } else {
-            LED_OUTPORT &= ~(1 << LED_PIN);
-        }
-#endif
-
-#if 0
-        // reboot daily at a predetermined time
-        const CellularComm_NetworkTime* currentTime =
-	        CellularComm_currentTime();
-        SystemTime_t currentTimeSeconds;
-        SystemTime_getCurrentTime(&currentTimeSeconds);
-        if (((currentTime->hour == REBOOT_HOUR) &&
-            (currentTime->minutes == REBOOT_MINUTES) &&
-            (currentTimeSeconds > 7200) &&	// running at least two hours
-            CellularComm_isIdle()) ||
-            (currentTimeSeconds > REBOOT_FULL_DAY)) {
-            SystemTime_commenceShutdown();
-        }
-#endif
-    }
-}
-
-void SystemTime_appendCurrentToString (
-    CharString_t* timeString)
-{
-
-    // get current time
-    SystemTime_t curTime;
-    SystemTime_getCurrentTime(&curTime);
-
-    // append hours
-    const uint8_t hours = curTime / 3600;
-    StringUtils_appendDecimal(hours, 2, 0, timeString);
-    CharString_appendP(PSTR(":"), timeString);
-
-    // append minutes
-    curTime = (curTime % 3600);
-    const uint8_t minutes =  curTime / 60;
-    StringUtils_appendDecimal(minutes, 2, 0, timeString);
-    CharString_appendP(PSTR(":"), timeString);
-
-    // append seconds
-    const uint8_t seconds = (curTime % 60);
-    StringUtils_appendDecimal(seconds, 2, 0, timeString);
-}
-
-ISR(TIMER3_COMPA_vect)
-{
-    ++tickCounter;
-    if (tickCounter >= SYSTEMTIME_TICKS_PER_SECOND) {
-        tickCounter = 0;
-        ++secondsSinceReset;
-    }
-
-    if (notificationFunction != NULL) {
-        notificationFunction();
-    }
-
-}
+//
+//  System Time
+//
+//  I/O Pin usage
+//      E6        time tick LED
+//
+//  Uses Timer/Counter 3 (compare A and overflow interrupts)
+//
+#include "SystemTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+#include "StringUtils.h"
+
+#define LED_PIN       PE6
+#define LED_OUTPORT   PORTE
+#define LED_DIR       DDRE
+
+static volatile uint16_t tickCounter = 0;
+static volatile SystemTime_Tick_t ticksSinceReset = 0;
+static volatile SystemTime_t secondsSinceReset = 0;
+static volatile uint32_t overflowCount = 0;  // of timer 3
+static uint32_t nextTickCount;              // timer 3 count of next tick
+static bool shuttingDown = false;
+static SystemTime_TickNotification notificationFunction;
+
+void SystemTime_Initialize (void)
+{
+    // set LED pin to be an output
+    //LED_DIR |= (1 << LED_PIN); 
+
+    tickCounter = 0;
+    ticksSinceReset = 0;
+    secondsSinceReset = 0;
+    notificationFunction = 0;
+
+    overflowCount = 0;
+
+    // set up timer3 to count freely, and to fire the compare A interrupt
+    // SYSTEMTIME_TICKS_PER_SECOND
+    TCCR3A = TCCR3A & 0xFC; // normal mode: counts from 0 to 0xFFFF
+    TCCR3B = TCCR3B & 0xE7;
+    TCCR3B = (TCCR3B & 0xF8) | (1 << CS31); // prescale by 8
+    nextTickCount = SYSTEMTIME_COUNTS_PER_TICK;
+    OCR3A = SYSTEMTIME_COUNTS_PER_TICK;
+    TCNT3 = 0;  // start the time counter at 0
+    TIFR3 = (1 << OCF3A) | (1 << TOV3);  // "clear" the timer flags
+    TIMSK3 |= (1 << OCIE3A) | (1 << TOIE3); // enable compare and overflow
+}
+
+void SystemTime_registerForTickNotification (
+    SystemTime_TickNotification notificationFcn)
+{
+    notificationFunction = notificationFcn;
+}
+
+uint16_t currentTick (void)
+{
+    uint16_t tick;
+
+    char SREGSave = SREG;
+    cli();
+    tick = tickCounter;
+    SREG = SREGSave;
+
+    return tick;
+}
+
+void SystemTime_getCurrentTime (
+    SystemTime_t *curTime)
+{
+    // we disable interrupts during read of secondsSinceReset because
+    // it is updated in an interrupt handler
+    char SREGSave;
+    SREGSave = SREG;
+    cli();
+    *curTime = secondsSinceReset;
+    SREG = SREGSave;
+}
+
+void SystemTime_futureTime (
+    const int secondsFromNow,
+    SystemTime_t* futureTime)
+{
+    SystemTime_t currentTime;
+    SystemTime_getCurrentTime(&currentTime);
+    *futureTime = currentTime + (SystemTime_t)secondsFromNow;
+}
+
+bool SystemTime_timeHasArrived (
+    const SystemTime_t* time)
+{
+    bool timeHasArrived = false;
+
+    SystemTime_t currentTime;
+    SystemTime_getCurrentTime(&currentTime);
+    if (currentTime >= (*time)) {
+        timeHasArrived = true;
+    }
+    
+    return timeHasArrived;
+}
+
+SystemTime_Tick_t SystemTime_currentTick (void)
+{
+    char SREGSave = SREG;
+    cli();
+    const SystemTime_Tick_t tick = ticksSinceReset;
+    SREG = SREGSave;
+
+    return tick;
+}
+
+void SystemTime_futureTick (
+    const uint16_t ticksFromNow,
+    SystemTime_Tick_t* futureTick)
+{
+    *futureTick = SystemTime_currentTick() + ticksFromNow + 1;
+}
+
+bool SystemTime_tickHasArrived (
+    const SystemTime_Tick_t* tick)
+{
+    // signed difference so that wraparound of the tick count is harmless
+    return ((int32_t)(SystemTime_currentTick() - (*tick))) >= 0;
+}
+
+// reads timer 3 and its overflow count. interrupts must be disabled
+static void readCounter (
+    uint32_t *overflows,
+    uint16_t *counts)
+{
+    *counts = TCNT3;
+    *overflows = overflowCount;
+    if ((TIFR3 & (1 << TOV3)) && (*counts < 0x8000)) {
+        // the counter has wrapped but the overflow interrupt hasn't run yet
+        ++(*overflows);
+    }
+}
+
+SystemTime_Micros_t SystemTime_nowMicros (void)
+{
+    uint32_t overflows;
+    uint16_t counts;
+    char SREGSave = SREG;
+    cli();
+    readCounter(&overflows, &counts);
+    SREG = SREGSave;
+
+    return (overflows << (16 - SYSTEMTIME_MICROS_SHIFT)) |
+        (counts >> SYSTEMTIME_MICROS_SHIFT);
+}
+
+uint32_t SystemTime_nowCounts (void)
+{
+    uint32_t overflows;
+    uint16_t counts;
+    char SREGSave = SREG;
+    cli();
+    readCounter(&overflows, &counts);
+    SREG = SREGSave;
+
+    return (overflows << 16) | counts;
+}
+
+bool SystemTime_countHasArrived (
+    const uint32_t count)
+{
+    // signed difference so that wraparound of the count is harmless
+    return ((int32_t)(SystemTime_nowCounts() - count)) >= 0;
+}
+
+void SystemTime_commenceShutdown (void)
+{
+    shuttingDown = true;
+    wdt_enable(WDTO_8S);
+}
+
+bool SystemTime_shuttingDown (void)
+{
+    return shuttingDown;
+}
+
+void SystemTime_task (void)
+{
+    // reset the watchdog timer
+    if (shuttingDown) {
+        LED_OUTPORT |= (1 << LED_PIN);
+    } else {
+        wdt_reset();
+
+        // blink the LED
+#if 0
+        const uint16_t blinkTime = SYSTEMTIME_TICKS_PER_SECOND / 2;
+        if (currentTick() < blinkTime) {
+            LED_OUTPORT |= (1 << LED_PIN);
+        } else {
+            LED_OUTPORT &= ~(1 << LED_PIN);
+        }
+#endif
+
+#if 0
+        // reboot daily at a predetermined time
+        const CellularComm_NetworkTime* currentTime =
+	        CellularComm_currentTime();
+        SystemTime_t currentTimeSeconds;
+        SystemTime_getCurrentTime(&currentTimeSeconds);
+        if (((currentTime->hour == REBOOT_HOUR) &&
+            (currentTime->minutes == REBOOT_MINUTES) &&
+            (currentTimeSeconds > 7200) &&	// running at least two hours
+            CellularComm_isIdle()) ||
+            (currentTimeSeconds > REBOOT_FULL_DAY)) {
+            SystemTime_commenceShutdown();
+        }
+#endif
+    }
+}
+
+void SystemTime_appendCurrentToString (
+    CharString_t* timeString)
+{
+
+    // get current time
+    SystemTime_t curTime;
+    SystemTime_getCurrentTime(&curTime);
+
+    // append hours
+    const uint8_t hours = curTime / 3600;
+    StringUtils_appendDecimal(hours, 2, 0, timeString);
+    CharString_appendP(PSTR(":"), timeString);
+
+    // append minutes
+    curTime = (curTime % 3600);
+    const uint8_t minutes =  curTime / 60;
+    StringUtils_appendDecimal(minutes, 2, 0, timeString);
+    CharString_appendP(PSTR(":"), timeString);
+
+    // append seconds
+    const uint8_t seconds = (curTime % 60);
+    StringUtils_appendDecimal(seconds, 2, 0, timeString);
+}
+
+ISR(TIMER3_COMPA_vect)
+{
+    // catches up on ticks that went by while interrupts were held off, and
+    // makes sure the next compare isn't set to a count that has already
+    // gone by
+    do {
+        while (SystemTime_countHasArrived(nextTickCount)) {
+            nextTickCount += SYSTEMTIME_COUNTS_PER_TICK;
+            ++ticksSinceReset;
+            ++tickCounter;
+            if (tickCounter >= SYSTEMTIME_TICKS_PER_SECOND) {
+                tickCounter = 0;
+                ++secondsSinceReset;
+            }
+
+            if (notificationFunction != NULL) {
+                notificationFunction();
+            }
+        }
+        OCR3A = (uint16_t)nextTickCount;
+    } while (SystemTime_countHasArrived(nextTickCount));
+}
+
+ISR(TIMER3_OVF_vect)
+{
+    ++overflowCount;
+}
@@ -1,53 +1,110 @@
-//
-//  SystemTime
-//
-//  Counts seconds since last reset
-//  Resets the watchdog timer
-//
-//  Uses AtMega32u4 16 bit timer 3
-//
-#ifndef SYSTEMTIME_H
-#define SYSTEMTIME_H
-
-#include <stdint.h>
-#include <stdbool.h>
-#include <string.h>
-#include <stddef.h>
-#include "CharString.h"
-
-#define SYSTEMTIME_TICKS_PER_SECOND 4800
-
-typedef unsigned long SystemTime_t;
-
-// prototype for functions that clients supply to
-// get notification when a tick occurs
-typedef void (*SystemTime_TickNotification)(void);
-
-extern void SystemTime_Initialize (void);
-
-extern void SystemTime_registerForTickNotification (
-    SystemTime_TickNotification notificationFcn);
-
-extern void SystemTime_getCurrentTime (
-    SystemTime_t *curTime);
-
-// initializes futureTime to the current time plus
-// the given number of seconds
-extern void SystemTime_futureTime (
-    const int secondsFromNow,
-    SystemTime_t* futureTime);
-
-// returns true if the current time is >= the given time
-extern bool SystemTime_timeHasArrived (
-    const SystemTime_t* time);
-
-extern void SystemTime_commenceShutdown (void);
-extern bool SystemTime_shuttingDown (void);
-
-extern void SystemTime_task (void);
-
-// writes current time as HH:MM:SS
-extern void SystemTime_appendCurrentToString (
-    CharString_t* timeString);
-
-#endif  // SYSTEMTIME_H
+//
+//  SystemTime
+//
+//  Counts seconds since last reset
+//  Keeps a microsecond clock
+//  Resets the watchdog timer
+//
+//  Uses AtMega32u4 16 bit timer 3, running free at F_CPU / 8. Its overflows
+//  are counted to extend it, which gives SystemTime_nowMicros. The system
+//  tick is the timer 3 compare A interrupt, each one moving the compare on
+//  by a tick's worth of counts. Compare B is left for PowerMeter's sample
+//  tick, which is timed the same way, so timer 1 is free.
+//
+#ifndef SYSTEMTIME_H
+#define SYSTEMTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "CharString.h"
+
+#define SYSTEMTIME_TICKS_PER_SECOND 5000
+
+// timer 3 counts
+#define SYSTEMTIME_COUNTS_PER_SECOND (F_CPU / 8)
+#define SYSTEMTIME_COUNTS_PER_TICK \
+    (SYSTEMTIME_COUNTS_PER_SECOND / SYSTEMTIME_TICKS_PER_SECOND)
+// a microsecond is 2^SYSTEMTIME_MICROS_SHIFT counts
+#if F_CPU == 16000000UL
+#define SYSTEMTIME_MICROS_SHIFT 1
+#elif F_CPU == 8000000UL
+#define SYSTEMTIME_MICROS_SHIFT 0
+#else
+#error "SystemTime needs F_CPU of 8 or 16MHz"
+#endif
+
+typedef unsigned long SystemTime_t;
+
+// time in ticks since last reset. wraps around after about 10 days, so
+// deadlines must be less than half of that in the future
+typedef uint32_t SystemTime_Tick_t;
+
+// time in microseconds since last reset. wraps around after about 71
+// minutes, so intervals must be worked out with unsigned subtraction
+typedef uint32_t SystemTime_Micros_t;
+
+// number of ticks needed to cover the given number of microseconds.
+// evaluated at compile time when given a constant
+#define SYSTEMTIME_MICROS_TO_TICKS(micros) \
+    ((uint16_t)((((uint32_t)(micros) * (SYSTEMTIME_TICKS_PER_SECOND / 100)) + 9999UL) / 10000UL))
+
+// prototype for functions that clients supply to
+// get notification when a tick occurs
+typedef void (*SystemTime_TickNotification)(void);
+
+extern void SystemTime_Initialize (void);
+
+extern void SystemTime_registerForTickNotification (
+    SystemTime_TickNotification notificationFcn);
+
+extern void SystemTime_getCurrentTime (
+    SystemTime_t *curTime);
+
+// initializes futureTime to the current time plus
+// the given number of seconds
+extern void SystemTime_futureTime (
+    const int secondsFromNow,
+    SystemTime_t* futureTime);
+
+// returns true if the current time is >= the given time
+extern bool SystemTime_timeHasArrived (
+    const SystemTime_t* time);
+
+extern SystemTime_Tick_t SystemTime_currentTick (void);
+
+// initializes futureTick to the current tick plus the given number of
+// ticks, plus one to make up for the part of the current tick that has
+// already gone by. may be called from an interrupt handler
+extern void SystemTime_futureTick (
+    const uint16_t ticksFromNow,
+    SystemTime_Tick_t* futureTick);
+
+// returns true if the current tick is at or past the given tick
+extern bool SystemTime_tickHasArrived (
+    const SystemTime_Tick_t* tick);
+
+// returns the time in microseconds since last reset. may be called from an
+// interrupt handler
+extern SystemTime_Micros_t SystemTime_nowMicros (void);
+
+// returns the timer 3 counts since last reset, modulo 2^32 (about 36
+// minutes). may be called from an interrupt handler
+extern uint32_t SystemTime_nowCounts (void);
+
+// returns true if the count (from SystemTime_nowCounts) is now or past.
+// may be called from an interrupt handler
+extern bool SystemTime_countHasArrived (
+    const uint32_t count);
+
+extern void SystemTime_commenceShutdown (void);
+extern bool SystemTime_shuttingDown (void);
+
+extern void SystemTime_task (void);
+
+// writes current time as HH:MM:SS
+extern void SystemTime_appendCurrentToString (
+    CharString_t* timeString);
+
+#endif  // SYSTEMTIME_H
@@ -1,251 +1,380 @@
-/*
-             LUFA Library
-     Copyright (C) Dean Camera, 2012.
-
-  dean [at] fourwalledcubicle [dot] com
-           www.lufa-lib.org
-*/
-
-/*
-  Copyright 2012  Dean Camera (dean [at] fourwalledcubicle [dot] com)
-
-  Permission to use, copy, modify, distribute, and sell this
-  software and its documentation for any purpose is hereby granted
-  without fee, provided that the above copyright notice appear in
-  all copies and that both that the copyright notice and this
-  permission notice and warranty disclaimer appear in supporting
-  documentation, and that the name of the author not be used in
-  advertising or publicity pertaining to distribution of the
-  software without specific, written prior permission.
-
-  The author disclaim all warranties with regard to this
-  software, including all implied warranties of merchantability
-  and fitness.  In no event shall the author be liable for any
-  special, indirect or consequential damages or any damages
-  whatsoever resulting from loss of use, data or profits, whether
-  in an action of contract, negligence or other tortious action,
-  arising out of or in connection with the use or performance of
-  this software.
-*/
-
-/** \file
- *
- *  Main source file for the USBtoSerial project. This file contains the main tasks of
- *  the project and is responsible for the initial application hardware configuration.
- */
-
-#include "USBTerminal.h"
-
-const prog_char crlfP[] = {13,10,0};
-
-/** Circular buffer to hold data from the host before it is sent to the device via the serial port. */
-ByteQueue_define(32, FromUSB_Buffer)
-
-/** Circular buffer to hold data from the serial port before it is sent to the host. */
-ByteQueue_define(150, ToUSB_Buffer)
-
-static bool USBConnected = false;
-
-/** LUFA CDC Class driver interface configuration and state information. This structure is
- *  passed to all CDC Class driver functions, so that multiple instances of the same class
- *  within a device can be differentiated from one another.
- */
-USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
-	{
-		.Config =
-			{
-				.ControlInterfaceNumber         = INTERFACE_ID_CDC_CCI,
-				.DataINEndpoint                 =
-					{
-						.Address                = CDC_TX_EPADDR,
-						.Size                   = CDC_TXRX_EPSIZE,
-						.Banks                  = 1,
-					},
-				.DataOUTEndpoint                =
-					{
-						.Address                = CDC_RX_EPADDR,
-						.Size                   = CDC_TXRX_EPSIZE,
-						.Banks                  = 1,
-					},
-				.NotificationEndpoint           =
-					{
-						.Address                = CDC_NOTIFICATION_EPADDR,
-						.Size                   = CDC_NOTIFICATION_EPSIZE,
-						.Banks                  = 1,
-					},
-			},
-	};
-
-void USBTerminal_sendCharsToHost (
-    const char* text)
-{
-    // if the ring buffer fills up we simply drop the rest of the text
-    const char* cp = text;
-    while ((*cp != 0) && !ByteQueue_is_full(&ToUSB_Buffer)) {
-        ByteQueue_push(*cp++, &ToUSB_Buffer);
-    }
-}
-
-void USBTerminal_sendCharsToHostP (
-    PGM_P text)
-{
-    // if the ring buffer fills up we simply drop the rest of the text
-    PGM_P cp = text;
-	char ch = 0;
-	do {
-		ch = pgm_read_byte(cp);
-		++cp;
-		if ((ch != 0) && !ByteQueue_is_full(&ToUSB_Buffer)) {
-			ByteQueue_push(ch, &ToUSB_Buffer);
-		}
-    } while (ch != 0);
-}
-
-void USBTerminal_sendLineToHost (
-    const char* text)
-{
-	USBTerminal_sendCharsToHost(text);
-	USBTerminal_sendCharsToHostP(crlfP);
-}
-
-void USBTerminal_sendLineToHostP (
-    PGM_P text)
-{
-	USBTerminal_sendCharsToHostP(text);
-	USBTerminal_sendCharsToHostP(crlfP);
-}
-
-void USBTerminal_task (void)
-{
-
-    /* Only try to read in bytes from the CDC interface if the transmit buffer is not full */
-    if (!(ByteQueue_is_full(&FromUSB_Buffer))) {
-	int16_t ReceivedByte = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
-
-	/* Read bytes from the USB OUT endpoint into the USART transmit buffer */
-	if (!(ReceivedByte < 0)) {
-	    ByteQueue_push(ReceivedByte, &FromUSB_Buffer);
-        }
-    }
-
-    /* Check if there is any data in the ToUSB buffer */
-    uint16_t BufferCount = ByteQueue_length(&ToUSB_Buffer);
-    if (BufferCount > 0) {
-        Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataINEndpoint.Address);
-
-        /* Check if a packet is already enqueued to the host - if so, we shouldn't try to send more data
-	    * until it completes as there is a chance nothing is listening and a lengthy timeout could occur */
-        if (Endpoint_IsINReady())
-        {
-            /* Never send more than one bank size less one byte to the host at a time, so that we don't block
-	        * while a Zero Length Packet (ZLP) to terminate the transfer is sent if the host isn't listening */
-            uint8_t BytesToSend = MIN(BufferCount, (CDC_TXRX_EPSIZE - 1));
-
-            /* Read bytes from the USART receive buffer into the USB IN endpoint */
-            while (BytesToSend--) {
-                /* Try to send the next byte of data to the host, abort if there is an error without dequeuing */
-                if (CDC_Device_SendByte(&VirtualSerial_CDC_Interface,
-                        ByteQueue_head(&ToUSB_Buffer)) != ENDPOINT_READYWAIT_NoError) {
-                    break;
-                }
-
-                /* Dequeue the already sent byte from the buffer now we have confirmed that no transmission error occurred */
-                ByteQueue_pop(&ToUSB_Buffer);
-            }
-        }
-    }
-
-    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
-    USB_USBTask();
-}
-
-/** Configures the board hardware and chip peripherals for the demo's functionality. */
-void USBTerminal_Initialize (void)
-{
-    ByteQueue_clear(&FromUSB_Buffer);
-    ByteQueue_clear(&ToUSB_Buffer);
-
-    USB_Init();
-}
-
-bool USBTerminal_isConnected (void)
-{
-	return USBConnected;
-}
-
-/** Event handler for the library USB Connection event. */
-void EVENT_USB_Device_Connect(void)
-{
-	USBConnected = true;
-}
-
-/** Event handler for the library USB Disconnection event. */
-void EVENT_USB_Device_Disconnect(void)
-{
-	USBConnected = false;
-}
-
-/** Event handler for the library USB Configuration Changed event. */
-void EVENT_USB_Device_ConfigurationChanged(void)
-{
-    bool ConfigSuccess = true;
-
-    ConfigSuccess &= CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface);
-}
-
-/** Event handler for the library USB Control Request reception event. */
-void EVENT_USB_Device_ControlRequest(void)
-{
-    CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
-}
-
-/** Event handler for the CDC Class driver Line Encoding Changed event.
- *
- *  \param[in] CDCInterfaceInfo  Pointer to the CDC class interface configuration structure being referenced
- */
-void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo)
-{
-    // don't change the UART settings. We are using the UART to talk to the
-    // cellular module at 115200 8N1
-#if 0
-    uint8_t ConfigMask = 0;
-
-    switch (CDCInterfaceInfo->State.LineEncoding.ParityType) {
-	case CDC_PARITY_Odd:
-	    ConfigMask = ((1 << UPM11) | (1 << UPM10));
-	    break;
-	case CDC_PARITY_Even:
-	    ConfigMask = (1 << UPM11);
-	    break;
-	}
-
-	if (CDCInterfaceInfo->State.LineEncoding.CharFormat == CDC_LINEENCODING_TwoStopBits)
-	  ConfigMask |= (1 << USBS1);
-
-	switch (CDCInterfaceInfo->State.LineEncoding.DataBits) {
-	    case 6:
-	        ConfigMask |= (1 << UCSZ10);
-	        break;
-	    case 7:
-		ConfigMask |= (1 << UCSZ11);
-		break;
-	    case 8:
-		ConfigMask |= ((1 << UCSZ11) | (1 << UCSZ10));
-		break;
-	}
-
-	/* Must turn off USART before reconfiguring it, otherwise incorrect operation may occur */
-	UCSR1B = 0;
-	UCSR1A = 0;
-	UCSR1C = 0;
-
-	/* Set the new baud rate before configuring the USART */
-	UBRR1  = SERIAL_2X_UBBRVAL(CDCInterfaceInfo->State.LineEncoding.BaudRateBPS);
-
-	/* Reconfigure the USART in double speed mode for a wider baud rate range at the expense of accuracy */
-	UCSR1C = ConfigMask;
-	UCSR1A = (1 << U2X1);
-	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
-#endif
-}
-
+/*
+             LUFA Library
+     Copyright (C) Dean Camera, 2012.
+
+  dean [at] fourwalledcubicle [dot] com
+           www.lufa-lib.org
+*/
+
+/*
+  Copyright 2012  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *
+ *  Main source file for the USBtoSerial project. This file contains the main tasks of
+ *  the project and is responsible for the initial application hardware configuration.
+ */
+
+#include "USBTerminal.h"
+
+#include "SystemTime.h"
+
+// longest time a partly filled packet waits for more bytes before it is
+// sent to the host
+#define TX_FLUSH_MICROS 2000
+
+/** Circular buffer to hold data from the host before it is sent to the device via the serial port. */
+ByteRing_define(32, FromUSB_Buffer)
+
+/** Circular buffer to hold data from the serial port before it is sent to the host. */
+ByteRing_define(128, ToUSB_Buffer)
+
+static bool USBConnected = false;
+static bool lineIsOpen = false;         // sendLinePartToHost started a line
+static uint16_t droppedLines = 0;
+static bool lastPacketWasFull = false;  // the host waits for a short one
+static SystemTime_Tick_t flushTick;     // when to send a partly filled packet
+static uint32_t bytesToHost = 0;
+static uint32_t packetsToHost = 0;
+
+/** LUFA CDC Class driver interface configuration and state information. This structure is
+ *  passed to all CDC Class driver functions, so that multiple instances of the same class
+ *  within a device can be differentiated from one another.
+ */
+USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface =
+	{
+		.Config =
+			{
+				.ControlInterfaceNumber         = INTERFACE_ID_CDC_CCI,
+				.DataINEndpoint                 =
+					{
+						.Address                = CDC_TX_EPADDR,
+						.Size                   = CDC_TXRX_EPSIZE,
+						.Banks                  = 2,
+					},
+				.DataOUTEndpoint                =
+					{
+						.Address                = CDC_RX_EPADDR,
+						.Size                   = CDC_TXRX_EPSIZE,
+						.Banks                  = 2,
+					},
+				.NotificationEndpoint           =
+					{
+						.Address                = CDC_NOTIFICATION_EPADDR,
+						.Size                   = CDC_NOTIFICATION_EPSIZE,
+						.Banks                  = 1,
+					},
+			},
+	};
+
+void USBTerminal_sendCharsToHost (
+    const char* text)
+{
+    if (lineIsOpen) {
+        // would land in the middle of the line
+        return;
+    }
+    // if the ring buffer fills up we simply drop the rest of the text
+    const size_t length = strlen(text);
+    ByteRing_pushSpan((const uint8_t*)text, MIN(length, UINT8_MAX), &ToUSB_Buffer);
+}
+
+void USBTerminal_sendCharsToHostP (
+    PGM_P text)
+{
+    if (lineIsOpen) {
+        return;
+    }
+    // if the ring buffer fills up we simply drop the rest of the text
+    PGM_P cp = text;
+	char ch = 0;
+	do {
+		ch = pgm_read_byte(cp);
+		++cp;
+		if (ch != 0) {
+			ByteRing_push(ch, &ToUSB_Buffer);
+		}
+    } while (ch != 0);
+}
+
+// sends text, followed by CR LF if it ends a line, if there is room for
+// all of it. returns true if it was sent. only the mainloop pushes to the
+// buffer, so the space can only grow between checking it and pushing
+static bool sendText (
+    const char* text,
+    const bool isInProgmem,
+    const bool endsLine)
+{
+    const size_t length = isInProgmem ? strlen_P(text) : strlen(text);
+    const size_t lineEndLength = endsLine ? 2 : 0;
+    if (ByteRing_spaceRemaining(&ToUSB_Buffer) < (length + lineEndLength)) {
+        return false;
+    }
+
+    if (isInProgmem) {
+        for (PGM_P cp = text; cp < (text + length); ++cp) {
+            ByteRing_push(pgm_read_byte(cp), &ToUSB_Buffer);
+        }
+    } else {
+        ByteRing_pushSpan((const uint8_t*)text, length, &ToUSB_Buffer);
+    }
+    if (endsLine) {
+        ByteRing_push(13, &ToUSB_Buffer);
+        ByteRing_push(10, &ToUSB_Buffer);
+    }
+
+    return true;
+}
+
+static bool sendLine (
+    const char* text,
+    const bool isInProgmem)
+{
+    if (lineIsOpen || !sendText(text, isInProgmem, true)) {
+        ++droppedLines;
+        return false;
+    }
+
+    return true;
+}
+
+bool USBTerminal_sendLineToHost (
+    const char* text)
+{
+    return sendLine(text, false);
+}
+
+bool USBTerminal_sendLineToHostP (
+    PGM_P text)
+{
+    return sendLine(text, true);
+}
+
+bool USBTerminal_sendLinePartToHost (
+    const char* text,
+    const bool endsLine)
+{
+    if (!sendText(text, false, endsLine)) {
+        return false;
+    }
+    lineIsOpen = !endsLine;
+
+    return true;
+}
+
+uint16_t USBTerminal_droppedLines (void)
+{
+    return droppedLines;
+}
+
+bool USBTerminal_lineIsOpen (void)
+{
+    return lineIsOpen;
+}
+
+bool USBTerminal_sendBytesToHost (
+    const uint8_t* bytes,
+    const uint8_t length)
+{
+    // only the mainloop pushes to the buffer, so the space can only grow
+    // between checking it and pushing
+    if (lineIsOpen ||
+        (ByteRing_spaceRemaining(&ToUSB_Buffer) < length)) {
+        return false;
+    }
+    ByteRing_pushSpan(bytes, length, &ToUSB_Buffer);
+
+    return true;
+}
+
+// sends a packet to the host from the bank being filled
+static void sendPacket (void)
+{
+    lastPacketWasFull = !Endpoint_IsReadWriteAllowed();
+    Endpoint_ClearIN();
+    ++packetsToHost;
+}
+
+// moves bytes from ToUSB_Buffer into the IN endpoint a contiguous span
+// at a time. a bank goes to the host as soon as it is full, and a partly
+// filled one after it has waited TX_FLUSH_MICROS for more bytes. with two
+// banks, one can be filled while the other is being sent
+static void sendToHost (void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) {
+        return;
+    }
+
+    Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataINEndpoint.Address);
+    const uint8_t *span;
+    uint8_t spanLength;
+    while (Endpoint_IsINReady() &&
+        ((spanLength = ByteRing_peekContiguous(&span, &ToUSB_Buffer)) > 0)) {
+        const uint8_t bytesInBank = Endpoint_BytesInEndpoint();
+        if (bytesInBank == 0) {
+            SystemTime_futureTick(
+                SYSTEMTIME_MICROS_TO_TICKS(TX_FLUSH_MICROS), &flushTick);
+        }
+        const uint8_t bytesToSend =
+            MIN(spanLength, (uint8_t)(CDC_TXRX_EPSIZE - bytesInBank));
+        // never has to wait, because it fits in the bank
+        Endpoint_Write_Stream_LE(span, bytesToSend, NULL);
+        ByteRing_drop(bytesToSend, &ToUSB_Buffer);
+        bytesToHost += bytesToSend;
+        if (!Endpoint_IsReadWriteAllowed()) {
+            // bank full
+            sendPacket();
+        }
+    }
+
+    if (Endpoint_IsINReady()) {
+        if (Endpoint_BytesInEndpoint() > 0) {
+            if (SystemTime_tickHasArrived(&flushTick)) {
+                sendPacket();
+            }
+        } else if (lastPacketWasFull && ByteRing_isEmpty(&ToUSB_Buffer)) {
+            // a zero length packet ends the transfer, so the host doesn't
+            // hold on to the full packets waiting for more
+            sendPacket();
+        }
+    }
+}
+
+void USBTerminal_task (void)
+{
+
+    /* Only try to read in bytes from the CDC interface if the transmit buffer is not full */
+    if (!(ByteRing_isFull(&FromUSB_Buffer))) {
+	int16_t ReceivedByte = CDC_Device_ReceiveByte(&VirtualSerial_CDC_Interface);
+
+	/* Read bytes from the USB OUT endpoint into the USART transmit buffer */
+	if (!(ReceivedByte < 0)) {
+	    ByteRing_push(ReceivedByte, &FromUSB_Buffer);
+        }
+    }
+
+    sendToHost();
+
+    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
+    USB_USBTask();
+}
+
+/** Configures the board hardware and chip peripherals for the demo's functionality. */
+void USBTerminal_Initialize (void)
+{
+    ByteRing_clear(&FromUSB_Buffer);
+    ByteRing_clear(&ToUSB_Buffer);
+
+    USB_Init();
+}
+
+uint32_t USBTerminal_bytesToHost (void)
+{
+    return bytesToHost;
+}
+
+uint32_t USBTerminal_packetsToHost (void)
+{
+    return packetsToHost;
+}
+
+bool USBTerminal_isConnected (void)
+{
+	return USBConnected;
+}
+
+/** Event handler for the library USB Connection event. */
+void EVENT_USB_Device_Connect(void)
+{
+	USBConnected = true;
+}
+
+/** Event handler for the library USB Disconnection event. */
+void EVENT_USB_Device_Disconnect(void)
+{
+	USBConnected = false;
+}
+
+/** Event handler for the library USB Configuration Changed event. */
+void EVENT_USB_Device_ConfigurationChanged(void)
+{
+    bool ConfigSuccess = true;
+
+    ConfigSuccess &= CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface);
+}
+
+/** Event handler for the library USB Control Request reception event. */
+void EVENT_USB_Device_ControlRequest(void)
+{
+    CDC_Device_ProcessControlRequest(&VirtualSerial_CDC_Interface);
+}
+
+/** Event handler for the CDC Class driver Line Encoding Changed event.
+ *
+ *  \param[in] CDCInterfaceInfo  Pointer to the CDC class interface configuration structure being referenced
+ */
+void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo)
+{
+    // don't change the UART settings. We are using the UART to talk to the
+    // cellular module at 115200 8N1
+#if 0
+    uint8_t ConfigMask = 0;
+
+    switch (CDCInterfaceInfo->State.LineEncoding.ParityType) {
+	case CDC_PARITY_Odd:
+	    ConfigMask = ((1 << UPM11) | (1 << UPM10));
+	    break;
+	case CDC_PARITY_Even:
+	    ConfigMask = (1 << UPM11);
+	    break;
+	}
+
+	if (CDCInterfaceInfo->State.LineEncoding.CharFormat == CDC_LINEENCODING_TwoStopBits)
+	  ConfigMask |= (1 << USBS1);
+
+	switch (CDCInterfaceInfo->State.LineEncoding.DataBits) {
+	    case 6:
+	        ConfigMask |= (1 << UCSZ10);
+	        break;
+	    case 7:
+		ConfigMask |= (1 << UCSZ11);
+		break;
+	    case 8:
+		ConfigMask |= ((1 << UCSZ11) | (1 << UCSZ10));
+		break;
+	}
+
+	/* Must turn off USART before reconfiguring it, otherwise incorrect operation may occur */
+	UCSR1B = 0;
+	UCSR1A = 0;
+	UCSR1C = 0;
+
+	/* Set the new baud rate before configuring the USART */
+	UBRR1  = SERIAL_2X_UBBRVAL(CDCInterfaceInfo->State.LineEncoding.BaudRateBPS);
+
+	/* Reconfigure the USART in double speed mode for a wider baud rate range at the expense of accuracy */
+	UCSR1C = ConfigMask;
+	UCSR1A = (1 << U2X1);
+	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
+#endif
+}
+
@@ -1,86 +1,118 @@
-/*
-             LUFA Library
-     Copyright (C) Dean Camera, 2012.
-
-  dean [at] fourwalledcubicle [dot] com
-           www.lufa-lib.org
-*/
-
-/*
-  Copyright 2012  Dean Camera (dean [at] fourwalledcubicle [dot] com)
-
-  Permission to use, copy, modify, distribute, and sell this
-  software and its documentation for any purpose is hereby granted
-  without fee, provided that the above copyright notice appear in
-  all copies and that both that the copyright notice and this
-  permission notice and warranty disclaimer appear in supporting
-  documentation, and that the name of the author not be used in
-  advertising or publicity pertaining to distribution of the
-  software without specific, written prior permission.
-
-  The author disclaim all warranties with regard to this
-  software, including all implied warranties of merchantability
-  and fitness.  In no event shall the author be liable for any
-  special, indirect or consequential damages or any damages
-  whatsoever resulting from loss of use, data or profits, whether
-  in an action of contract, negligence or other tortious action,
-  arising out of or in connection with the use or performance of
-  this software.
-*/
-
-/** \file
- *
- *  Header file for USBtoSerial.c.
- */
-
-#ifndef _USBTERMINAL_H_
-#define _USBTERMINAL_H_
-
-    /* Includes: */
-        #include <avr/io.h>
-        #include <avr/wdt.h>
-        #include <avr/interrupt.h>
-        #include <avr/power.h>
-        #include <avr/pgmspace.h>
-
-        #include "Descriptors.h"
-
-        #include <LUFA/Version.h>
-        #include <LUFA/Drivers/Peripheral/Serial.h>
-        #include <LUFA/Drivers/USB/USB.h>
-        #include "CharString.h"
-        #include "ByteQueue.h"
-
-        extern ByteQueue FromUSB_Buffer;
-        extern ByteQueue ToUSB_Buffer;
-
-    /* Function Prototypes: */
-        void USBTerminal_sendCharsToHost (
-            const char* text);
-        void USBTerminal_sendCharsToHostP (
-            PGM_P text);
-        inline void USBTerminal_sendCharsToHostCS (
-            const CharString_t *text)
-            { USBTerminal_sendCharsToHost(CharString_cstr(text)); }
-
-        void USBTerminal_sendLineToHost (
-            const char* text);
-        void USBTerminal_sendLineToHostP (
-            PGM_P text);
-        inline void USBTerminal_sendLineToHostCS (
-            const CharString_t *text)
-            { USBTerminal_sendLineToHost(CharString_cstr(text)); }
-
-        void USBTerminal_task(void);
-        void USBTerminal_Initialize (void);
-        bool USBTerminal_isConnected (void);
-
-        void EVENT_USB_Device_Connect(void);
-        void EVENT_USB_Device_Disconnect(void);
-        void EVENT_USB_Device_ConfigurationChanged(void);
-        void EVENT_USB_Device_ControlRequest(void);
-
-        void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
-
-#endif
-
+/*
+             LUFA Library
+     Copyright (C) Dean Camera, 2012.
+
+  dean [at] fourwalledcubicle [dot] com
+           www.lufa-lib.org
+*/
+
+/*
+  Copyright 2012  Dean Camera (dean [at] fourwalledcubicle [dot] com)
+
+  Permission to use, copy, modify, distribute, and sell this
+  software and its documentation for any purpose is hereby granted
+  without fee, provided that the above copyright notice appear in
+  all copies and that both that the copyright notice and this
+  permission notice and warranty disclaimer appear in supporting
+  documentation, and that the name of the author not be used in
+  advertising or publicity pertaining to distribution of the
+  software without specific, written prior permission.
+
+  The author disclaim all warranties with regard to this
+  software, including all implied warranties of merchantability
+  and fitness.  In no event shall the author be liable for any
+  special, indirect or consequential damages or any damages
+  whatsoever resulting from loss of use, data or profits, whether
+  in an action of contract, negligence or other tortious action,
+  arising out of or in connection with the use or performance of
+  this software.
+*/
+
+/** \file
+ *
+ *  Header file for USBtoSerial.c.
+ */
+
+#ifndef _USBTERMINAL_H_
+#define _USBTERMINAL_H_
+
+    /* Includes: */
+        #include <avr/io.h>
+        #include <avr/wdt.h>
+        #include <avr/interrupt.h>
+        #include <avr/power.h>
+        #include <avr/pgmspace.h>
+
+        #include "Descriptors.h"
+
+        #include <LUFA/Version.h>
+        #include <LUFA/Drivers/Peripheral/Serial.h>
+        #include <LUFA/Drivers/USB/USB.h>
+        #include "CharString.h"
+        #include "ByteRing.h"
+
+        extern ByteRing FromUSB_Buffer;
+        extern ByteRing ToUSB_Buffer;
+
+    /* Function Prototypes: */
+        void USBTerminal_sendCharsToHost (
+            const char* text);
+        void USBTerminal_sendCharsToHostP (
+            PGM_P text);
+        inline void USBTerminal_sendCharsToHostCS (
+            const CharString_t *text)
+            { USBTerminal_sendCharsToHost(CharString_cstr(text)); }
+
+        // these send the whole line, or none of it if it doesn't fit in
+        // the buffer or another line is still being sent in parts. they
+        // return true if it was sent
+        bool USBTerminal_sendLineToHost (
+            const char* text);
+        bool USBTerminal_sendLineToHostP (
+            PGM_P text);
+        inline bool USBTerminal_sendLineToHostCS (
+            const CharString_t *text)
+            { return USBTerminal_sendLineToHost(CharString_cstr(text)); }
+
+        // sends part of a line that may be too long for the buffer, if the
+        // whole part fits. until the part that ends the line is sent, other
+        // lines and text are dropped so they can't end up inside it.
+        // returns true if the part was sent
+        bool USBTerminal_sendLinePartToHost (
+            const char* text,
+            const bool endsLine);
+        inline bool USBTerminal_sendLinePartToHostCS (
+            const CharString_t *text,
+            const bool endsLine)
+            { return USBTerminal_sendLinePartToHost(CharString_cstr(text), endsLine); }
+
+        // lines dropped because they didn't fit, since power-up
+        uint16_t USBTerminal_droppedLines (void);
+
+        // true while a line sent in parts hasn't been ended. bytes sent
+        // now would land inside it
+        bool USBTerminal_lineIsOpen (void);
+
+        // sends all of the bytes, or none of them if they don't fit in the
+        // buffer or a line is open. returns true if they were sent
+        bool USBTerminal_sendBytesToHost (
+            const uint8_t* bytes,
+            const uint8_t length);
+
+        void USBTerminal_task(void);
+        void USBTerminal_Initialize (void);
+        bool USBTerminal_isConnected (void);
+
+        // totals since power-up, for measuring throughput to the host
+        uint32_t USBTerminal_bytesToHost (void);
+        uint32_t USBTerminal_packetsToHost (void);
+
+        void EVENT_USB_Device_Connect(void);
+        void EVENT_USB_Device_Disconnect(void);
+        void EVENT_USB_Device_ConfigurationChanged(void);
+        void EVENT_USB_Device_ControlRequest(void);
+
+        void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCInterfaceInfo);
+
+#endif
+
@@ -0,0 +1,80 @@
+//
+// Byte Ring benchmark
+//
+// Pushes 64 bytes then pops them, one at a time through a ByteQueue and
+// a ByteRing, and as one span through a ByteRing, as the "qbench" command
+// does on the meter, and prints the host nanoseconds per byte of each.
+// On the host cli() and sei() do nothing, so ByteQueue's critical
+// sections cost only the SREG save and restore; on the AVR each one also
+// holds off the USB and timer interrupts. "qbench" gives the AVR cycles.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ByteQueue.h"
+#include "ByteRing.h"
+
+#define BENCH_BYTES 64          // as in CommandProcessor.c
+#define ROUNDS 1000000UL
+
+uint8_t SREG;
+
+static volatile uint8_t sink;
+
+static double nowNanos (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static double perByte (
+    const double start)
+{
+    return (nowNanos() - start) / ((double)ROUNDS * BENCH_BYTES);
+}
+
+int main (void)
+{
+    static uint8_t buffer[BENCH_BYTES];
+    static uint8_t span[BENCH_BYTES];
+    ByteQueue queue = {0, 0, 0, BENCH_BYTES, buffer};
+    ByteRing ring = {0, 0, BENCH_BYTES - 1, buffer};
+
+    double start = nowNanos();
+    for (unsigned long round = 0; round < ROUNDS; ++round) {
+        for (uint8_t i = 0; i < BENCH_BYTES; ++i) {
+            ByteQueue_push(i, &queue);
+        }
+        while (!ByteQueue_is_empty(&queue)) {
+            sink = ByteQueue_pop(&queue);
+        }
+    }
+    const double queueNanos = perByte(start);
+
+    start = nowNanos();
+    for (unsigned long round = 0; round < ROUNDS; ++round) {
+        for (uint8_t i = 0; i < BENCH_BYTES; ++i) {
+            ByteRing_push(i, &ring);
+        }
+        while (!ByteRing_isEmpty(&ring)) {
+            sink = ByteRing_pop(&ring);
+        }
+    }
+    const double ringNanos = perByte(start);
+
+    start = nowNanos();
+    for (unsigned long round = 0; round < ROUNDS; ++round) {
+        span[0] = (uint8_t)round;
+        ByteRing_pushSpan(span, BENCH_BYTES, &ring);
+        sink = ByteRing_popSpan(span, BENCH_BYTES, &ring);
+    }
+    const double spanNanos = perByte(start);
+
+    printf("ByteRingBench: push+pop of %u bytes, %lu rounds\n",
+        BENCH_BYTES, ROUNDS);
+    printf("ns/byte: queue %.2f, ring %.2f, span %.2f\n",
+        queueNanos, ringNanos, spanNanos);
+    return EXIT_SUCCESS;
+}
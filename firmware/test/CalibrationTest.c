@@ -0,0 +1,205 @@
+//
+// Calibration host test
+//
+// Checks Calibration_correct against a double precision reference for
+// uncalibrated ranges (the bias setting), ranges with a calibrated
+// offset and gain (offset first, then gain), ranges with only a gain,
+// and readings that the correction takes past the 16 bit limits, up to
+// the largest gain. Then checks that the corrections survive a save and
+// reload through a fake EEPROM, and that a corrupted record leaves the
+// meter uncalibrated.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "Calibration.h"
+#include "EEPROM.h"
+
+#define MAX_TEST_CHANNELS 6     // including some beyond calibration
+
+static int failures = 0;
+static uint8_t eeprom[EEPROM_SIZE];
+
+// the fake EEPROM writes straight away
+
+bool EEPROM_writeBlock (
+    const uint16_t address,
+    const uint16_t length,
+    const void *data,
+    EEPROM_CompletionHandler completionHandler,
+    void *context)
+{
+    memcpy(&eeprom[address], data, length);
+    if (completionHandler != NULL) {
+        completionHandler(context);
+    }
+    return true;
+}
+
+void EEPROM_readBlock (
+    const uint16_t address,
+    const uint16_t length,
+    void *data)
+{
+    memcpy(data, &eeprom[address], length);
+}
+
+// what a channel and range are expected to be corrected with
+typedef struct Expected_struct {
+    bool offsetIsSet;
+    int8_t offset;
+    uint16_t gain;
+} Expected;
+
+static Expected expected[MAX_TEST_CHANNELS][CALIBRATION_RANGES];
+
+static void clearExpected (void)
+{
+    for (uint8_t ch = 0; ch < MAX_TEST_CHANNELS; ++ch) {
+        for (uint8_t r = 0; r < CALIBRATION_RANGES; ++r) {
+            expected[ch][r].offsetIsSet = false;
+            expected[ch][r].offset = 0;
+            expected[ch][r].gain = CALIBRATION_UNITY_GAIN;
+        }
+    }
+}
+
+static int16_t reference (
+    const uint8_t channel,
+    const uint8_t range,
+    const int16_t reading,
+    const int16_t bias)
+{
+    const Expected *e = &expected[channel][range];
+    const double offset = e->offsetIsSet ? e->offset : bias;
+    double corrected = floor(((reading + offset) * e->gain) /
+        CALIBRATION_UNITY_GAIN);
+    if (corrected > INT16_MAX) {
+        corrected = INT16_MAX;
+    } else if (corrected < INT16_MIN) {
+        corrected = INT16_MIN;
+    }
+    return (int16_t)corrected;
+}
+
+// checks every channel and range against the reference
+static void checkAll (
+    const char *what)
+{
+    static const int16_t readings[] = {
+        0, 1, -1, 100, -100, 4000, -4000, 16383, -16384, 32000, -32000,
+        INT16_MAX, INT16_MIN
+    };
+    static const int16_t biases[] = { 0, 3, -3, 127, -128, 1000 };
+
+    for (uint8_t ch = 0; ch < MAX_TEST_CHANNELS; ++ch) {
+        for (uint8_t r = 0; r < CALIBRATION_RANGES; ++r) {
+            for (size_t b = 0; b < sizeof(biases) / sizeof(biases[0]); ++b) {
+                const int16_t bias = biases[b];
+                const int16_t offset = Calibration_offset(ch, r, bias);
+                const int16_t expectedOffset = expected[ch][r].offsetIsSet
+                    ? expected[ch][r].offset : bias;
+                if (offset != expectedOffset) {
+                    printf("FAIL %s: offset ch %u range %u bias %d: %d, expected %d\n",
+                        what, ch, r, bias, offset, expectedOffset);
+                    ++failures;
+                }
+                for (size_t i = 0; i < sizeof(readings) / sizeof(readings[0]); ++i) {
+                    const int16_t reading = readings[i];
+                    const int16_t corrected =
+                        Calibration_correct(ch, r, reading, bias);
+                    const int16_t correct = reference(ch, r, reading, bias);
+                    if (corrected != correct) {
+                        printf("FAIL %s: ch %u range %u reading %d bias %d: %d, expected %d\n",
+                            what, ch, r, reading, bias, corrected, correct);
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void setOffset (
+    const uint8_t channel,
+    const uint8_t range,
+    const int8_t offset)
+{
+    if (!Calibration_setOffset(channel, range, offset)) {
+        printf("FAIL setOffset ch %u range %u\n", channel, range);
+        ++failures;
+    }
+    expected[channel][range].offsetIsSet = true;
+    expected[channel][range].offset = offset;
+}
+
+static void setGain (
+    const uint8_t channel,
+    const uint8_t range,
+    const uint16_t gain)
+{
+    if (!Calibration_setGain(channel, range, gain)) {
+        printf("FAIL setGain ch %u range %u\n", channel, range);
+        ++failures;
+    }
+    expected[channel][range].gain = gain;
+}
+
+int main (void)
+{
+    // erased EEPROM
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    Calibration_Initialize();
+    clearExpected();
+    checkAll("uncalibrated");
+
+    // offset and gain
+    setOffset(0, 0, -7);
+    setGain(0, 0, 16711);           // +2%
+    setOffset(1, 2, 12);
+    setGain(1, 2, 16057);           // -2%
+    setOffset(3, 3, -128);
+    setGain(3, 3, 16384);
+    // offset only
+    setOffset(2, 1, 127);
+    // gain only, so the bias still applies
+    setGain(2, 3, 17000);
+    // gains big enough to clamp most readings
+    setGain(0, 3, 32768);
+    setGain(3, 0, CALIBRATION_MAX_GAIN);
+    checkAll("calibrated");
+
+    // out of range channels, ranges and gains are refused
+    if (Calibration_setOffset(CALIBRATION_MAX_CHANNELS, 0, 1) ||
+        Calibration_setOffset(0, CALIBRATION_RANGES, 1) ||
+        Calibration_setGain(CALIBRATION_MAX_CHANNELS, 0, 1) ||
+        Calibration_setGain(0, CALIBRATION_RANGES, 1) ||
+        Calibration_setGain(0, 0, CALIBRATION_MAX_GAIN + 1)) {
+        printf("FAIL out of range correction accepted\n");
+        ++failures;
+    }
+
+    // saved and loaded
+    if (!Calibration_save() || Calibration_isSaving()) {
+        printf("FAIL save\n");
+        ++failures;
+    }
+    Calibration_clear();
+    Calibration_Initialize();
+    checkAll("reloaded");
+
+    // a corrupted record is ignored
+    eeprom[EEPROM_CALIBRATION_ADDR + 2] ^= 0x01;
+    Calibration_Initialize();
+    clearExpected();
+    checkAll("corrupted");
+
+    if (failures != 0) {
+        printf("CalibrationTest: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("CalibrationTest: passed\n");
+    return EXIT_SUCCESS;
+}
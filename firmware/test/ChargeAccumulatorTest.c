@@ -0,0 +1,162 @@
+//
+// Charge Accumulator host test
+//
+// Replays a month of synthetic samples through ChargeAccumulator_add and
+// ChargeAccumulator_addProduct and checks the sums against exact 64 bit
+// references, then checks ChargeAccumulator_divide against exact
+// division for the units PowerMeter uses and for large units whose
+// reciprocals need the divisor shifted down.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ChargeAccumulator.h"
+
+#define SAMPLES_PER_SECOND 100
+#define SECONDS_PER_MONTH (31UL * 24 * 3600)
+
+static int failures = 0;
+
+static void check (
+    const int ok,
+    const char *what,
+    const unsigned long long value,
+    const unsigned long long expected)
+{
+    if (!ok) {
+        printf("FAIL %s: %llu, expected %llu\n", what, value, expected);
+        ++failures;
+    }
+}
+
+// a reproducible pseudo-random sequence (xorshift32)
+static uint32_t randomState = 2463534242UL;
+static uint32_t nextRandom (void)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// checks divide against exact division, for magnitudes up to the largest
+// whose quotient fits in 32 bits
+static void checkDivide (
+    const uint64_t units)
+{
+    ChargeUnit unit;
+    ChargeAccumulator_setUnit(units, &unit);
+    const uint64_t maxMagnitude = (units > (UINT64_MAX / UINT32_MAX))
+        ? UINT64_MAX
+        : (units * UINT32_MAX) + (units - 1);
+
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t magnitude;
+        switch (i) {
+            case 0 : magnitude = 0; break;
+            case 1 : magnitude = units - 1; break;
+            case 2 : magnitude = units; break;
+            case 3 : magnitude = maxMagnitude; break;
+            case 4 : magnitude = maxMagnitude - units; break;
+            default :
+                magnitude = (((uint64_t)nextRandom() << 32) | nextRandom()) %
+                    maxMagnitude;
+                break;
+        }
+        uint64_t remainder;
+        const uint32_t quotient =
+            ChargeAccumulator_divide(magnitude, &unit, &remainder);
+        check(quotient == (magnitude / units), "quotient",
+            quotient, magnitude / units);
+        check(remainder == (magnitude % units), "remainder",
+            remainder, magnitude % units);
+    }
+}
+
+// replays a month of samples at SAMPLES_PER_SECOND with the given weight
+// range, and checks the accumulated charge and energy
+static void replayMonth (
+    const uint16_t minWeight,
+    const uint16_t maxWeight)
+{
+    ChargeAccumulator charge;
+    ChargeAccumulator energy;
+    ChargeAccumulator_clear(&charge);
+    ChargeAccumulator_clear(&energy);
+    int64_t exactCharge = 0;
+    int64_t exactEnergy = 0;
+
+    const uint64_t samples = (uint64_t)SAMPLES_PER_SECOND * SECONDS_PER_MONTH;
+    for (uint64_t s = 0; s < samples; ++s) {
+        // near full scale readings, mostly positive, and a full range of
+        // power values
+        const int16_t reading = (int16_t)((nextRandom() % 40000) - 8000);
+        const uint16_t weight = minWeight +
+            (nextRandom() % ((uint32_t)maxWeight - minWeight + 1));
+        const int32_t power = (int32_t)(nextRandom() % 4000000) - 500000;
+
+        ChargeAccumulator_add((int32_t)reading * weight, &charge);
+        ChargeAccumulator_addProduct(power, weight, &energy);
+        exactCharge += (int64_t)reading * weight;
+        exactEnergy += (int64_t)power * weight;
+    }
+
+    check(ChargeAccumulator_value(&charge) == exactCharge, "month charge",
+        ChargeAccumulator_value(&charge), exactCharge);
+    check(ChargeAccumulator_value(&energy) == exactEnergy, "month energy",
+        ChargeAccumulator_value(&energy), exactEnergy);
+
+    // mAh to 3 places, as PowerMeter reports it, against a double
+    // precision reference. 2MHz weight units, 100 mOhm shunt: a reading
+    // is 0.1mA
+    const uint64_t countsPerUAh = (36ULL * 100 * 2000000) / 100;
+    ChargeUnit milliAmpHour;
+    ChargeUnit microAmpHour;
+    ChargeAccumulator_setUnit(countsPerUAh * 1000, &milliAmpHour);
+    ChargeAccumulator_setUnit(countsPerUAh, &microAmpHour);
+    uint64_t remainder;
+    const uint32_t milli = ChargeAccumulator_divide(
+        (uint64_t)exactCharge, &milliAmpHour, &remainder);
+    const uint32_t micro =
+        ChargeAccumulator_divide(remainder, &microAmpHour, NULL);
+    const double reported = milli + (micro / 1000.0);
+    const double reference = (double)exactCharge / (double)(countsPerUAh * 1000);
+    const double error = reference - reported;
+    if ((error < 0) || (error >= 0.001)) {
+        printf("FAIL month mAh: %.6f, reference %.6f\n", reported, reference);
+        ++failures;
+    }
+}
+
+int main (void)
+{
+    // PowerMeter's units: uAh and uWh, mAh and mWh, for shunts from 1 to
+    // 65535 mOhm and weight units of 2MHz down to 500kHz
+    for (uint32_t shunt = 1; shunt <= 65535; shunt = (shunt * 3) + 1) {
+        for (uint8_t shift = 0; shift <= 2; ++shift) {
+            const uint64_t countsPerSecond = 2000000UL >> shift;
+            const uint64_t countsPerUAh = (36ULL * shunt * countsPerSecond) / 100;
+            const uint64_t countsPerUWh = (45ULL * shunt * countsPerSecond) / 64;
+            checkDivide(countsPerUAh);
+            checkDivide(countsPerUAh * 1000);
+            checkDivide(countsPerUWh);
+            checkDivide(countsPerUWh * 1000);
+        }
+    }
+    // a mWh unit whose reciprocal used to round up (228 mOhm, 1kHz)
+    checkDivide(320625000000ULL);
+    for (int i = 0; i < 200; ++i) {
+        checkDivide(((((uint64_t)nextRandom() << 32) | nextRandom()) >>
+            (nextRandom() % 56)) | 256);
+    }
+
+    // timed mode 1mS weights, and conversion ready weights that vary
+    replayMonth(2000, 2000);
+    replayMonth(1200, 2800);
+
+    if (failures == 0) {
+        printf("ChargeAccumulatorTest: passed\n");
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+//
+// I2C Asynchronous interface benchmark
+//
+// Runs chained INA219 register reads through I2CAsync and TWIModel, each
+// one queued from the completion handler of the one before as PowerMeter
+// queues a tick's reads, for a range of times round the mainloop. Prints
+// the transfers per second and the time from queueing a transfer to its
+// completion handler, for the engine it was built with (I2CASYNC_POLLED).
+// The times are the model's: 400KHz bus steps, no time spent in the
+// interrupt handler or in the rest of the mainloop.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "I2CAsync.h"
+#include "TWIModel.h"
+
+#if I2CASYNC_POLLED
+#define ENGINE "polled"
+#else
+#define ENGINE "interrupt driven"
+#endif
+
+#define TRANSFERS 1000
+#define RUN_MICROS 10000000UL
+
+typedef struct Bench_struct {
+    uint8_t writeLength;        // register pointer, or none
+    uint16_t completed;
+    bool failed;
+    uint32_t queuedAt;
+    uint32_t totalLatency;
+} Bench;
+
+static void queueNext (
+    Bench *bench);
+
+static void completionHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const uint8_t readDataLength,
+    const uint8_t* readData,
+    void *context)
+{
+    Bench *bench = (Bench *)context;
+    if (!success) {
+        bench->failed = true;
+    }
+    bench->totalLatency += twiModel.now - bench->queuedAt;
+    ++bench->completed;
+    if (bench->completed < TRANSFERS) {
+        queueNext(bench);
+    }
+}
+
+static void queueNext (
+    Bench *bench)
+{
+    static const uint8_t registerPointer = 0x01;
+    bench->queuedAt = twiModel.now;
+    if (!I2CAsync_transferData(TWIMODEL_SLAVE_ADDRESS, bench->writeLength,
+        &registerPointer, 2, completionHandler, bench)) {
+        bench->failed = true;
+    }
+}
+
+// returns false if the transfers didn't all go through
+static bool run (
+    const uint32_t taskMicros,
+    const uint8_t writeLength,
+    uint32_t *perSecond,
+    uint32_t *latency)
+{
+    Bench bench = { writeLength, 0, false, 0, 0 };
+    TWIModel_reset(taskMicros);
+    I2CAsync_Initialize();
+    queueNext(&bench);
+    TWIModel_run(RUN_MICROS);
+
+    *perSecond = (uint32_t)(((uint64_t)bench.completed * 1000000) / twiModel.now);
+    *latency = bench.totalLatency / bench.completed;
+    return !bench.failed && (bench.completed == TRANSFERS);
+}
+
+int main (void)
+{
+    static const uint32_t taskMicros[] = { 10, 20, 50, 100, 200, 500 };
+
+    printf("I2CAsyncBench, " ENGINE ": %u chained transfers at 400KHz\n",
+        TRANSFERS);
+    printf("mainloop uS   read/s  latency uS   pointer+read/s  latency uS\n");
+    for (size_t t = 0; t < sizeof(taskMicros) / sizeof(taskMicros[0]); ++t) {
+        uint32_t readsPerSecond;
+        uint32_t readLatency;
+        uint32_t pointerReadsPerSecond;
+        uint32_t pointerReadLatency;
+        if (!run(taskMicros[t], 0, &readsPerSecond, &readLatency) ||
+            !run(taskMicros[t], 1, &pointerReadsPerSecond, &pointerReadLatency)) {
+            printf("I2CAsyncBench: transfers failed\n");
+            return EXIT_FAILURE;
+        }
+        printf("%11u %8u %11u %16u %11u\n", (unsigned)taskMicros[t],
+            (unsigned)readsPerSecond, (unsigned)readLatency,
+            (unsigned)pointerReadsPerSecond, (unsigned)pointerReadLatency);
+    }
+
+    return EXIT_SUCCESS;
+}
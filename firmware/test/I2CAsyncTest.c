@@ -0,0 +1,247 @@
+//
+// I2C Asynchronous interface host test
+//
+// Runs I2CAsync against TWIModel, with either engine (build with
+// I2CASYNC_POLLED=1 for the polled one). Checks that a transfer to a
+// stuck slave - one that stretches the clock for ever, so the TWI never
+// sets TWINT, or one that holds SDA low - fails with a timeout no sooner
+// than TIMEOUT_MICROS after its last step and no later than a system
+// tick, a mainloop pass and a bus recovery after that; that it fails
+// just once, so it costs the one sample it was reading; that the bus is
+// clocked out and stopped; and that the transfer queued behind it then
+// goes through. Also checks that a NACKed transfer is still retried, and
+// that a status a master never expects is counted as 0x80.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "I2CAsync.h"
+#include "SystemTime.h"
+#include "TWIModel.h"
+
+#if I2CASYNC_POLLED
+#define TEST_NAME "I2CAsyncPolledTest"
+#else
+#define TEST_NAME "I2CAsyncTest"
+#endif
+
+// as in I2CAsync.c
+#define TIMEOUT_MICROS 1000
+#define MAX_RETRIES 2
+#define CLOCK_OUT_PULSES 9
+#define HALF_BIT_MICROS 5
+// recoverBus waits a half bit, clocks out the slave and sends a STOP
+#define MAX_RECOVERY_MICROS ((2 + (2 * CLOCK_OUT_PULSES) + 2) * HALF_BIT_MICROS)
+
+#define TICK_MICROS (1000000UL / SYSTEMTIME_TICKS_PER_SECOND)
+#define TASK_MICROS 50          // time round the mainloop
+#define RUN_MICROS 20000UL
+
+#define NO_SUCH_ADDRESS (TWIMODEL_SLAVE_ADDRESS + 1)
+#define NO_STATUS 0xF8          // TWSR when there is nothing to report
+
+static int failures = 0;
+
+static void check (
+    const int ok,
+    const char *scenario,
+    const char *what,
+    const long value,
+    const long expected)
+{
+    if (!ok) {
+        printf("FAIL %s: %s: %ld, expected %ld\n",
+            scenario, what, value, expected);
+        ++failures;
+    }
+}
+
+// a sample read, as INA219 does one: the register pointer, then the
+// register
+
+typedef struct Transfer_struct {
+    uint8_t completions;
+    bool success;
+    I2CStatusCode status;
+    uint32_t stalledMicros;     // from the last step to the completion
+    uint8_t readDataLength;
+    uint8_t readData[I2CASYNC_MAX_DATA_LEN];
+} Transfer;
+
+static void completionHandler (
+    const bool success,
+    const I2CStatusCode i2cStatus,
+    const uint8_t readDataLength,
+    const uint8_t* readData,
+    void *context)
+{
+    Transfer *transfer = (Transfer *)context;
+    ++transfer->completions;
+    transfer->success = success;
+    transfer->status = i2cStatus;
+    transfer->stalledMicros = twiModel.now - twiModel.timeoutArmedAt;
+    transfer->readDataLength = readDataLength;
+    memcpy(transfer->readData, readData, readDataLength);
+}
+
+static void queueRead (
+    const uint8_t address,
+    Transfer *transfer)
+{
+    static const uint8_t registerPointer = 0x01;
+    memset(transfer, 0, sizeof(Transfer));
+    if (!I2CAsync_transferData(address, 1, &registerPointer, 2,
+        completionHandler, transfer)) {
+        printf("FAIL transfer not queued\n");
+        ++failures;
+    }
+}
+
+static void start (void)
+{
+    TWIModel_reset(TASK_MICROS);
+    I2CAsync_Initialize();
+}
+
+static void checkRead (
+    const char *scenario,
+    const Transfer *transfer)
+{
+    check(transfer->completions == 1, scenario, "read completions",
+        transfer->completions, 1);
+    check(transfer->success, scenario, "read success", transfer->success, 1);
+    check((transfer->readDataLength == 2) &&
+        (transfer->readData[0] == twiModel.slaveData[0]) &&
+        (transfer->readData[1] == twiModel.slaveData[1]),
+        scenario, "read data length", transfer->readDataLength, 2);
+}
+
+static void checkTimedOut (
+    const char *scenario,
+    const Transfer *transfer)
+{
+    check(transfer->completions == 1, scenario, "timed out completions",
+        transfer->completions, 1);
+    check(!transfer->success && (transfer->status == isc_timeout),
+        scenario, "timed out status", transfer->status, isc_timeout);
+    check(transfer->stalledMicros >= TIMEOUT_MICROS, scenario,
+        "stalled uS (least)", transfer->stalledMicros, TIMEOUT_MICROS);
+    const uint32_t most =
+        TIMEOUT_MICROS + TICK_MICROS + TASK_MICROS + MAX_RECOVERY_MICROS;
+    check(transfer->stalledMicros <= most, scenario,
+        "stalled uS (most)", transfer->stalledMicros, most);
+}
+
+static void checkCounts (
+    const char *scenario,
+    const uint16_t timeouts,
+    const uint16_t recoveries,
+    const uint16_t retries)
+{
+    check(I2CAsync_errorCount(isc_timeout) == timeouts, scenario,
+        "timeouts", I2CAsync_errorCount(isc_timeout), timeouts);
+    check(I2CAsync_recoveryCount() == recoveries, scenario,
+        "recoveries", I2CAsync_recoveryCount(), recoveries);
+    check(I2CAsync_retryCount() == retries, scenario,
+        "retries", I2CAsync_retryCount(), retries);
+    check(I2CAsync_isIdle(), scenario, "idle", I2CAsync_isIdle(), 1);
+}
+
+int main (void)
+{
+    Transfer first;
+    Transfer second;
+    Transfer third;
+
+    // a healthy slave
+    start();
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    TWIModel_run(RUN_MICROS);
+    checkRead("healthy", &first);
+    checkCounts("healthy", 0, 0, 0);
+
+    // stretches the clock after SLA+W until the bus is reset. the sample
+    // read behind it goes ahead
+    start();
+    twiModel.stepsBeforeStretch = 2;
+    twiModel.releaseOnRecovery = true;
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &second);
+    TWIModel_run(RUN_MICROS);
+    checkTimedOut("stretch until reset", &first);
+    checkRead("stretch until reset", &second);
+    checkCounts("stretch until reset", 1, 1, 0);
+    check(twiModel.stopsSeen > 0, "stretch until reset", "STOPs", twiModel.stopsSeen, 1);
+
+    // stretches the clock for ever. each sample read times out once, and
+    // the meter gets going again when the slave does
+    start();
+    twiModel.stepsBeforeStretch = 1;
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &second);
+    TWIModel_run(RUN_MICROS);
+    checkTimedOut("stretch for ever", &first);
+    checkTimedOut("stretch for ever", &second);
+    checkCounts("stretch for ever", 2, 2, 0);
+    twiModel.stretching = false;
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &third);
+    TWIModel_run(RUN_MICROS);
+    checkRead("stretch for ever", &third);
+
+    // holds SDA low, as a slave does that was reset out of the middle of
+    // a byte. it lets go after three clocks
+    start();
+    TWIModel_holdSDA(3);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &second);
+    TWIModel_run(RUN_MICROS);
+    checkTimedOut("SDA held", &first);
+    checkRead("SDA held", &second);
+    checkCounts("SDA held", 1, 1, 0);
+    check(twiModel.sclPulses == 3, "SDA held", "SCL pulses", twiModel.sclPulses, 3);
+    check(twiModel.stopsSeen > 0, "SDA held", "STOPs", twiModel.stopsSeen, 1);
+
+    // holds SDA low for ever. the clocking out gives up
+    start();
+    TWIModel_holdSDA(TWIMODEL_SDA_FOREVER);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &second);
+    TWIModel_run(RUN_MICROS);
+    checkTimedOut("SDA held for ever", &first);
+    checkTimedOut("SDA held for ever", &second);
+    checkCounts("SDA held for ever", 2, 2, 0);
+    check(twiModel.sclPulses == 2 * CLOCK_OUT_PULSES, "SDA held for ever",
+        "SCL pulses", twiModel.sclPulses, 2 * CLOCK_OUT_PULSES);
+
+    // no slave at the address. a NACK is retried, without resetting the bus
+    start();
+    queueRead(NO_SUCH_ADDRESS, &first);
+    TWIModel_run(RUN_MICROS);
+    check((first.completions == 1) && !first.success &&
+        (first.status == isc_SLAWNACK), "NACK", "status",
+        first.status, isc_SLAWNACK);
+    check(I2CAsync_errorCount(isc_SLAWNACK) == MAX_RETRIES + 1, "NACK",
+        "NACKs", I2CAsync_errorCount(isc_SLAWNACK), MAX_RETRIES + 1);
+    checkCounts("NACK", 0, 0, MAX_RETRIES);
+
+    // a status a master never expects
+    start();
+    twiModel.startStatus = NO_STATUS;
+    queueRead(TWIMODEL_SLAVE_ADDRESS, &first);
+    TWIModel_run(RUN_MICROS);
+    check((first.completions == 1) && !first.success &&
+        (first.status == NO_STATUS), "no status", "status",
+        first.status, NO_STATUS);
+    check(I2CAsync_errorCount(0x80) == MAX_RETRIES + 1, "no status",
+        "0x80 count", I2CAsync_errorCount(0x80), MAX_RETRIES + 1);
+    check(I2CAsync_errorCount(isc_timeout) == 0, "no status",
+        "timeouts", I2CAsync_errorCount(isc_timeout), 0);
+
+    if (failures != 0) {
+        printf(TEST_NAME ": %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf(TEST_NAME ": passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,9 @@
+//
+// host stand-in for LUFA/Drivers/Peripheral/Serial.h, for the host tests. nothing in it is used by
+// the modules they build
+//
+
+#ifndef LUFA_DRIVERS_PERIPHERAL_SERIAL_H
+#define LUFA_DRIVERS_PERIPHERAL_SERIAL_H
+
+#endif  // LUFA_DRIVERS_PERIPHERAL_SERIAL_H
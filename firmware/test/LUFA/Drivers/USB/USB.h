@@ -0,0 +1,85 @@
+//
+// host stand-in for LUFA's USB driver, for the host tests: the types,
+// constants and calls USBTerminal and Descriptors use, with the endpoint
+// and CDC calls made by USBModel
+//
+
+#ifndef LUFA_DRIVERS_USB_USB_H
+#define LUFA_DRIVERS_USB_USB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define ATTR_WARN_UNUSED_RESULT
+#define ATTR_NON_NULL_PTR_ARG(...)
+
+#define ENDPOINT_DIR_IN  0x80
+#define ENDPOINT_DIR_OUT 0x00
+
+// the descriptors are only declared
+typedef uint8_t USB_Descriptor_Configuration_Header_t;
+typedef uint8_t USB_Descriptor_Interface_t;
+typedef uint8_t USB_CDC_Descriptor_FunctionalHeader_t;
+typedef uint8_t USB_CDC_Descriptor_FunctionalACM_t;
+typedef uint8_t USB_CDC_Descriptor_FunctionalUnion_t;
+typedef uint8_t USB_Descriptor_Endpoint_t;
+
+enum USB_Device_States_t {
+    DEVICE_STATE_Unattached = 0,
+    DEVICE_STATE_Configured = 4
+};
+
+enum Endpoint_WaitUntilReady_ErrorCodes_t {
+    ENDPOINT_READYWAIT_NoError = 0
+};
+
+enum Endpoint_Stream_RW_ErrorCodes_t {
+    ENDPOINT_RWSTREAM_NoError = 0
+};
+
+typedef struct {
+    uint8_t Address;
+    uint16_t Size;
+    uint8_t Type;
+    uint8_t Banks;
+} USB_Endpoint_Table_t;
+
+typedef struct {
+    struct {
+        uint8_t ControlInterfaceNumber;
+        USB_Endpoint_Table_t DataINEndpoint;
+        USB_Endpoint_Table_t DataOUTEndpoint;
+        USB_Endpoint_Table_t NotificationEndpoint;
+    } Config;
+} USB_ClassInfo_CDC_Device_t;
+
+extern volatile uint8_t USB_DeviceState;
+
+extern void USB_Init (void);
+extern void USB_USBTask (void);
+
+extern void Endpoint_SelectEndpoint (
+    const uint8_t address);
+extern bool Endpoint_IsINReady (void);
+extern bool Endpoint_IsReadWriteAllowed (void);
+extern uint16_t Endpoint_BytesInEndpoint (void);
+extern void Endpoint_ClearIN (void);
+extern uint8_t Endpoint_Write_Stream_LE (
+    const void* const buffer,
+    uint16_t length,
+    uint16_t* const bytesProcessed);
+
+extern bool CDC_Device_ConfigureEndpoints (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo);
+extern void CDC_Device_ProcessControlRequest (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo);
+extern void CDC_Device_USBTask (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo);
+extern uint8_t CDC_Device_SendByte (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo,
+    const uint8_t data);
+extern int16_t CDC_Device_ReceiveByte (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo);
+
+#endif  // LUFA_DRIVERS_USB_USB_H
@@ -0,0 +1,9 @@
+//
+// host stand-in for LUFA/Version.h, for the host tests. nothing in it is used by
+// the modules they build
+//
+
+#ifndef LUFA_VERSION_H
+#define LUFA_VERSION_H
+
+#endif  // LUFA_VERSION_H
@@ -0,0 +1,168 @@
+//
+// Report Clock host test
+//
+// Runs ReportClock through the tick lengths PowerMeter uses for a range
+// of sample rates and report intervals, and checks, against a double
+// precision reference, that each report falls on the first tick at or
+// after its multiple of the interval with the exact elapsed time, also
+// across the wrap of the mS count. Then checks that the charge over the
+// reported time converts to the exact uAh (rounded down) through the
+// units PowerMeter sets up for a shunt.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ReportClock.h"
+#include "ChargeAccumulator.h"
+
+// as in PowerMeter, for a 16MHz clock
+#define COUNTS_PER_SECOND 2000000UL
+#define COUNTS_PER_MS (COUNTS_PER_SECOND / 1000)
+#define MAX_WEIGHT_PERIODS 4
+#define MAX_TICKS 1000000UL
+#define MAX_REPORTS 200
+
+static int failures = 0;
+
+static void check (
+    const int ok,
+    const char *what,
+    const unsigned samplesPerSecond,
+    const unsigned long intervalMs,
+    const long long value,
+    const long long expected)
+{
+    if (!ok) {
+        printf("FAIL %s (%u samples/s, %lu mS): %lld, expected %lld\n",
+            what, samplesPerSecond, intervalMs, value, expected);
+        ++failures;
+    }
+}
+
+// the weight unit shift and tick length PowerMeter uses for a sample
+// rate (see applySampleRate)
+static uint32_t countsPerTickAt (
+    const unsigned samplesPerSecond,
+    uint8_t *weightShift)
+{
+    const uint32_t countsPerPeriod = COUNTS_PER_SECOND / samplesPerSecond;
+    uint8_t shift = 0;
+    while (((countsPerPeriod * MAX_WEIGHT_PERIODS) >> shift) >= 65536UL) {
+        ++shift;
+    }
+    *weightShift = shift;
+    return (countsPerPeriod >> shift) << shift;
+}
+
+// ticks off reports from startTime, checking each against the reference
+static void checkReports (
+    const unsigned samplesPerSecond,
+    const uint32_t intervalMs,
+    const int32_t startTime)
+{
+    uint8_t weightShift;
+    const uint32_t countsPerTick = countsPerTickAt(samplesPerSecond, &weightShift);
+    ReportTick tick;
+    ReportClock_setTick(countsPerTick, COUNTS_PER_MS, &tick);
+
+    int32_t time = startTime;
+    int32_t nextReportTime = (int32_t)((uint32_t)startTime + intervalMs);
+    uint16_t countsRemainder = 0;
+    uint32_t reports = 0;
+    for (uint32_t ticks = 1; (ticks <= MAX_TICKS) && (reports < MAX_REPORTS); ++ticks) {
+        time = ReportClock_addTick(time, &tick, &countsRemainder);
+        const double exactMs = ((double)ticks * countsPerTick) / COUNTS_PER_MS;
+        check((uint32_t)time - (uint32_t)startTime == (uint32_t)floor(exactMs),
+            "time", samplesPerSecond, intervalMs,
+            (uint32_t)time - (uint32_t)startTime, (long long)floor(exactMs));
+        if (ReportClock_isDue(time, nextReportTime)) {
+            ++reports;
+            nextReportTime = (int32_t)((uint32_t)nextReportTime + intervalMs);
+            // the first tick at or after the report's multiple of the
+            // interval
+            const double dueTicks =
+                ceil(((double)reports * intervalMs * COUNTS_PER_MS) / countsPerTick);
+            check(ticks == dueTicks, "report tick", samplesPerSecond,
+                intervalMs, ticks, (long long)dueTicks);
+        }
+    }
+}
+
+// checks the charge of a steady shunt reading over the ticks of a report
+// interval, as PowerMeter displays it, against the reference
+static void checkCharge (
+    const unsigned samplesPerSecond,
+    const uint32_t intervalMs,
+    const uint16_t shuntMilliOhms,
+    const int16_t reading)
+{
+    uint8_t weightShift;
+    const uint32_t countsPerTick = countsPerTickAt(samplesPerSecond, &weightShift);
+    const uint16_t weightPerTick = countsPerTick >> weightShift;
+    const uint32_t ticks =
+        ((uint64_t)intervalMs * COUNTS_PER_MS + countsPerTick - 1) / countsPerTick;
+
+    // as in PowerMeter's setUnits
+    const uint32_t countsPerSecond = COUNTS_PER_SECOND >> weightShift;
+    const uint64_t countsPerUAh = (36ULL * shuntMilliOhms * countsPerSecond) / 100;
+    ChargeUnit microAmpHour;
+    ChargeUnit milliAmpHour;
+    ChargeAccumulator_setUnit(countsPerUAh, &microAmpHour);
+    ChargeAccumulator_setUnit(countsPerUAh * 1000, &milliAmpHour);
+
+    // the sums themselves are checked by ChargeAccumulatorTest
+    const int64_t charge = (int64_t)reading * weightPerTick * ticks;
+    const uint64_t magnitude = (charge < 0) ? -charge : charge;
+    uint64_t remainder;
+    const uint32_t milli =
+        ChargeAccumulator_divide(magnitude, &milliAmpHour, &remainder);
+    const uint32_t micro =
+        ChargeAccumulator_divide(remainder, &microAmpHour, NULL);
+    const long long microAmpHours = ((long long)milli * 1000) + micro;
+
+    // a shunt reading is 10uV
+    const double seconds = ((double)ticks * countsPerTick) / COUNTS_PER_SECOND;
+    const double exact =
+        ((abs(reading) * 10000.0) / shuntMilliOhms) * seconds / 3600.0;
+    // allow for the reference's own rounding when it is a whole uAh
+    const long long below = (long long)floor(exact * (1 - 1e-12));
+    const long long above = (long long)floor(exact * (1 + 1e-12));
+    check((microAmpHours == below) || (microAmpHours == above), "uAh",
+        samplesPerSecond, intervalMs, microAmpHours, above);
+}
+
+int main (void)
+{
+    static const unsigned rates[] = {
+        10, 11, 33, 60, 100, 128, 333, 1000, 1024, 3000, 4999, 5952
+    };
+    static const uint32_t intervals[] = {
+        1, 3, 7, 10, 33, 100, 250, 999, 1000, 1001, 60000, 3600000, 86400000
+    };
+    static const uint16_t shunts[] = { 1, 10, 100, 1000, 65535 };
+    static const int16_t readings[] = { 1, -1, 12345, 32000, -32768 };
+
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r) {
+        for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); ++i) {
+            // PowerMeter won't report more often than it samples
+            if (((uint64_t)intervals[i] * rates[r]) < 1000) {
+                continue;
+            }
+            checkReports(rates[r], intervals[i], 0);
+            checkReports(rates[r], intervals[i], INT32_MAX - 5000);
+            for (size_t s = 0; s < sizeof(shunts) / sizeof(shunts[0]); ++s) {
+                for (size_t v = 0; v < sizeof(readings) / sizeof(readings[0]); ++v) {
+                    checkCharge(rates[r], intervals[i], shunts[s], readings[v]);
+                }
+            }
+        }
+    }
+
+    if (failures != 0) {
+        printf("ReportClockTest: %d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("ReportClockTest: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+//
+// Scaling benchmark
+//
+// Times the per-sample arithmetic of the two scaling paths, as the
+// "sbench" command does on the meter: firmware scaling corrects each
+// shunt reading with Calibration_correct and multiplies it by the bus
+// voltage for the power; hardware scaling takes the current and power
+// registers as they are. Prints the host nanoseconds per sample of each.
+// The AVR has no 32 bit multiply, so the firmware path costs it far more,
+// relative to the hardware path, than it does the host; "sbench" gives
+// the AVR cycles.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Calibration.h"
+#include "EEPROM.h"
+
+#define BENCH_SAMPLES 64        // as in PowerMeter.c
+#define ROUNDS 1000000UL
+#define POWER_SHIFT 7           // as in PowerMeter.c
+#define ADC_BIAS 5
+#define BUS_VOLTAGE 3000        // 12V in 4mV units
+
+static volatile int16_t currentSink;
+static volatile int32_t powerSink;
+static volatile uint16_t lastHardwarePower;
+
+// the fake EEPROM is erased, so the meter is uncalibrated
+
+bool EEPROM_writeBlock (
+    const uint16_t address,
+    const uint16_t length,
+    const void *data,
+    EEPROM_CompletionHandler completionHandler,
+    void *context)
+{
+    return false;
+}
+
+void EEPROM_readBlock (
+    const uint16_t address,
+    const uint16_t length,
+    void *data)
+{
+    memset(data, 0xFF, length);
+}
+
+// as in PowerMeter.c
+static int32_t samplePower (
+    const int16_t current,
+    const uint16_t busVoltage)
+{
+    return (((int32_t)current * busVoltage) + (1L << (POWER_SHIFT - 1)))
+        >> POWER_SHIFT;
+}
+
+static double nowNanos (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static double perSample (
+    const double start)
+{
+    return (nowNanos() - start) / ((double)ROUNDS * BENCH_SAMPLES);
+}
+
+int main (void)
+{
+    Calibration_Initialize();
+    Calibration_setOffset(0, 3, -7);
+    Calibration_setGain(0, 3, 16711);
+
+    double start = nowNanos();
+    for (unsigned long round = 0; round < ROUNDS; ++round) {
+        for (uint8_t i = 0; i < BENCH_SAMPLES; ++i) {
+            const int16_t current =
+                Calibration_correct(0, 3, (int16_t)(i * 1021), ADC_BIAS);
+            currentSink = current;
+            powerSink = samplePower(current, BUS_VOLTAGE);
+        }
+    }
+    const double firmwareNanos = perSample(start);
+
+    start = nowNanos();
+    for (unsigned long round = 0; round < ROUNDS; ++round) {
+        for (uint8_t i = 0; i < BENCH_SAMPLES; ++i) {
+            currentSink = (int16_t)(i * 1021);
+            lastHardwarePower = i;
+            powerSink = lastHardwarePower;
+        }
+    }
+    const double hardwareNanos = perSample(start);
+
+    printf("ScalingBench: %u samples, %lu rounds\n", BENCH_SAMPLES, ROUNDS);
+    printf("ns/sample: fw %.2f, hw %.2f\n", firmwareNanos, hardwareNanos);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,235 @@
+//
+// TWI Model
+//
+
+#include "TWIModel.h"
+
+#include <string.h>
+#include <avr/io.h>
+#include "I2CAsync.h"
+#include "SystemTime.h"
+#include "Log.h"
+
+// as in I2CAsync.c
+#ifndef I2CASYNC_POLLED
+#define I2CASYNC_POLLED 0
+#endif
+
+#define TICK_MICROS (1000000UL / SYSTEMTIME_TICKS_PER_SECOND)
+
+// TWCR reads back with TWWC set, which I2CAsync never writes, so a value
+// without it has been written since the last access
+#define WRITE_MARKER (1 << TWWC)
+
+TWIModel twiModel;
+
+#if !I2CASYNC_POLLED
+extern void TWI_interrupt (void);
+#endif
+
+uint8_t SREG;
+volatile uint8_t TWSR;
+volatile uint8_t TWDR;
+volatile uint8_t TWBR;
+volatile uint8_t PORTD;
+volatile uint8_t DDRD;
+volatile uint8_t PIND;
+
+static uint8_t controlRegister;     // what TWCR reads back
+static uint8_t control;             // the bits last written, but TWINT
+static bool interruptFlag;          // TWINT
+static bool stepPending;            // a START or a byte is going out
+static uint8_t stepControl;         // what it was asked for with
+static uint32_t stepDoneAt;
+static bool busActive;              // between a START and a STOP
+static bool addressNext;            // the next byte is SLA+R/W
+static bool reading;
+static uint8_t bytesRead;
+static bool sclWasLow;
+static bool sdaWasHigh;
+
+static bool before (
+    const uint32_t time,
+    const uint32_t otherTime)
+{
+    return (int32_t)(time - otherTime) < 0;
+}
+
+// the SystemTime calls I2CAsync makes
+
+void SystemTime_futureTick (
+    const uint16_t ticksFromNow,
+    SystemTime_Tick_t* futureTick)
+{
+    twiModel.timeoutArmedAt = twiModel.now;
+    *futureTick = (twiModel.now / TICK_MICROS) + ticksFromNow + 1;
+}
+
+bool SystemTime_tickHasArrived (
+    const SystemTime_Tick_t* tick)
+{
+    return (int32_t)((twiModel.now / TICK_MICROS) - *tick) >= 0;
+}
+
+void Log_messageP (
+    PGM_P format,
+    const uint8_t numArgs,
+    const int32_t arg1,
+    const int32_t arg2,
+    const int32_t arg3)
+{
+}
+
+// takes in what was written to TWCR since the last access. a STOP goes
+// out on the bus straight away; a START or a byte takes its time
+volatile uint8_t *TWI_controlRegister (void)
+{
+    if (!(controlRegister & WRITE_MARKER)) {
+        const uint8_t written = controlRegister;
+        control = written & ~(1 << TWINT);
+        if (written & (1 << TWINT)) {
+            // writing a 1 clears the flag
+            interruptFlag = false;
+        }
+        if (!(written & (1 << TWEN))) {
+            stepPending = false;
+            interruptFlag = false;
+        } else if (written & (1 << TWSTO)) {
+            busActive = false;
+            control &= ~(1 << TWSTO);
+        } else if (written & (1 << TWINT)) {
+            stepPending = true;
+            stepControl = written;
+            stepDoneAt = twiModel.now + ((written & (1 << TWSTA))
+                ? TWIMODEL_START_MICROS : TWIMODEL_BYTE_MICROS);
+        }
+    }
+    controlRegister =
+        control | (interruptFlag ? (1 << TWINT) : 0) | WRITE_MARKER;
+
+    return &controlRegister;
+}
+
+// busy waits only happen while recoverBus works the pins by hand. the pins
+// are open drain, so a line is low if anything drives it
+void _delay_us (
+    double us)
+{
+    twiModel.now += (uint32_t)us;
+    if (twiModel.releaseOnRecovery) {
+        twiModel.stretching = false;
+    }
+
+    const bool sclLow = (DDRD & (1 << PD0)) != 0;
+    if (sclWasLow && !sclLow) {
+        ++twiModel.sclPulses;
+        if (twiModel.sdaHeld &&
+            (twiModel.sclPulses >= twiModel.sdaHoldPulses) &&
+            (twiModel.sdaHoldPulses != TWIMODEL_SDA_FOREVER)) {
+            // the slave has finished the byte it was sending
+            twiModel.sdaHeld = false;
+        }
+    }
+    const bool sdaHigh = !twiModel.sdaHeld && !(DDRD & (1 << PD1));
+    if (!sclLow && sdaHigh && !sdaWasHigh) {
+        ++twiModel.stopsSeen;
+        busActive = false;
+    }
+    sclWasLow = sclLow;
+    sdaWasHigh = sdaHigh;
+    PIND = (sclLow ? 0 : (1 << PD0)) | (sdaHigh ? (1 << PD1) : 0);
+}
+
+// finishes the step in progress, as the slave answers it
+static void finishStep (void)
+{
+    if (before(twiModel.now, stepDoneAt)) {
+        twiModel.now = stepDoneAt;
+    }
+    stepPending = false;
+    if (stepControl & (1 << TWSTA)) {
+        TWSR = busActive ? isc_repeatedStartTransmitted : isc_startTransmitted;
+        if (twiModel.startStatus != 0) {
+            TWSR = twiModel.startStatus;
+        }
+        busActive = true;
+        addressNext = true;
+    } else if (addressNext) {
+        addressNext = false;
+        reading = (TWDR & 0x01) != 0;
+        bytesRead = 0;
+        const bool ack = (TWDR >> 1) == TWIMODEL_SLAVE_ADDRESS;
+        if (reading) {
+            TWSR = ack ? isc_SLARACK : isc_SLARNACK;
+        } else {
+            TWSR = ack ? isc_SLAWACK : isc_SLAWNACK;
+        }
+    } else if (reading) {
+        TWDR = twiModel.slaveData[bytesRead++ % sizeof(twiModel.slaveData)];
+        TWSR = (stepControl & (1 << TWEA))
+            ? isc_dataReceivedAck : isc_dataReceicedNack;
+    } else {
+        TWSR = isc_dataTransmittedAck;
+    }
+    interruptFlag = true;
+
+    if (twiModel.stepsBeforeStretch != 0) {
+        --twiModel.stepsBeforeStretch;
+        twiModel.stretching = (twiModel.stepsBeforeStretch == 0);
+    }
+}
+
+void TWIModel_reset (
+    const uint32_t taskMicros)
+{
+    static const uint8_t slaveData[] = { 0x12, 0x34, 0x56, 0x78 };
+
+    memset(&twiModel, 0, sizeof(twiModel));
+    twiModel.taskMicros = taskMicros;
+    memcpy(twiModel.slaveData, slaveData, sizeof(slaveData));
+
+    controlRegister = WRITE_MARKER;
+    control = 0;
+    interruptFlag = false;
+    stepPending = false;
+    busActive = false;
+    addressNext = false;
+    DDRD = 0;
+    PIND = (1 << PD0) | (1 << PD1);
+    sclWasLow = false;
+    sdaWasHigh = true;
+}
+
+void TWIModel_holdSDA (
+    const uint8_t pulses)
+{
+    twiModel.sdaHoldPulses = pulses;
+    twiModel.sdaHeld = true;
+    sdaWasHigh = false;
+    PIND = (1 << PD0);
+}
+
+void TWIModel_run (
+    const uint32_t maxMicros)
+{
+    const uint32_t end = twiModel.now + maxMicros;
+    uint32_t nextTask = twiModel.now;
+    while (!I2CAsync_isIdle() && before(twiModel.now, end)) {
+        (void)TWCR;
+        if (stepPending && !twiModel.stretching && !twiModel.sdaHeld &&
+            !before(nextTask, stepDoneAt)) {
+            finishStep();
+#if !I2CASYNC_POLLED
+            if (control & (1 << TWIE)) {
+                TWI_interrupt();
+            }
+#endif
+        } else {
+            if (before(twiModel.now, nextTask)) {
+                twiModel.now = nextTask;
+            }
+            nextTask = twiModel.now + twiModel.taskMicros;
+            I2CAsync_task();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+//
+// TWI Model
+//
+//  What it does:
+//    Stands in for the AVR's TWI, the I2C bus and one slave, so that
+//    I2CAsync can be run on the host. Each step the TWI is asked for (a
+//    START or a byte) takes as long as it would at 400KHz, and when it is
+//    done TWINT is set and, if enabled, the TWI interrupt is called.
+//    I2CAsync_task is called every taskMicros, as the mainloop would, so
+//    either engine (interrupt driven or I2CASYNC_POLLED) can be run.
+//    Also keeps the host's microsecond clock, stands in for the
+//    SystemTime calls I2CAsync makes, and watches the pins while
+//    I2CAsync recovers the bus by hand.
+//
+//    The slave can be made to stretch the clock, so that TWINT never
+//    comes, or to hold SDA low.
+//
+//  How to use it:
+//    Call TWIModel_reset, then I2CAsync_Initialize. Set up any faults in
+//    twiModel, queue transfers, and call TWIModel_run to run the TWI and
+//    the mainloop until the transfers are done.
+//
+
+#ifndef TWIMODEL_H
+#define TWIMODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TWIMODEL_SLAVE_ADDRESS 0x40
+#define TWIMODEL_SDA_FOREVER 255
+
+// at 400KHz
+#define TWIMODEL_START_MICROS 5
+#define TWIMODEL_BYTE_MICROS 23     // 8 bits and the ACK
+
+typedef struct TWIModel_struct {
+    uint32_t now;                   // uS
+    uint32_t taskMicros;            // time round the mainloop
+    uint32_t timeoutArmedAt;        // last SystemTime_futureTick
+
+    // faults
+    uint8_t stepsBeforeStretch;     // 0 is never
+    bool stretching;                // holding SCL low, so no TWINT
+    bool releaseOnRecovery;         // stops stretching when clocked out
+    uint8_t sdaHoldPulses;          // holding SDA low for this many clocks
+    bool sdaHeld;
+    uint8_t startStatus;            // TWSR after a START, if not 0
+
+    // what recoverBus did to the pins
+    uint16_t sclPulses;
+    uint16_t stopsSeen;
+
+    // the slave's registers read back in turn
+    uint8_t slaveData[4];
+} TWIModel;
+
+extern TWIModel twiModel;
+
+// bus idle, healthy slave, clock at 0
+extern void TWIModel_reset (
+    const uint32_t taskMicros);
+
+// the slave holds SDA low, as one does that was reset out of the middle
+// of a byte, and lets go after the given number of clocks
+extern void TWIModel_holdSDA (
+    const uint8_t pulses);
+
+// runs the TWI and the mainloop until the I2C queue is empty, or for at
+// most the given time
+extern void TWIModel_run (
+    const uint32_t maxMicros);
+
+#endif  // TWIMODEL_H
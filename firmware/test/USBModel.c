@@ -0,0 +1,223 @@
+//
+// USB Model
+//
+
+#include "USBModel.h"
+
+#include <string.h>
+#include <LUFA/Drivers/USB/USB.h>
+#include "SystemTime.h"
+
+#define TICK_MICROS (1000000UL / SYSTEMTIME_TICKS_PER_SECOND)
+
+// a bulk IN transaction is the IN token, the data packet and the ACK,
+// each with its sync, PID, CRC and end of packet, and the gaps between
+#define TRANSACTION_OVERHEAD_BYTES 13
+#define BITS_PER_MICROSECOND 12
+
+USBModel usbModel;
+
+volatile uint8_t USB_DeviceState;
+
+static uint8_t bytesInBank;         // in the bank the CPU is filling
+static uint8_t banksQueued;         // handed over, waiting for the host
+static uint8_t queuedLength[USBMODEL_MAX_BANKS];
+static uint32_t queuedAt[USBMODEL_MAX_BANKS];
+static uint32_t busFreeAt;
+
+static bool before (
+    const uint32_t time,
+    const uint32_t otherTime)
+{
+    return (int32_t)(time - otherTime) < 0;
+}
+
+// the SystemTime calls USBTerminal makes
+
+void SystemTime_futureTick (
+    const uint16_t ticksFromNow,
+    SystemTime_Tick_t* futureTick)
+{
+    *futureTick = (usbModel.now / TICK_MICROS) + ticksFromNow + 1;
+}
+
+bool SystemTime_tickHasArrived (
+    const SystemTime_Tick_t* tick)
+{
+    return (int32_t)((usbModel.now / TICK_MICROS) - *tick) >= 0;
+}
+
+// returns when the host will have taken the oldest queued bank
+static uint32_t packetDoneAt (void)
+{
+    const uint32_t start =
+        before(busFreeAt, queuedAt[0]) ? queuedAt[0] : busFreeAt;
+    return start + ((((uint32_t)queuedLength[0] +
+        TRANSACTION_OVERHEAD_BYTES) * 8) / BITS_PER_MICROSECOND);
+}
+
+static void takePacket (
+    const uint32_t doneAt)
+{
+    busFreeAt = doneAt;
+    usbModel.bytesReceived += queuedLength[0];
+    ++usbModel.packetsReceived;
+    if (queuedLength[0] < usbModel.bankSize) {
+        ++usbModel.shortPackets;
+    }
+    --banksQueued;
+    for (uint8_t b = 0; b < banksQueued; ++b) {
+        queuedLength[b] = queuedLength[b + 1];
+        queuedAt[b] = queuedAt[b + 1];
+    }
+}
+
+void USBModel_advance (
+    const uint32_t micros)
+{
+    const uint32_t end = usbModel.now + micros;
+    while ((banksQueued > 0) && !before(end, packetDoneAt())) {
+        takePacket(packetDoneAt());
+    }
+    usbModel.now = end;
+}
+
+// the CPU busy waits for the host to take a bank
+static void waitUntilReady (void)
+{
+    if (banksQueued == usbModel.banks) {
+        const uint32_t doneAt = packetDoneAt();
+        usbModel.waitMicros += doneAt - usbModel.now;
+        USBModel_advance(doneAt - usbModel.now);
+    }
+}
+
+void USBModel_reset (
+    const uint8_t bankSize,
+    const uint8_t banks,
+    const bool autoFlush)
+{
+    memset(&usbModel, 0, sizeof(usbModel));
+    usbModel.bankSize = bankSize;
+    usbModel.banks = banks;
+    usbModel.autoFlush = autoFlush;
+    USB_DeviceState = DEVICE_STATE_Configured;
+    bytesInBank = 0;
+    banksQueued = 0;
+    busFreeAt = 0;
+}
+
+void USB_Init (void)
+{
+}
+
+void USB_USBTask (void)
+{
+}
+
+// only the CDC data IN endpoint is modelled
+void Endpoint_SelectEndpoint (
+    const uint8_t address)
+{
+}
+
+bool Endpoint_IsINReady (void)
+{
+    return banksQueued < usbModel.banks;
+}
+
+bool Endpoint_IsReadWriteAllowed (void)
+{
+    return Endpoint_IsINReady() && (bytesInBank < usbModel.bankSize);
+}
+
+uint16_t Endpoint_BytesInEndpoint (void)
+{
+    return bytesInBank;
+}
+
+void Endpoint_ClearIN (void)
+{
+    queuedLength[banksQueued] = bytesInBank;
+    queuedAt[banksQueued] = usbModel.now;
+    ++banksQueued;
+    bytesInBank = 0;
+}
+
+// sends each bank as it fills, and waits for the next one, as LUFA does
+uint8_t Endpoint_Write_Stream_LE (
+    const void* const buffer,
+    uint16_t length,
+    uint16_t* const bytesProcessed)
+{
+    while (length > 0) {
+        if (!Endpoint_IsReadWriteAllowed()) {
+            if (bytesInBank == usbModel.bankSize) {
+                Endpoint_ClearIN();
+            }
+            waitUntilReady();
+        }
+        const uint8_t toWrite =
+            MIN(length, (uint16_t)(usbModel.bankSize - bytesInBank));
+        bytesInBank += toWrite;
+        length -= toWrite;
+    }
+
+    return ENDPOINT_RWSTREAM_NoError;
+}
+
+bool CDC_Device_ConfigureEndpoints (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo)
+{
+    return true;
+}
+
+void CDC_Device_ProcessControlRequest (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo)
+{
+}
+
+// as LUFA's CDC_Device_Flush
+static void flush (void)
+{
+    if (bytesInBank == 0) {
+        return;
+    }
+    const bool bankFull = !Endpoint_IsReadWriteAllowed();
+    Endpoint_ClearIN();
+    if (bankFull) {
+        waitUntilReady();
+        Endpoint_ClearIN();
+    }
+}
+
+void CDC_Device_USBTask (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo)
+{
+    if (usbModel.autoFlush && Endpoint_IsINReady()) {
+        flush();
+    }
+}
+
+// as LUFA's
+uint8_t CDC_Device_SendByte (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo,
+    const uint8_t data)
+{
+    if (!Endpoint_IsReadWriteAllowed()) {
+        if (bytesInBank == usbModel.bankSize) {
+            Endpoint_ClearIN();
+        }
+        waitUntilReady();
+    }
+    ++bytesInBank;
+
+    return ENDPOINT_READYWAIT_NoError;
+}
+
+// the host sends nothing
+int16_t CDC_Device_ReceiveByte (
+    USB_ClassInfo_CDC_Device_t* const cdcInterfaceInfo)
+{
+    return -1;
+}
@@ -0,0 +1,58 @@
+//
+// USB Model
+//
+//  What it does:
+//    Stands in for LUFA's endpoint and CDC class driver calls, the USB
+//    controller's IN endpoint banks and a host reading from the bulk IN
+//    endpoint, so that USBTerminal can be run on the host. The host is
+//    always listening and takes each packet the CPU hands over as soon
+//    as the bus is free, at the full speed rate (12Mbit/s, with the
+//    token, handshake and framing of a bulk transaction). The time the
+//    CPU spends copying bytes isn't modelled, only the time it spends
+//    waiting for a bank.
+//    Also keeps the host's microsecond clock and stands in for the
+//    SystemTime calls USBTerminal makes.
+//
+//  How to use it:
+//    Call USBModel_reset with the endpoint's bank size and number of
+//    banks, and whether the class driver flushes the IN endpoint on every
+//    CDC_Device_USBTask (LUFA does unless NO_CLASS_DRIVER_AUTOFLUSH is
+//    defined). Then run the mainloop, calling USBModel_advance with the
+//    time each pass takes.
+//
+
+#ifndef USBMODEL_H
+#define USBMODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define USBMODEL_MAX_BANKS 2
+
+typedef struct USBModel_struct {
+    uint32_t now;                   // uS
+    uint8_t bankSize;
+    uint8_t banks;
+    bool autoFlush;
+
+    // what the host has received
+    uint32_t bytesReceived;
+    uint32_t packetsReceived;
+    uint32_t shortPackets;          // less than a full bank, zero length included
+
+    uint32_t waitMicros;            // the CPU waiting for a bank
+} USBModel;
+
+extern USBModel usbModel;
+
+// configured, banks empty, clock at 0
+extern void USBModel_reset (
+    const uint8_t bankSize,
+    const uint8_t banks,
+    const bool autoFlush);
+
+// moves the clock on, the host taking packets meanwhile
+extern void USBModel_advance (
+    const uint32_t micros);
+
+#endif  // USBMODEL_H
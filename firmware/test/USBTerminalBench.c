@@ -0,0 +1,114 @@
+//
+// USB terminal benchmark
+//
+// Keeps ToUSB_Buffer full, as a meter streaming reports faster than USB
+// takes them would, and runs USBTerminal_task against USBModel for a
+// range of times round the mainloop. Prints the sustained bytes per
+// second that reach the host, and the packets per second, both for
+// USBTerminal as it is (64 byte endpoint, two banks, a packet when a bank
+// fills) and for the way it sent before (16 byte endpoint, one bank, at
+// most 15 bytes a pass with CDC_Device_SendByte, and the class driver
+// flushing every pass). The times are the model's: a host that is always
+// listening and no time spent copying bytes, so the numbers are upper
+// bounds.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "USBTerminal.h"
+#include "ByteQueue.h"
+#include "USBModel.h"
+
+#define RUN_MICROS 1000000UL
+
+// as USBTerminal.c sent to the host before it used 64 byte packets
+#define LEGACY_EPSIZE 16
+#define LEGACY_BANKS 1
+
+ByteQueue_define(150, Legacy_Buffer)
+
+uint8_t SREG;
+
+// in USBTerminal.c
+extern USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface;
+
+static void legacyTask (void)
+{
+    uint16_t BufferCount = ByteQueue_length(&Legacy_Buffer);
+    if (BufferCount > 0) {
+        Endpoint_SelectEndpoint(VirtualSerial_CDC_Interface.Config.DataINEndpoint.Address);
+        if (Endpoint_IsINReady()) {
+            uint8_t BytesToSend = MIN(BufferCount, (LEGACY_EPSIZE - 1));
+            while (BytesToSend--) {
+                if (CDC_Device_SendByte(&VirtualSerial_CDC_Interface,
+                        ByteQueue_head(&Legacy_Buffer)) != ENDPOINT_READYWAIT_NoError) {
+                    break;
+                }
+                ByteQueue_pop(&Legacy_Buffer);
+            }
+        }
+    }
+
+    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
+    USB_USBTask();
+}
+
+static void fillLegacyBuffer (void)
+{
+    while (!ByteQueue_is_full(&Legacy_Buffer)) {
+        ByteQueue_push('x', &Legacy_Buffer);
+    }
+}
+
+static void fillBuffer (void)
+{
+    static const uint8_t bytes[UINT8_MAX] = {0};
+    USBTerminal_sendBytesToHost(bytes,
+        ByteRing_spaceRemaining(&ToUSB_Buffer));
+}
+
+static void run (
+    const uint32_t taskMicros,
+    const bool legacy)
+{
+    if (legacy) {
+        USBModel_reset(LEGACY_EPSIZE, LEGACY_BANKS, true);
+        ByteQueue_clear(&Legacy_Buffer);
+    } else {
+        USBModel_reset(CDC_TXRX_EPSIZE,
+            VirtualSerial_CDC_Interface.Config.DataINEndpoint.Banks, false);
+        USBTerminal_Initialize();
+    }
+    while (usbModel.now < RUN_MICROS) {
+        if (legacy) {
+            fillLegacyBuffer();
+            legacyTask();
+        } else {
+            fillBuffer();
+            USBTerminal_task();
+        }
+        USBModel_advance(taskMicros);
+    }
+}
+
+int main (void)
+{
+    static const uint32_t taskMicros[] = { 50, 100, 200, 500, 1000, 2000 };
+
+    printf("USBTerminalBench: sustained bytes to the host, full speed\n");
+    printf("mainloop uS   before: bytes/s  packets/s   after: bytes/s  packets/s  wait uS/s\n");
+    for (size_t t = 0; t < sizeof(taskMicros) / sizeof(taskMicros[0]); ++t) {
+        run(taskMicros[t], true);
+        const uint32_t legacyBytes = (uint32_t)(((uint64_t)usbModel.bytesReceived * 1000000) / usbModel.now);
+        const uint32_t legacyPackets = (uint32_t)(((uint64_t)usbModel.packetsReceived * 1000000) / usbModel.now);
+        run(taskMicros[t], false);
+        const uint32_t bytes = (uint32_t)(((uint64_t)usbModel.bytesReceived * 1000000) / usbModel.now);
+        const uint32_t packets = (uint32_t)(((uint64_t)usbModel.packetsReceived * 1000000) / usbModel.now);
+        printf("%11u %16u %10u %15u %10u %10u\n", (unsigned)taskMicros[t],
+            (unsigned)legacyBytes, (unsigned)legacyPackets,
+            (unsigned)bytes, (unsigned)packets,
+            (unsigned)(((uint64_t)usbModel.waitMicros * 1000000) / usbModel.now));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+//
+// host stand-in for avr-libc's avr/interrupt.h, for the host tests. an
+// interrupt handler is an ordinary function that the test calls
+//
+
+#ifndef AVR_INTERRUPT_H
+#define AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector) void vector (void)
+
+#define TWI_vect TWI_interrupt
+
+#define cli()
+#define sei()
+
+#endif  // AVR_INTERRUPT_H
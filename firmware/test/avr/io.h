@@ -0,0 +1,41 @@
+//
+// host stand-in for avr-libc's avr/io.h, for the host tests. only what
+// the modules under test use
+//
+
+#ifndef AVR_IO_H
+#define AVR_IO_H
+
+#include <stdint.h>
+
+#define E2END 0x3FF     // ATmega32U4
+
+// status register. interrupts are never enabled on the host, so it is
+// only saved and restored
+extern uint8_t SREG;
+
+// TWI registers. TWCR is reached through a function so that a test's
+// model of the TWI sees every access to it, as the hardware would
+extern volatile uint8_t *TWI_controlRegister (void);
+#define TWCR (*TWI_controlRegister())
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWDR;
+extern volatile uint8_t TWBR;
+
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+
+// port D, which has the TWI pins
+extern volatile uint8_t PORTD;
+extern volatile uint8_t DDRD;
+extern volatile uint8_t PIND;
+
+#define PD0 0
+#define PD1 1
+
+#endif  // AVR_IO_H
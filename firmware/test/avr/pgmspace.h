@@ -0,0 +1,23 @@
+//
+// host stand-in for avr-libc's avr/pgmspace.h, for the host tests. program
+// memory is ordinary memory
+//
+
+#ifndef AVR_PGMSPACE_H
+#define AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+typedef const char *PGM_P;
+
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+#define strcmp_P strcmp
+#define strstr_P strstr
+#define strlen_P strlen
+
+#endif  // AVR_PGMSPACE_H
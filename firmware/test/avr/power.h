@@ -0,0 +1,9 @@
+//
+// host stand-in for avr-libc's avr/power.h, for the host tests. nothing in it
+// is used by the modules they build
+//
+
+#ifndef AVR_POWER_H
+#define AVR_POWER_H
+
+#endif  // AVR_POWER_H
@@ -0,0 +1,9 @@
+//
+// host stand-in for avr-libc's avr/wdt.h, for the host tests. nothing in it
+// is used by the modules they build
+//
+
+#ifndef AVR_WDT_H
+#define AVR_WDT_H
+
+#endif  // AVR_WDT_H
@@ -0,0 +1,22 @@
+//
+// host stand-in for avr-libc's util/crc16.h, for the host tests
+//
+
+#ifndef UTIL_CRC16_H
+#define UTIL_CRC16_H
+
+#include <stdint.h>
+
+// as avr-libc documents it
+static inline uint16_t _crc_ccitt_update (
+    uint16_t crc,
+    uint8_t data)
+{
+    data ^= (uint8_t)crc;
+    data ^= data << 4;
+
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4)) ^
+        ((uint16_t)data << 3);
+}
+
+#endif  // UTIL_CRC16_H
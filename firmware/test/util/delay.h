@@ -0,0 +1,12 @@
+//
+// host stand-in for avr-libc's util/delay.h, for the host tests. the test
+// supplies _delay_us, so that busy waits move its clock on
+//
+
+#ifndef UTIL_DELAY_H
+#define UTIL_DELAY_H
+
+extern void _delay_us (
+    double us);
+
+#endif  // UTIL_DELAY_H
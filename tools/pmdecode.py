@@ -0,0 +1,399 @@
+#!/usr/bin/env python3
+#
+# Power Meter binary report decoder
+#
+# Reads the meter's USB serial stream (from a serial port, a capture file,
+# or stdin) and prints each report as a CSV line, in the same form as the
+# meter's text output. Console text that comes between the frames is
+# passed through. See BinaryFrame.h and PowerMeter.c in the firmware for
+# the frame and record layouts.
+#
+# usage:
+#   pmdecode.py /dev/ttyACM0          (needs pyserial)
+#   pmdecode.py capture.bin
+#   pmdecode.py --stats capture.bin   (also print throughput and loss)
+#   pmdecode.py --samples samples.csv capture.bin
+#                                     (write raw streamed samples as CSV,
+#                                     timed in seconds since the meter
+#                                     was reset)
+#   pmdecode.py --elf ../firmware/USBtoSerial.elf capture.bin
+#                                     (expand deferred log messages)
+#
+# --stats prints the bytes per report and bytes per second for both the
+# binary frames and the text lines in the capture, so captures taken with
+# "format text" and "format binary" can be compared.
+#
+# With binary output the meter sends its log messages as the flash address
+# of the message's format string plus the arguments (see Log.h in the
+# firmware). --elf reads the format strings from the .elf file of the
+# firmware that is running on the meter. Without it the messages are shown
+# as the address and the argument values.
+#
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = b'\xa5\x5a'
+HEADER_LEN = 5
+CRC_LEN = 2
+
+FRAME_UNITS = 1
+FRAME_CHANNELS = 2
+FRAME_SAMPLES = 3
+FRAME_GAP = 4
+FRAME_LOG = 5
+
+SAMPLE_DELTA = 0
+SAMPLE_ABSOLUTE = 1
+SAMPLE_INVALID = 2
+SAMPLE_SETTLING = 3
+SAMPLE_KINDS = ('ok', 'ok', 'invalid', 'settling')
+
+
+def crc_ccitt(data, crc=0xFFFF):
+    # same as avr-libc's _crc_ccitt_update
+    for byte in data:
+        byte ^= crc & 0xFF
+        byte = (byte ^ (byte << 4)) & 0xFF
+        crc = (((byte << 8) | (crc >> 8)) ^ (byte >> 4) ^ (byte << 3)) & 0xFFFF
+    return crc
+
+
+class FormatTable:
+    # format strings of the Log messages, read from the firmware's .elf
+    # file. the message ID is the string's address in flash
+    def __init__(self, path):
+        self.sections = []
+        with open(path, 'rb') as f:
+            image = f.read()
+        if image[:4] != b'\x7fELF' or image[4] != 1 or image[5] != 1:
+            raise ValueError('%s is not a 32 bit little-endian ELF file' % path)
+        shoff, = struct.unpack_from('<I', image, 32)
+        shentsize, shnum = struct.unpack_from('<HH', image, 46)
+        for index in range(shnum):
+            (_, sh_type, flags, addr, offset, size) = struct.unpack_from(
+                '<IIIIII', image, shoff + index * shentsize)
+            # loaded data (SHT_PROGBITS, SHF_ALLOC) in flash. the AVR
+            # toolchain puts RAM and EEPROM at 0x800000 and up
+            if sh_type == 1 and (flags & 2) and addr < 0x800000:
+                self.sections.append((addr, image[offset:offset + size]))
+
+    def lookup(self, address):
+        for base, data in self.sections:
+            if base <= address < base + len(data):
+                end = data.find(b'\0', address - base)
+                if end < 0:
+                    end = len(data)
+                return data[address - base:end].decode('ascii', 'replace')
+        return None
+
+
+def format_message(fmt, args):
+    # the firmware's formats only use %d, %u, %x and %%
+    out = []
+    pos = 0
+    args = list(args)
+    while pos < len(fmt):
+        c = fmt[pos]
+        conversion = fmt[pos + 1:pos + 2] if c == '%' else ''
+        if conversion in ('d', 'u', 'x'):
+            value = args.pop(0) if args else 0
+            if conversion == 'u':
+                out.append('%d' % (value & 0xFFFFFFFF))
+            elif conversion == 'x':
+                out.append('%x' % (value & 0xFFFFFFFF))
+            else:
+                out.append('%d' % value)
+            pos += 2
+        elif conversion == '%':
+            out.append('%')
+            pos += 2
+        else:
+            out.append(c)
+            pos += 1
+    return ''.join(out)
+
+
+def read_varints(payload, pos):
+    values = []
+    value = 0
+    shift = 0
+    for byte in payload[pos:]:
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            # undo the zigzag encoding
+            values.append((value >> 1) ^ -(value & 1))
+            value = 0
+            shift = 0
+    return values
+
+
+def format_thousandths(value):
+    sign = '-' if value < 0 else ''
+    value = abs(value)
+    return '%s%d.%03d' % (sign, value // 1000, value % 1000)
+
+
+def format_tenths(value):
+    sign = '-' if value < 0 else ''
+    value = abs(value)
+    return '%s%d.%d' % (sign, value // 10, value % 10)
+
+
+class Decoder:
+    def __init__(self, out, samples_out=None, formats=None):
+        self.out = out
+        self.samples_out = samples_out
+        self.formats = formats
+        self.log_messages = 0
+        self.log_bytes = 0
+        self.stream_units = None    # (scaling, shunt, LSB, counts/s)
+        self.sample_time = {}       # channel -> (uS, weight units since)
+        self.micros_wraps = 0       # of the meter's 32 bit uS clock
+        self.last_micros = None
+        self.samples = 0
+        self.samples_dropped = 0
+        self.next_sample = None
+        self.buffer = bytearray()
+        self.text = bytearray()
+        self.units = None
+        self.expected_sequence = None
+        self.frames = 0
+        self.lost_frames = 0
+        self.crc_errors = 0
+        self.frame_bytes = 0
+        self.text_bytes = 0
+        self.reports = 0
+        self.reports_dropped = 0
+        self.text_reports = 0
+
+    def feed(self, data):
+        self.buffer += data
+        while self.buffer:
+            start = self.buffer.find(SYNC[0])
+            if start < 0:
+                self.take_text(self.buffer)
+                self.buffer.clear()
+                break
+            if start > 0:
+                self.take_text(self.buffer[:start])
+                del self.buffer[:start]
+            if len(self.buffer) < HEADER_LEN:
+                break
+            if self.buffer[1] != SYNC[1]:
+                # not a frame - skip the stray byte
+                del self.buffer[0]
+                continue
+            length = self.buffer[4]
+            frame_len = HEADER_LEN + length + CRC_LEN
+            if len(self.buffer) < frame_len:
+                break
+            frame = bytes(self.buffer[:frame_len])
+            crc = struct.unpack_from('<H', frame, HEADER_LEN + length)[0]
+            if crc != crc_ccitt(frame[2:HEADER_LEN + length]):
+                # resync on the next sync byte
+                self.crc_errors += 1
+                del self.buffer[0]
+                continue
+            del self.buffer[:frame_len]
+            self.frame_bytes += frame_len
+            self.take_frame(frame[2], frame[3], frame[HEADER_LEN:HEADER_LEN + length])
+
+    def take_text(self, data):
+        self.text_bytes += len(data)
+        self.text += data
+        while b'\n' in self.text:
+            line, _, rest = self.text.partition(b'\n')
+            self.text = bytearray(rest)
+            line = line.decode('ascii', 'replace').rstrip('\r')
+            # report lines start with the time, e.g. "12.300, ..."
+            if line[:1].isdigit() and ', ' in line:
+                self.text_reports += 1
+            elif line.startswith('# gap: '):
+                self.reports_dropped += int(line.split()[2])
+            self.out.write(line + '\n')
+
+    def take_frame(self, frame_type, sequence, payload):
+        self.frames += 1
+        if self.expected_sequence is not None and sequence != self.expected_sequence:
+            lost = (sequence - self.expected_sequence) & 0xFF
+            self.lost_frames += lost
+            self.out.write('# lost %d frame(s)\n' % lost)
+        self.expected_sequence = (sequence + 1) & 0xFF
+
+        if frame_type == FRAME_UNITS:
+            (num_channels, interval_ms, samples_per_second,
+             per_uah, per_uwh) = struct.unpack_from('<BIHQQ', payload)
+            self.units = (per_uah, per_uwh)
+            if len(payload) >= 34:
+                scaling, shunt, lsb, _, counts_per_second = struct.unpack_from(
+                    '<BHHHI', payload, 23)
+                self.stream_units = (scaling, shunt, lsb, counts_per_second)
+                self.sample_time = {}
+                self.next_sample = None
+            self.out.write('# channels: %d, report interval mS: %d, samples/s: %d\n'
+                           % (num_channels, interval_ms, samples_per_second))
+        elif frame_type == FRAME_CHANNELS:
+            report_time, first, count = struct.unpack_from('<IBB', payload)
+            fields = ['%d.%03d' % (report_time // 1000, report_time % 1000)]
+            for ch in range(count):
+                average, charge, energy = struct.unpack_from(
+                    '<iqq', payload, 6 + ch * 20)
+                fields.append(format_tenths(average))
+                if self.units is None:
+                    fields += ['?', '?']
+                else:
+                    fields.append(format_thousandths(int(charge / self.units[0])))
+                    fields.append(format_thousandths(int(energy / self.units[1])))
+            self.reports += 1
+            prefix = '' if first == 0 else '+ '
+            self.out.write(prefix + ', '.join(fields) + '\n')
+        elif frame_type == FRAME_SAMPLES:
+            self.take_samples(payload)
+        elif frame_type == FRAME_GAP:
+            dropped = struct.unpack_from('<H', payload)[0]
+            self.reports_dropped += dropped
+            self.out.write('# gap: %d reports dropped\n' % dropped)
+        elif frame_type == FRAME_LOG:
+            self.take_log(payload)
+        else:
+            self.out.write('# unknown frame type %d\n' % frame_type)
+
+    def take_log(self, payload):
+        self.log_messages += 1
+        self.log_bytes += HEADER_LEN + len(payload) + CRC_LEN
+        address = struct.unpack_from('<H', payload)[0]
+        args = read_varints(payload, 2)
+        fmt = self.formats.lookup(address) if self.formats is not None else None
+        if fmt is None:
+            self.out.write('# log 0x%04x: %s\n'
+                           % (address, ', '.join('%d' % arg for arg in args)))
+        else:
+            self.out.write(format_message(fmt, args) + '\n')
+
+    def reading_to_milliamps(self, reading):
+        scaling, shunt, lsb, _ = self.stream_units
+        if scaling == 1:
+            return reading * lsb / 1000.0
+        # shunt voltage readings are 10uV
+        return reading * 10.0 / shunt
+
+    def unwrap_micros(self, micros):
+        # the clock wraps around about every 71 minutes
+        if self.last_micros is not None and micros < self.last_micros - (1 << 31):
+            self.micros_wraps += 1
+        self.last_micros = micros
+        return micros + (self.micros_wraps << 32)
+
+    def take_samples(self, payload):
+        first, dropped = struct.unpack_from('<II', payload)
+        if self.next_sample is not None and first != self.next_sample:
+            self.out.write('# %d sample(s) not streamed\n' % (first - self.next_sample))
+        self.samples_dropped = dropped
+        last_reading = {}
+        last_weight = {}
+        number = first
+        pos = 8
+        while pos < len(payload):
+            header = payload[pos]
+            pos += 1
+            channel = header >> 4
+            kind = header & 0x03
+            reading = None
+            if kind == SAMPLE_DELTA:
+                reading = last_reading[channel] + struct.unpack_from('<b', payload, pos)[0]
+                pos += 1
+            elif kind == SAMPLE_ABSOLUTE:
+                reading = struct.unpack_from('<h', payload, pos)[0]
+                pos += 2
+            if header & 0x04:
+                last_weight[channel] = struct.unpack_from('<H', payload, pos)[0]
+                pos += 2
+            weight = last_weight[channel]
+            if header & 0x08:
+                micros = self.unwrap_micros(struct.unpack_from('<I', payload, pos)[0])
+                pos += 4
+                self.sample_time[channel] = (micros, 0)
+            else:
+                micros, since = self.sample_time.get(channel, (0, 0))
+                self.sample_time[channel] = (micros, since + weight)
+            if reading is not None:
+                last_reading[channel] = reading
+            self.samples += 1
+            if self.samples_out is not None and self.stream_units is not None:
+                micros, since = self.sample_time[channel]
+                seconds = (micros / 1e6) + (since / self.stream_units[3])
+                if reading is None:
+                    self.samples_out.write('%d, %d, %.6f, , , %s\n' % (
+                        number, channel, seconds, SAMPLE_KINDS[kind]))
+                else:
+                    self.samples_out.write('%d, %d, %.6f, %d, %.3f, %s\n' % (
+                        number, channel, seconds, reading,
+                        self.reading_to_milliamps(reading), SAMPLE_KINDS[kind]))
+            number += 1
+        self.next_sample = number
+
+
+def main():
+    parser = argparse.ArgumentParser(description='decode Power Meter output')
+    parser.add_argument('source', nargs='?', help='serial port or capture file (default stdin)')
+    parser.add_argument('--stats', action='store_true', help='print throughput and loss at the end')
+    parser.add_argument('--samples', metavar='CSV', help='write streamed samples to this file')
+    parser.add_argument('--elf', help="the meter firmware's .elf file, for log messages")
+    args = parser.parse_args()
+
+    if args.source is None:
+        source = sys.stdin.buffer
+    elif args.source.startswith('/dev/') or args.source.upper().startswith('COM'):
+        import serial
+        source = serial.Serial(args.source, timeout=0.1)
+    else:
+        source = open(args.source, 'rb')
+
+    samples_out = None
+    if args.samples:
+        samples_out = open(args.samples, 'w')
+        samples_out.write('sample, channel, time s, reading, mA, kind\n')
+    formats = FormatTable(args.elf) if args.elf else None
+    decoder = Decoder(sys.stdout, samples_out, formats)
+    started = time.time()
+    try:
+        while True:
+            data = source.read(4096) if not hasattr(source, 'in_waiting') \
+                else source.read(max(1, source.in_waiting))
+            if not data:
+                if hasattr(source, 'in_waiting'):
+                    continue
+                break
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+    elapsed = time.time() - started
+
+    if args.stats:
+        err = sys.stderr
+        err.write('frames: %d, lost: %d, CRC errors: %d\n'
+                  % (decoder.frames, decoder.lost_frames, decoder.crc_errors))
+        if decoder.reports_dropped:
+            err.write('reports dropped by the meter: %d\n' % decoder.reports_dropped)
+        if decoder.samples or decoder.samples_dropped:
+            err.write('samples: %d, not streamed: %d\n'
+                      % (decoder.samples, decoder.samples_dropped))
+        if decoder.log_messages:
+            err.write('log messages: %d, %.1f bytes/message\n'
+                      % (decoder.log_messages, decoder.log_bytes / decoder.log_messages))
+        if decoder.reports:
+            err.write('binary: %d bytes, %.1f bytes/report\n'
+                      % (decoder.frame_bytes, decoder.frame_bytes / decoder.reports))
+        if decoder.text_reports:
+            err.write('text: %d bytes, %.1f bytes/report\n'
+                      % (decoder.text_bytes, decoder.text_bytes / decoder.text_reports))
+        if hasattr(source, 'in_waiting') and elapsed > 0:
+            err.write('%.0f bytes/s\n' % ((decoder.frame_bytes + decoder.text_bytes) / elapsed))
+
+
+if __name__ == '__main__':
+    main()